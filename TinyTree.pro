@@ -9,19 +9,49 @@ CONFIG += c++11
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    analyze.cpp \
+    arena.cpp \
     cmain.cpp \
+    flat.cpp \
+    fold.cpp \
+    intern.cpp \
+    jit.cpp \
     main.cpp \
     parse.cpp \
+    parseworker.cpp \
+    reparse.cpp \
     scan.cpp \
+    scankern.cpp \
+    spans.cpp \
+    srcbuf.cpp \
+    stats.cpp \
+    symtab.cpp \
+    tm.cpp \
     util.cpp \
+    vm.cpp \
     widget.cpp
 
 HEADERS += \
+    analyze.h \
+    arena.h \
     cmain.h \
+    flat.h \
+    fold.h \
     globals.h \
+    intern.h \
+    jit.h \
     parse.h \
+    parseworker.h \
+    reparse.h \
     scan.h \
+    scankern.h \
+    spans.h \
+    srcbuf.h \
+    stats.h \
+    symtab.h \
+    tm.h \
     util.h \
+    vm.h \
     widget.h
 
 FORMS +=
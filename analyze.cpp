@@ -0,0 +1,340 @@
+/****************************************************/
+/* File: analyze.cpp                                */
+/* Semantic analyzer implementation                 */
+/* for the TINY compiler                            */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdarg.h>
+#include <vector>
+#include "globals.h"
+#include "util.h"
+#include "flat.h"
+#include "analyze.h"
+
+using namespace std;
+
+/* An Analyzer is the state of one analyze */
+typedef struct {
+    const ParseContext* ctx; /* that made the tree */
+    SymTab* st;
+    string* messages;
+    int listed;   /* problems appended to messages */
+    int unlisted; /* problems past MAXMESSAGES */
+    int errors;   /* type errors */
+} Analyzer;
+
+/* problem lists one type error or warning, formatting
+ * its message only if it is listed */
+static void problem(Analyzer* a, const char* kind, int line, const char* format, ...)
+{
+    if(a->listed == MAXMESSAGES) {
+        a->unlisted++;
+        return;
+    }
+    char buf[48];
+    a->messages->append(buf, snprintf(buf, sizeof(buf), "%s at line %d: ", kind, line));
+    va_list args;
+    va_start(args, format);
+    size_t at = a->messages->size();
+    int n = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    a->messages->resize(at + n + 1);
+    va_start(args, format);
+    vsnprintf(&(*a->messages)[at], n + 1, format, args);
+    va_end(args);
+    (*a->messages)[at + n] = '\n';
+    a->listed++;
+}
+
+/* Procedure insertNode inserts the variable of t, if
+ * it has one, into the symbol table, counting a
+ * definition or a use; shift is as for nodeLine
+ */
+static void insertNode(Analyzer* a, TreeNode* t, int shift)
+{
+    if(t->nodekind == StmtK) {
+        if((t->kind.stmt == AssignK || t->kind.stmt == ReadK) && t->attr.name != NULL) {
+            symtabInsert(a->st, t->attr.name, nodeLine(a->ctx, t, shift))->defs++;
+        } else if(t->kind.stmt == ForK && t->child[0] != NULL && t->child[0]->attr.name != NULL) {
+            /* the loop reads the variable its first child
+               assigns; entered at that child's line, which
+               comes next, so the line lists are unchanged */
+            int line = nodeLine(a->ctx, t->child[0], shift + nodeShift(a->ctx, t));
+            symtabInsert(a->st, t->child[0]->attr.name, line)->uses++;
+        }
+    } else if(t->kind.exp == IdK && t->attr.name != NULL) {
+        symtabInsert(a->st, t->attr.name, nodeLine(a->ctx, t, shift))->uses++;
+    }
+}
+
+static bool isComparison(TokenType op)
+{
+    return op == LT || op == LTE || op == GT || op == GTE || op == EQ || op == NE;
+}
+
+/* typeOf returns the type of an expression, Void if it
+ * is missing */
+static ExpType typeOf(const TreeNode* t)
+{
+    return (t == NULL) ? Void : t->type;
+}
+
+/* typeError lists one type error; symbol fills a %s
+ * in message */
+static void typeError(Analyzer* a, int line, const char* message, const char* symbol)
+{
+    problem(a, "Type error", line, message, symbol);
+    a->errors++;
+}
+
+/* Function checkType performs type checking at a
+ * single node of the given kind and operator, whose
+ * first two children have been checked and have the
+ * types left and right, and returns its type; op is
+ * ERROR but for an operator, Void
+ * for a statement. A Void operand has had its error
+ * listed already, so only a type known to be wrong is
+ * reported
+ */
+static ExpType checkType(Analyzer* a, int line, NodeKind nodekind, int kind, TokenType op,
+                         ExpType left, ExpType right)
+{
+    if(nodekind == ExpK) {
+        switch(kind) {
+            case OpK:
+                if(left == Boolean || right == Boolean) {
+                    typeError(a, line, "operator %s applied to a non-integer", tokenSymbol(op));
+                }
+                return isComparison(op) ? Boolean : Integer;
+            case LopK:
+                /* & | and # take the type of their operands,
+                   which must agree; compileTree and genTm
+                   refuse them, so a use is an error too */
+                if(left != Void && right != Void && left != right) {
+                    typeError(a, line, "operands of %s differ in type", tokenSymbol(op));
+                    return Void;
+                }
+                typeError(a, line, "operator %s cannot be compiled", tokenSymbol(op));
+                return (left != Void) ? left : right;
+            default: /* ConstK and IdK */
+                return Integer;
+        }
+    }
+    switch(kind) {
+        case AndK:
+        case OrK:
+            if(left == Integer || right == Integer) {
+                typeError(a, line, "operator %s applied to a non-Boolean",
+                          (kind == AndK) ? "and" : "or");
+            }
+            return Boolean;
+        case IfK:
+            if(left == Integer) {
+                typeError(a, line, "if test is not Boolean", NULL);
+            }
+            break;
+        case RepeatK:
+            if(right == Integer) {
+                typeError(a, line, "repeat test is not Boolean", NULL);
+            }
+            break;
+        case DoWhileK:
+            if(right == Integer) {
+                typeError(a, line, "while test is not Boolean", NULL);
+            }
+            break;
+        case AssignK:
+            if(left == Boolean) {
+                typeError(a, line, "assignment of non-integer value", NULL);
+            }
+            break;
+        case WriteK:
+            if(left == Boolean) {
+                typeError(a, line, "write of non-integer value", NULL);
+            }
+            break;
+        case ToK:
+        case DowntoK:
+            if(left == Boolean) {
+                typeError(a, line, "for bound is not an integer", NULL);
+            }
+            break;
+        default:
+            break;
+    }
+    return Void;
+}
+
+/* Procedure checkNode sets the type of a tree node,
+ * whose children have been checked; shift is as for
+ * nodeLine
+ */
+static void checkNode(Analyzer* a, TreeNode* t, int shift)
+{
+    int kind = (t->nodekind == StmtK) ? (int) t->kind.stmt : (int) t->kind.exp;
+    TokenType op = (t->nodekind == ExpK && (kind == OpK || kind == LopK)) ? t->attr.op : ERROR;
+    t->type = checkType(a, nodeLine(a->ctx, t, shift), t->nodekind, kind, op,
+                        typeOf(t->child[0]), typeOf(t->child[1]));
+}
+
+/* A PendingNode is a node yet to be visited and the
+ * shift of its ancestors and earlier siblings; a
+ * node is visited once before its children and once
+ * after them */
+typedef struct {
+    TreeNode* tree;
+    int shift;
+    bool after; /* its children have been visited */
+} PendingNode;
+
+/* Procedure traverse walks the tree from an explicit
+ * stack, as printTree does, inserting each node in
+ * preorder and checking it in postorder
+ */
+static void traverse(Analyzer* a, TreeNode* tree)
+{
+    vector<PendingNode> pending;
+    if(tree != NULL) {
+        pending.push_back({tree, 0, false});
+    }
+    while(!pending.empty()) {
+        PendingNode n = pending.back();
+        pending.pop_back();
+        if(n.after) {
+            checkNode(a, n.tree, n.shift);
+            continue;
+        }
+        insertNode(a, n.tree, n.shift);
+        int shift = n.shift + nodeShift(a->ctx, n.tree);
+        if(n.tree->sibling != NULL) {
+            pending.push_back({n.tree->sibling, shift, false});
+        }
+        pending.push_back({n.tree, n.shift, true});
+        for(int i = MAXCHILDREN - 1; i >= 0; i--) {
+            if(n.tree->child[i] != NULL) {
+                pending.push_back({n.tree->child[i], shift, false});
+            }
+        }
+    }
+}
+
+/* flatLine returns the line of node i of flat, or 0
+ * if it has no lines */
+static int flatLine(const FlatTree* flat, unsigned i)
+{
+    return (flat->line == NULL) ? 0 : flat->line[i];
+}
+
+/* Procedure insertFlat is insertNode for node i of a
+ * flat tree
+ */
+static void insertFlat(Analyzer* a, const FlatTree* flat, unsigned i)
+{
+    const FlatNode* n = &flat->nodes[i];
+    if(n->nodekind == StmtK) {
+        if(n->kind == AssignK || n->kind == ReadK) {
+            symtabInsert(a->st, flatName(flat, n), flatLine(flat, i))->defs++;
+        } else if(n->kind == ForK && (n->flags & FLAT_CHILD(0))) {
+            /* the first child is the next node */
+            symtabInsert(a->st, flatName(flat, n + 1), flatLine(flat, i + 1))->uses++;
+        }
+    } else if(n->kind == IdK) {
+        symtabInsert(a->st, flatName(flat, n), flatLine(flat, i))->uses++;
+    }
+}
+
+/* Procedure checkFlat is checkNode for node i of a
+ * flat tree; types holds the type of each node
+ * checked
+ */
+static void checkFlat(Analyzer* a, const FlatTree* flat, unsigned i, vector<unsigned char>& types)
+{
+    const FlatNode* n = &flat->nodes[i];
+    unsigned left = flatChild(flat, i, 0);
+    unsigned right = flatChild(flat, i, 1);
+    TokenType op = (n->nodekind == ExpK && (n->kind == OpK || n->kind == LopK))
+                   ? (TokenType) n->attr : ERROR;
+    types[i] = (unsigned char) checkType(a, flatLine(flat, i), (NodeKind) n->nodekind, n->kind, op,
+                                         left ? (ExpType) types[left] : Void,
+                                         right ? (ExpType) types[right] : Void);
+}
+
+/* Procedure traverseFlat walks a flat tree in one
+ * forward pass, inserting each node as it comes, which
+ * is preorder, and checking it once its subtree has
+ * been passed, which is postorder; open holds the
+ * nodes whose subtrees are being passed
+ */
+static void traverseFlat(Analyzer* a, const FlatTree* flat)
+{
+    vector<unsigned char> types(flat->count, Void);
+    vector<unsigned> open;
+    for(unsigned i = 0; i < flat->count; i++) {
+        while(!open.empty() && open.back() + flat->nodes[open.back()].size <= i) {
+            checkFlat(a, flat, open.back(), types);
+            open.pop_back();
+        }
+        insertFlat(a, flat, i);
+        open.push_back(i);
+    }
+    while(!open.empty()) {
+        checkFlat(a, flat, open.back(), types);
+        open.pop_back();
+    }
+}
+
+/* Procedure finish lists the variables never given a
+ * value or never read, and the count of the problems
+ * not listed
+ */
+static void finish(Analyzer* a)
+{
+    SymTab* st = a->st;
+    for(size_t k = 0; k < st->symbols.size(); k++) {
+        const Symbol* s = &st->symbols[k];
+        int line = st->lines[s->firstLine].line;
+        if(s->defs == 0) {
+            problem(a, "Warning", line, "variable %s is read but never given a value", s->name);
+        } else if(s->uses == 0) {
+            problem(a, "Warning", line, "variable %s is given a value that is never read",
+                    s->name);
+        }
+    }
+    if(a->unlisted > 0) {
+        char buf[48];
+        a->messages->append(buf, snprintf(buf, sizeof(buf), "%d more problems not listed\n",
+                                          a->unlisted));
+    }
+}
+
+/* initAnalyzer starts an analysis into st and messages */
+static void initAnalyzer(Analyzer* a, const ParseContext* ctx, SymTab* st, string& messages)
+{
+    a->ctx = ctx;
+    a->st = st;
+    a->messages = &messages;
+    a->listed = 0;
+    a->unlisted = 0;
+    a->errors = 0;
+    symtabReset(st);
+}
+
+int analyze(const ParseContext* ctx, TreeNode* tree, SymTab* st, string& messages)
+{
+    Analyzer a;
+    initAnalyzer(&a, ctx, st, messages);
+    traverse(&a, tree);
+    finish(&a);
+    return a.errors;
+}
+
+int analyzeFlat(const FlatTree* flat, SymTab* st, string& messages)
+{
+    Analyzer a;
+    initAnalyzer(&a, NULL, st, messages);
+    traverseFlat(&a, flat);
+    finish(&a);
+    return a.errors;
+}
@@ -0,0 +1,45 @@
+/****************************************************/
+/* File: analyze.h                                  */
+/* Semantic analyzer interface for TINY compiler    */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+#include "globals.h"
+#include "symtab.h"
+#include "flat.h"
+#include <string>
+
+#ifndef _ANALYZE_H_
+#define _ANALYZE_H_
+
+/* MAXMESSAGES is the number of problems analyze lists;
+ * any more are only counted
+ */
+#define MAXMESSAGES 100
+
+/* Function analyze builds the symbol table of tree
+ * into st and sets the type of every expression node,
+ * Integer or Boolean. It appends to messages the type
+ * errors and warnings for each variable read but never
+ * given a value, or given a value that is never read;
+ * lines come from ctx->tokens. Arithmetic and
+ * comparisons take integers, and/or take Booleans, an
+ * if, repeat or while test must be Boolean, and an
+ * assigned or written value or a for bound an integer.
+ * & | and # take the type of their operands, which
+ * must agree; since the code generators refuse them,
+ * each use is an error as well. The tree should be
+ * free of syntax errors. Returns the number of type
+ * errors
+ */
+int analyze(const ParseContext* ctx, TreeNode* tree, SymTab* st, std::string& messages);
+
+/* Function analyzeFlat does as analyze for a flat
+ * tree, in one forward pass over its nodes, taking the
+ * lines from flat->line, or 0 if it has none. The
+ * types are kept only while it runs, and the names of
+ * the symbols point into flat
+ */
+int analyzeFlat(const FlatTree* flat, SymTab* st, std::string& messages);
+
+#endif
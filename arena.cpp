@@ -0,0 +1,84 @@
+/****************************************************/
+/* File: arena.cpp                                  */
+/* Bump-pointer arena implementation                */
+/****************************************************/
+
+#include <stdlib.h>
+#include "arena.h"
+
+#define BLOCK_DATA(b) ((char*) (b) + sizeof(ArenaBlock))
+
+void arenaInit(Arena* a)
+{
+    a->head = NULL;
+    a->cur = NULL;
+    a->ptr = NULL;
+    a->end = NULL;
+}
+
+/* enterBlock makes b the block being filled */
+static void enterBlock(Arena* a, ArenaBlock* b)
+{
+    a->cur = b;
+    a->ptr = BLOCK_DATA(b);
+    a->end = a->ptr + b->size;
+}
+
+/* growArena moves to a block with room for n bytes:
+ * a block kept from an earlier parse is reused if it
+ * is big enough, otherwise a new one is linked in
+ * after the current block
+ */
+static int growArena(Arena* a, size_t n)
+{
+    ArenaBlock* next = (a->cur != NULL) ? a->cur->next : a->head;
+    if(next != NULL && next->size >= n) {
+        enterBlock(a, next);
+        return 1;
+    }
+    size_t size = (n > ARENA_BLOCK) ? n : ARENA_BLOCK;
+    ArenaBlock* b = (ArenaBlock*) malloc(sizeof(ArenaBlock) + size);
+    if(b == NULL) {
+        return 0;
+    }
+    b->size = size;
+    b->next = next;
+    if(a->cur != NULL) {
+        a->cur->next = b;
+    } else {
+        a->head = b;
+    }
+    enterBlock(a, b);
+    return 1;
+}
+
+void* arenaAlloc(Arena* a, size_t n)
+{
+    n = (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if((size_t)(a->end - a->ptr) < n || a->ptr == NULL) {
+        if(!growArena(a, n)) {
+            return NULL;
+        }
+    }
+    void* p = a->ptr;
+    a->ptr += n;
+    return p;
+}
+
+void arenaReset(Arena* a)
+{
+    if(a->head != NULL) {
+        enterBlock(a, a->head);
+    }
+}
+
+void arenaFree(Arena* a)
+{
+    ArenaBlock* b = a->head;
+    while(b != NULL) {
+        ArenaBlock* next = b->next;
+        free(b);
+        b = next;
+    }
+    arenaInit(a);
+}
@@ -0,0 +1,49 @@
+/****************************************************/
+/* File: arena.h                                    */
+/* Bump-pointer arena owning the syntax tree nodes  */
+/* and lexemes of one parse                         */
+/****************************************************/
+#include <stddef.h>
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+/* ARENA_BLOCK is the default payload size of one block */
+#define ARENA_BLOCK (64 * 1024)
+
+/* ARENA_ALIGN is the alignment of every allocation,
+ * that of a pointer, so that nodes of 56 bytes pack
+ * without padding */
+#define ARENA_ALIGN 8
+
+typedef struct arenaBlock {
+    struct arenaBlock* next;
+    size_t size;  /* payload bytes following the header */
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head; /* first block, kept across resets */
+    ArenaBlock* cur;  /* block currently being filled */
+    char* ptr;        /* next free byte in cur */
+    char* end;        /* one past the last byte of cur */
+} Arena;
+
+/* Procedure arenaInit makes an empty arena;
+ * no memory is taken until the first allocation
+ */
+void arenaInit(Arena*);
+
+/* Function arenaAlloc returns n bytes from the arena,
+ * or NULL if the system is out of memory
+ */
+void* arenaAlloc(Arena*, size_t n);
+
+/* Procedure arenaReset releases every allocation at
+ * once; the blocks are kept for the next parse
+ */
+void arenaReset(Arena*);
+
+/* Procedure arenaFree returns all blocks to the system */
+void arenaFree(Arena*);
+
+#endif
@@ -0,0 +1,272 @@
+/****************************************************/
+/* File: astcache.cpp                               */
+/* Syntax tree cache implementation                 */
+/****************************************************/
+
+#include <atomic>
+#include "astcache.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+/* A cache file is a CacheHeader followed by the nodes,
+ * the name offsets and the name text of a FlatTree, in
+ * the byte order of the machine that wrote it; a file
+ * of the other byte order fails the version check
+ */
+typedef struct {
+    char magic[8];               /* "TINYAST" */
+    unsigned version;            /* CACHE_VERSION */
+    unsigned layout;             /* CACHE_LAYOUT */
+    unsigned long long hash;     /* of the source */
+    unsigned long long sourceSize;
+    unsigned count;              /* nodes */
+    unsigned nameCount;
+    unsigned long long textSize; /* bytes of name text */
+} CacheHeader;
+
+static const char cacheMagic[8] = "TINYAST";
+
+/* CACHE_LAYOUT tells apart builds whose FlatNode or
+ * enums differ */
+#define CACHE_LAYOUT ((unsigned) sizeof(FlatNode) | (NTOKENTYPES << 8) \
+                      | (NSTMTKINDS << 16) | (NEXPKINDS << 24))
+
+unsigned long long hashSource(const char* data, size_t size)
+{
+    /* eight bytes per multiply, then a final mix so
+     * every input bit reaches every output bit */
+    const unsigned long long k = 0x9e3779b97f4a7c15ULL;
+    unsigned long long h = size * k;
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8) {
+        unsigned long long w;
+        memcpy(&w, data + i, 8);
+        h = (h ^ w) * k;
+        h ^= h >> 32;
+    }
+    if(i < size) {
+        unsigned long long w = 0;
+        memcpy(&w, data + i, size - i);
+        h = (h ^ w) * k;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+string cachePath(const char* dir, unsigned long long hash)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.ast", hash);
+    return dir + string(name);
+}
+
+#ifdef _WIN32
+
+int makeCacheDir(const char* dir)
+{
+    return CreateDirectoryA(dir, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+static unsigned long processId(void)
+{
+    return (unsigned long) GetCurrentProcessId();
+}
+
+static bool replaceFile(const string& from, const string& to)
+{
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+#else
+
+int makeCacheDir(const char* dir)
+{
+    struct stat st;
+    return mkdir(dir, 0777) == 0 || (stat(dir, &st) == 0 && S_ISDIR(st.st_mode));
+}
+
+static unsigned long processId(void)
+{
+    return (unsigned long) getpid();
+}
+
+static bool replaceFile(const string& from, const string& to)
+{
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+
+#endif
+
+static bool hasName(const FlatNode* n)
+{
+    return (n->nodekind == StmtK && (n->kind == AssignK || n->kind == ReadK))
+           || (n->nodekind == ExpK && n->kind == IdK);
+}
+
+/* validChain checks that the sibling chain starting at
+ * node j lies within [j, end) and sets *after to one
+ * past it */
+static bool validChain(const FlatTree* t, unsigned j, unsigned end, unsigned* after)
+{
+    for(;;) {
+        if(j >= end || t->nodes[j].size == 0 || t->nodes[j].size > end - j) {
+            return false;
+        }
+        unsigned next = j + t->nodes[j].size;
+        if(!(t->nodes[j].flags & FLAT_NEXT)) {
+            *after = next;
+            return true;
+        }
+        j = next;
+    }
+}
+
+/* validTree checks everything the printers and
+ * unflattenTree rely on, so a damaged file is a miss
+ * rather than a crash; each node is looked at once by
+ * its own check and once in its parent's chain */
+static bool validTree(const FlatTree* t)
+{
+    unsigned end;
+    if(t->count > 0 && (!validChain(t, 0, t->count, &end) || end != t->count)) {
+        return false;
+    }
+    if(t->nameCount > 0 && (t->textSize == 0 || t->text[t->textSize - 1] != '\0')) {
+        return false;
+    }
+    for(unsigned k = 0; k < t->nameCount; k++) {
+        if(t->nameStart[k] >= t->textSize) {
+            return false;
+        }
+    }
+    for(unsigned i = 0; i < t->count; i++) {
+        const FlatNode* n = &t->nodes[i];
+        if(n->nodekind == StmtK ? n->kind >= NSTMTKINDS
+           : n->nodekind != ExpK || n->kind >= NEXPKINDS) {
+            return false;
+        }
+        if(hasName(n) ? (unsigned) n->attr >= t->nameCount
+           : n->nodekind == ExpK && n->kind != ConstK
+             && (n->attr < 0 || n->attr >= NTOKENTYPES)) {
+            return false;
+        }
+        if(n->flags & ~(FLAT_NEXT | FLAT_CHILD(0) | FLAT_CHILD(1) | FLAT_CHILD(2))) {
+            return false;
+        }
+        unsigned j = i + 1;
+        for(int k = 0; k < MAXCHILDREN; k++) {
+            if((n->flags & FLAT_CHILD(k)) && !validChain(t, j, i + n->size, &j)) {
+                return false;
+            }
+        }
+        if(j != i + n->size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* mapTree points tree into the n bytes of a cache
+ * file; returns false if they are not the tree of a
+ * source with this hash and size */
+static bool mapTree(FlatTree* tree, const char* p, size_t n,
+                    unsigned long long hash, size_t size)
+{
+    CacheHeader h;
+    if(n < sizeof(h)) {
+        return false;
+    }
+    memcpy(&h, p, sizeof(h));
+    if(memcmp(h.magic, cacheMagic, sizeof(h.magic)) != 0 || h.version != CACHE_VERSION
+       || h.layout != CACHE_LAYOUT || h.hash != hash || h.sourceSize != size) {
+        return false;
+    }
+    n -= sizeof(h);
+    if(h.count > n / sizeof(FlatNode)) {
+        return false;
+    }
+    n -= h.count * sizeof(FlatNode);
+    if(h.nameCount > n / sizeof(unsigned)) {
+        return false;
+    }
+    n -= h.nameCount * sizeof(unsigned);
+    if(h.textSize != n) {
+        return false;
+    }
+    p += sizeof(h);
+    tree->nodes = (FlatNode*) p;
+    tree->count = h.count;
+    p += h.count * sizeof(FlatNode);
+    tree->nameStart = (unsigned*) p;
+    tree->nameCount = h.nameCount;
+    p += h.nameCount * sizeof(unsigned);
+    tree->text = (char*) p;
+    tree->textSize = (size_t) h.textSize;
+    return validTree(tree);
+}
+
+int loadCachedTree(CachedTree* cached, const char* dir, const char* data, size_t size)
+{
+    initFlatTree(&cached->tree);
+    unsigned long long hash = hashSource(data, size);
+    if(!mapSource(&cached->file, cachePath(dir, hash).c_str())) {
+        return FALSE;
+    }
+    if(!mapTree(&cached->tree, cached->file.data, cached->file.size, hash, size)) {
+        releaseCachedTree(cached);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void releaseCachedTree(CachedTree* cached)
+{
+    unmapSource(&cached->file);
+    initFlatTree(&cached->tree);
+}
+
+int storeCachedTree(const char* dir, const char* data, size_t size, const FlatTree* flat)
+{
+    CacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, cacheMagic, sizeof(h.magic));
+    h.version = CACHE_VERSION;
+    h.layout = CACHE_LAYOUT;
+    h.hash = hashSource(data, size);
+    h.sourceSize = size;
+    h.count = flat->count;
+    h.nameCount = flat->nameCount;
+    h.textSize = flat->textSize;
+    /* written under a name of its own, then renamed
+     * over the real one */
+    static atomic<unsigned> serial(0);
+    string path = cachePath(dir, h.hash);
+    char suffix[48];
+    snprintf(suffix, sizeof(suffix), ".%lu.%u.tmp", processId(), serial++);
+    string temp = path + suffix;
+    FILE* f = fopen(temp.c_str(), "wb");
+    if(f == NULL) {
+        return FALSE;
+    }
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1
+              && fwrite(flat->nodes, sizeof(FlatNode), flat->count, f) == flat->count
+              && fwrite(flat->nameStart, sizeof(unsigned), flat->nameCount, f) == flat->nameCount
+              && fwrite(flat->text, 1, flat->textSize, f) == flat->textSize;
+    ok = (fclose(f) == 0) && ok;
+    if(!ok || !replaceFile(temp, path)) {
+        remove(temp.c_str());
+        return FALSE;
+    }
+    return TRUE;
+}
@@ -0,0 +1,65 @@
+/****************************************************/
+/* File: astcache.h                                 */
+/* On-disk cache of flat syntax trees, keyed by a   */
+/* hash of the source, mapped back without parsing  */
+/****************************************************/
+#include "globals.h"
+#include "flat.h"
+#include "srcbuf.h"
+#include <string>
+
+#ifndef _ASTCACHE_H_
+#define _ASTCACHE_H_
+
+/* CACHE_VERSION must change with the layout of a
+ * cache file or of FlatNode, or the meaning of any
+ * node kind or operator; files of other versions are
+ * misses and get overwritten
+ */
+#define CACHE_VERSION 1
+
+/* A CachedTree is a tree mapped from a cache file:
+ * the arrays of tree point into the read-only mapping,
+ * so it needs no allocation and must not be changed or
+ * passed to freeFlatTree
+ */
+typedef struct {
+    FlatTree tree;
+    SourceBuffer file;
+} CachedTree;
+
+/* Function hashSource returns the 64-bit key of the
+ * size bytes at data
+ */
+unsigned long long hashSource(const char* data, size_t size);
+
+/* Function cachePath returns the file in dir holding
+ * the tree of sources with the given hash
+ */
+std::string cachePath(const char* dir, unsigned long long hash);
+
+/* Function makeCacheDir creates dir unless it exists;
+ * returns FALSE if it cannot be made
+ */
+int makeCacheDir(const char* dir);
+
+/* Function loadCachedTree maps the tree of the size
+ * bytes at data from dir into cached; returns FALSE,
+ * leaving cached empty, if there is none or the file
+ * is of another version, another source or not a
+ * well-formed tree
+ */
+int loadCachedTree(CachedTree* cached, const char* dir, const char* data, size_t size);
+
+/* Procedure releaseCachedTree unmaps a loaded tree */
+void releaseCachedTree(CachedTree* cached);
+
+/* Function storeCachedTree writes flat to dir as the
+ * tree of the size bytes at data; the file appears
+ * whole or not at all, so concurrent readers and
+ * writers are safe; returns FALSE if it cannot be
+ * written
+ */
+int storeCachedTree(const char* dir, const char* data, size_t size, const FlatTree* flat);
+
+#endif
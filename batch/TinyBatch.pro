@@ -0,0 +1,28 @@
+TEMPLATE = app
+TARGET = TinyBatch
+
+CONFIG += console c++11 thread
+CONFIG -= app_bundle qt
+
+# qmake CONFIG+=stats compiles in the counters --stats reports
+stats: DEFINES += TINY_STATS
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    batch.cpp \
+    ../analyze.cpp \
+    ../arena.cpp \
+    ../astcache.cpp \
+    ../flat.cpp \
+    ../intern.cpp \
+    ../parse.cpp \
+    ../scan.cpp \
+    ../scankern.cpp \
+    ../spans.cpp \
+    ../srcbuf.cpp \
+    ../stats.cpp \
+    ../symtab.cpp \
+    ../tm.cpp \
+    ../util.cpp \
+    ../vm.cpp
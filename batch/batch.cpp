@@ -0,0 +1,500 @@
+/****************************************************/
+/* File: batch.cpp                                  */
+/* Headless batch front end: parses files and       */
+/* directories of TINY programs on a thread pool    */
+/****************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "globals.h"
+#include "util.h"
+#include "parse.h"
+#include "srcbuf.h"
+#include "flat.h"
+#include "astcache.h"
+#include "stats.h"
+#include "tm.h"
+#include "analyze.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: TinyBatch [-j threads] [-o outdir | -m file] [-c cachedir] [-e errors]\n"
+            "                 [-d depth] [--check] [--tm] [--stats] path...\n"
+            "  path    a .tny file, or a directory searched for .tny files\n"
+            "  -j      worker threads (default: number of cores)\n"
+            "  -o      write each tree and its errors to outdir/<path>.tree\n"
+            "  -m      write all trees to one stream, - for stdout (default)\n"
+            "  -c      keep the trees of files without errors in cachedir and\n"
+            "          use them instead of parsing files seen before\n"
+            "  -e      stop parsing a file after this many syntax errors\n"
+            "          (default %d, 0 for no limit)\n"
+            "  -d      limit on the nesting of statements, parentheses and\n"
+            "          operators (default and at most %d, which a 1 MB stack\n"
+            "          can parse and compile; 0 for the default, and a\n"
+            "          larger one is refused)\n"
+            "  --check list the type errors and the variables never given a\n"
+            "          value or never read of files without syntax errors;\n"
+            "          -c is not used with it, as cached trees have no lines\n"
+            "  --tm    write TM code instead of trees, to <path>.tm with -o\n"
+            "  --stats report the performance counters of all files\n", MAXERRORS, MAXNESTING);
+}
+
+/**************************************************/
+/***********   Finding the sources     ************/
+/**************************************************/
+
+typedef struct {
+    string path;
+    size_t size;
+} SourceFile;
+
+static bool isTinyName(const string& name)
+{
+    return name.size() > 4 && name.compare(name.size() - 4, 4, ".tny") == 0;
+}
+
+#ifdef _WIN32
+
+static void addSources(const string& path, vector<SourceFile>& files)
+{
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if(!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info)) {
+        fprintf(stderr, "File %s not found\n", path.c_str());
+        return;
+    }
+    if(!(info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        files.push_back({path, ((size_t) info.nFileSizeHigh << 32) | info.nFileSizeLow});
+        return;
+    }
+    WIN32_FIND_DATAA entry;
+    HANDLE h = FindFirstFileA((path + "\\*").c_str(), &entry);
+    if(h == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    do {
+        string name = entry.cFileName;
+        if(name == "." || name == "..") {
+            continue;
+        }
+        if((entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || isTinyName(name)) {
+            addSources(path + "\\" + name, files);
+        }
+    } while(FindNextFileA(h, &entry));
+    FindClose(h);
+}
+
+static bool makeDir(const string& path)
+{
+    return CreateDirectoryA(path.c_str(), NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+#else
+
+static void addSources(const string& path, vector<SourceFile>& files)
+{
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0) {
+        fprintf(stderr, "File %s not found\n", path.c_str());
+        return;
+    }
+    if(!S_ISDIR(st.st_mode)) {
+        files.push_back({path, (size_t) st.st_size});
+        return;
+    }
+    DIR* dir = opendir(path.c_str());
+    if(dir == NULL) {
+        return;
+    }
+    struct dirent* entry;
+    while((entry = readdir(dir)) != NULL) {
+        string name = entry->d_name;
+        if(name == "." || name == "..") {
+            continue;
+        }
+        string child = path + "/" + name;
+        struct stat cst;
+        if(stat(child.c_str(), &cst) == 0 && (S_ISDIR(cst.st_mode) || isTinyName(name))) {
+            addSources(child, files);
+        }
+    }
+    closedir(dir);
+}
+
+static bool makeDir(const string& path)
+{
+    struct stat st;
+    return mkdir(path.c_str(), 0777) == 0 || (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode));
+}
+
+#endif
+
+/* outputName flattens a source path into one file
+ * name, so sources from different directories cannot
+ * overwrite each other's output
+ */
+static string outputName(const string& outDir, const string& path, const char* suffix)
+{
+    string name = path;
+    for(size_t i = 0; i < name.size(); i++) {
+        if(name[i] == '/' || name[i] == '\\' || name[i] == ':') {
+            name[i] = '_';
+        }
+    }
+    return outDir + "/" + name + suffix;
+}
+
+/**************************************************/
+/***********   Work-stealing pool      ************/
+/**************************************************/
+
+/* each worker owns a queue of file indices: it takes
+ * work from the back of its own queue and, when that
+ * is empty, steals from the front of the others
+ */
+typedef struct {
+    mutex lock;
+    deque<int> jobs;
+} WorkQueue;
+
+static bool takeJob(vector<WorkQueue>& queues, int self, int& job)
+{
+    int n = (int) queues.size();
+    for(int k = 0; k < n; k++) {
+        WorkQueue& q = queues[(self + k) % n];
+        lock_guard<mutex> guard(q.lock);
+        if(!q.jobs.empty()) {
+            if(k == 0) {
+                job = q.jobs.back();
+                q.jobs.pop_back();
+            } else {
+                job = q.jobs.front();
+                q.jobs.pop_front();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    vector<SourceFile> files;
+    string outDir;          /* per-file output if not empty */
+    FILE* merged;           /* otherwise the single stream */
+    mutex mergedLock;
+    atomic<long> failed;    /* files that could not be read or written */
+    atomic<long> withErrors; /* files with syntax errors */
+    atomic<long> withTypeErrors; /* files with type errors, with --check */
+    string cacheDir;        /* -c, or empty */
+    atomic<long> cacheHits; /* files whose tree came from the cache */
+    int maxErrors;          /* -e */
+    int maxNesting;         /* -d */
+    bool wantCheck;         /* --check was given */
+    bool wantTm;            /* --tm was given */
+    bool wantStats;         /* --stats was given */
+    ParseStats stats;       /* the counters of all workers */
+    const ParseStats* totals; /* &stats once counted, else NULL */
+} Batch;
+
+/* readListing returns what a parse wrote to its
+ * listing file since the last rewind
+ */
+static string readListing(FILE* listing)
+{
+    string s;
+    long n = ftell(listing);
+    if(n > 0) {
+        s.resize(n);
+        rewind(listing);
+        s.resize(fread(&s[0], 1, n, listing));
+    }
+    rewind(listing);
+    return s;
+}
+
+/* writeMerged appends the output of one file, after
+ * its error messages, to the single stream
+ */
+static void writeMerged(Batch* batch, const string& path, FILE* scratch, const string& s)
+{
+    string errors = (scratch != NULL) ? readListing(scratch) : "";
+    lock_guard<mutex> guard(batch->mergedLock);
+    fprintf(batch->merged, "==> %s <==\n", path.c_str());
+    if(!errors.empty()) {
+        fprintf(batch->merged, "%s\n", errors.c_str());
+    }
+    fwrite(s.data(), 1, s.size(), batch->merged);
+}
+
+static void worker(Batch* batch, vector<WorkQueue>* queues, int self)
+{
+    ParseContext ctx;
+    initContext(&ctx);
+    ctx.maxErrors = batch->maxErrors;
+    ctx.maxNesting = batch->maxNesting;
+    /* in merged mode the error messages of one file are
+     * collected here and written next to its tree */
+    FILE* scratch = batch->outDir.empty() ? tmpfile() : NULL;
+    string s; /* printed tree or code, reused from file to file */
+    TmProgram prog;
+    FlatTree flat; /* a parsed tree on its way to the cache */
+    initFlatTree(&flat);
+    SymTab symtab;
+    symtabInit(&symtab);
+    string messages;
+    const char* cacheDir = (batch->cacheDir.empty() || batch->wantCheck) ? NULL
+                           : batch->cacheDir.c_str();
+    int job;
+    while(takeJob(*queues, self, job)) {
+        const string& path = batch->files[job].path;
+        SourceBuffer src;
+        if(!mapSource(&src, path.c_str())) {
+            fprintf(stderr, "File %s not found\n", path.c_str());
+            batch->failed++;
+            continue;
+        }
+        FILE* out = NULL;
+        if(!batch->outDir.empty()) {
+            const char* suffix = batch->wantTm ? ".tm" : ".tree";
+            out = fopen(outputName(batch->outDir, path, suffix).c_str(), "w");
+            if(out == NULL) {
+                fprintf(stderr, "Cannot write output of %s\n", path.c_str());
+                batch->failed++;
+                unmapSource(&src);
+                continue;
+            }
+            ctx.listing = out;
+        } else {
+            ctx.listing = (scratch != NULL) ? scratch : stderr;
+        }
+        /* a cached tree is printed straight from the
+           mapping; only TM code needs linked nodes */
+        CachedTree cached;
+        TreeNode* tree = NULL;
+        int errors = FALSE;
+        bool hit = cacheDir != NULL && loadCachedTree(&cached, cacheDir, src.data, src.size);
+        if(hit) {
+            batch->cacheHits++;
+            if(batch->wantTm) {
+                tree = unflattenTree(&ctx, &cached.tree);
+            }
+        } else {
+            tree = parseBuffer(&ctx, src.data, src.size);
+            errors = ctx.Error;
+            if(errors) {
+                batch->withErrors++;
+            } else if(batch->wantCheck) {
+                /* the problems go where syntax errors would */
+                messages.clear();
+                if(analyze(&ctx, tree, &symtab, messages) > 0) {
+                    batch->withTypeErrors++;
+                }
+                fputs(messages.c_str(), ctx.listing);
+            } else if(cacheDir != NULL && flattenTree(&flat, tree, NULL)) {
+                storeCachedTree(cacheDir, src.data, src.size, &flat);
+            }
+        }
+        STATS(double started = statsClock());
+        if(batch->wantTm) {
+            /* code for a tree without syntax errors; the
+               messages go where a tree's would */
+            s.clear();
+            if(!errors && genTm(&prog, tree, TM_ALLOCATE | TM_PEEPHOLE, ctx.listing)) {
+                printTm(&prog, s);
+            }
+            if(out != NULL) {
+                fwrite(s.data(), 1, s.size(), out);
+                fclose(out);
+            } else {
+                writeMerged(batch, path, scratch, s);
+            }
+        } else if(hit) {
+            s.clear();
+            printFlatTree(&cached.tree, s);
+            STATS(ctx.stats.outBytes += s.size());
+            STATS(ctx.stats.seconds[PrintPhase] += statsClock() - started);
+            if(out != NULL) {
+                fwrite(s.data(), 1, s.size(), out);
+                fclose(out);
+            } else {
+                writeMerged(batch, path, scratch, s);
+            }
+        } else if(out != NULL) {
+            if(ctx.Error) {
+                fputc('\n', out);
+            }
+            STATS(long before = ftell(out));
+            printTree(tree, out);
+            STATS(ctx.stats.outBytes += ftell(out) - before);
+            STATS(ctx.stats.seconds[PrintPhase] += statsClock() - started);
+            fclose(out);
+        } else {
+            s.clear();
+            printTree(tree, s, 0);
+            STATS(ctx.stats.outBytes += s.size());
+            STATS(ctx.stats.seconds[PrintPhase] += statsClock() - started);
+            writeMerged(batch, path, scratch, s);
+        }
+        if(hit) {
+            releaseCachedTree(&cached);
+        }
+        releaseTree(&ctx);
+        unmapSource(&src);
+    }
+    if(scratch != NULL) {
+        fclose(scratch);
+    }
+    freeFlatTree(&flat);
+    if(batch->wantStats && parseStats(&ctx) != NULL) {
+        lock_guard<mutex> guard(batch->mergedLock);
+        addStats(&batch->stats, parseStats(&ctx));
+        batch->totals = &batch->stats;
+    }
+    freeContext(&ctx);
+}
+
+int main(int argc, char* argv[])
+{
+    Batch batch;
+    batch.merged = stdout;
+    batch.failed = 0;
+    batch.withErrors = 0;
+    batch.withTypeErrors = 0;
+    batch.cacheHits = 0;
+    batch.maxErrors = MAXERRORS;
+    batch.maxNesting = MAXNESTING;
+    batch.wantCheck = false;
+    batch.wantTm = false;
+    batch.wantStats = false;
+    memset(&batch.stats, 0, sizeof(batch.stats));
+    batch.totals = NULL;
+    int threads = (int) thread::hardware_concurrency();
+    const char* mergedName = NULL;
+    vector<string> paths;
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == "-j" && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if(arg == "-o" && i + 1 < argc) {
+            batch.outDir = argv[++i];
+        } else if(arg == "-m" && i + 1 < argc) {
+            mergedName = argv[++i];
+        } else if(arg == "-e" && i + 1 < argc) {
+            batch.maxErrors = atoi(argv[++i]);
+        } else if(arg == "-d" && i + 1 < argc) {
+            batch.maxNesting = atoi(argv[++i]);
+            /* statements are parsed by native recursion,
+               so no deeper limit can be honoured */
+            if(batch.maxNesting < 0 || batch.maxNesting > MAXNESTING) {
+                fprintf(stderr, "Nesting limit %s is not between 0 and %d\n", argv[i],
+                        MAXNESTING);
+                return 2;
+            }
+        } else if(arg == "-c" && i + 1 < argc) {
+            batch.cacheDir = argv[++i];
+        } else if(arg == "--check") {
+            batch.wantCheck = true;
+        } else if(arg == "--tm") {
+            batch.wantTm = true;
+        } else if(arg == "--stats") {
+            batch.wantStats = true;
+        } else if(arg.size() > 1 && arg[0] == '-') {
+            usage();
+            return 2;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if(paths.empty() || (mergedName != NULL && !batch.outDir.empty())) {
+        usage();
+        return 2;
+    }
+    if(threads < 1) {
+        threads = 1;
+    }
+    if(!batch.outDir.empty() && !makeDir(batch.outDir)) {
+        fprintf(stderr, "Cannot create %s\n", batch.outDir.c_str());
+        return 1;
+    }
+    if(!batch.cacheDir.empty() && !makeCacheDir(batch.cacheDir.c_str())) {
+        fprintf(stderr, "Cannot create %s\n", batch.cacheDir.c_str());
+        return 1;
+    }
+    if(mergedName != NULL && strcmp(mergedName, "-") != 0) {
+        batch.merged = fopen(mergedName, "w");
+        if(batch.merged == NULL) {
+            fprintf(stderr, "Cannot create %s\n", mergedName);
+            return 1;
+        }
+    }
+
+    for(size_t i = 0; i < paths.size(); i++) {
+        addSources(paths[i], batch.files);
+    }
+    /* deal the files out largest first, so every worker
+     * starts with a similar load and stealing evens out
+     * the rest */
+    vector<int> order(batch.files.size());
+    for(size_t i = 0; i < order.size(); i++) {
+        order[i] = (int) i;
+    }
+    sort(order.begin(), order.end(), [&](int a, int b) {
+        return batch.files[a].size > batch.files[b].size;
+    });
+    vector<WorkQueue> queues(threads);
+    size_t bytes = 0;
+    for(size_t i = 0; i < order.size(); i++) {
+        queues[i % threads].jobs.push_front(order[i]);
+        bytes += batch.files[order[i]].size;
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> pool;
+    for(int i = 0; i < threads; i++) {
+        pool.push_back(thread(worker, &batch, &queues, i));
+    }
+    for(size_t i = 0; i < pool.size(); i++) {
+        pool[i].join();
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if(batch.merged != stdout) {
+        fclose(batch.merged);
+    } else {
+        fflush(stdout);
+    }
+
+    if(secs <= 0) {
+        secs = 1e-9;
+    }
+    fprintf(stderr, "%zu files, %.1f MB, %d threads, %.3f s: "
+            "%.0f files/s, %.1f MB/s; %ld with syntax errors, %ld failed\n",
+            batch.files.size(), bytes / 1e6, threads, secs,
+            batch.files.size() / secs, bytes / 1e6 / secs,
+            (long) batch.withErrors, (long) batch.failed);
+    if(batch.wantCheck) {
+        fprintf(stderr, "%ld with type errors\n", (long) batch.withTypeErrors);
+    }
+    if(!batch.cacheDir.empty() && !batch.wantCheck) {
+        fprintf(stderr, "%ld of %zu trees from the cache\n",
+                (long) batch.cacheHits, batch.files.size());
+    }
+    if(batch.wantStats) {
+        printStats(stderr, batch.totals);
+    }
+    return (batch.failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,46 @@
+TEMPLATE = app
+TARGET = TinyBench
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+INCLUDEPATH += ..
+
+HEADERS += \
+    bench.h \
+    gen.h
+
+SOURCES += \
+    analyzebench.cpp \
+    bench.cpp \
+    cachebench.cpp \
+    flatbench.cpp \
+    foldbench.cpp \
+    gen.cpp \
+    kwbench.cpp \
+    pipebench.cpp \
+    reparsebench.cpp \
+    scanbench.cpp \
+    tmbench.cpp \
+    vmbench.cpp \
+    ../analyze.cpp \
+    ../arena.cpp \
+    ../astcache.cpp \
+    ../cmain.cpp \
+    ../flat.cpp \
+    ../fold.cpp \
+    ../intern.cpp \
+    ../jit.cpp \
+    ../parse.cpp \
+    ../reparse.cpp \
+    ../scan.cpp \
+    ../scankern.cpp \
+    ../spans.cpp \
+    ../srcbuf.cpp \
+    ../stats.cpp \
+    ../symtab.cpp \
+    ../tm.cpp \
+    ../util.cpp \
+    ../vm.cpp
+
+win32: LIBS += -lpsapi
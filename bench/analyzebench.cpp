@@ -0,0 +1,135 @@
+/****************************************************/
+/* File: analyzebench.cpp                           */
+/* Benchmark of semantic analysis: a large program  */
+/* analyzed whole and again after every keystroke   */
+/****************************************************/
+
+#include <string>
+#include <vector>
+#include "globals.h"
+#include "util.h"
+#include "parse.h"
+#include "reparse.h"
+#include "analyze.h"
+#include "bench.h"
+
+using namespace std;
+
+/* ANALYZELINES = approximate number of lines analyzed */
+#define ANALYZELINES 100000
+
+/* ANALYZERUNS = number of timed analyses of the whole
+ * program */
+#define ANALYZERUNS 20
+
+/* KEYSTROKES = number of timed edits, each followed by
+ * an analysis as in the editor */
+#define KEYSTROKES 500
+
+/* a fragment of eight lines that parses and type checks
+ * without errors; its names differ from one copy to the
+ * next, so the table grows with the program */
+static const char* fragment =
+    "read n%s;\n"
+    "if (n%s > 0 and not n%s == 13)\n"
+    "  total = 0;;\n"
+    "  k = (n%s * 3 + total) %% 7 / 2 ^ 3;;\n"
+    "  for i = 1 to n%s do total = total + i * i - 0 enddo;\n"
+    "  repeat n%s -= 1 until n%s <= 0;\n"
+    "  for j = 20 downto 1 do write j * 3 enddo\n"
+    "else write k end;\n";
+
+int benchAnalyze(void)
+{
+    string text;
+    char buf[512];
+    for(int i = 0; i < ANALYZELINES / 8; i++) {
+        /* identifiers are letters only: n, then i % 1000
+           in base 26 */
+        char n[8] = "n";
+        for(int k = i % 1000, len = 1; k > 0; k /= 26) {
+            n[len++] = (char)('a' + k % 26);
+        }
+        text.append(buf, snprintf(buf, sizeof(buf), fragment, n, n, n, n, n, n, n));
+    }
+    text += "write total\n";
+    Reparser rp;
+    initReparser(&rp);
+    rp.ctx.listing = stderr;
+    BenchTime t0 = benchNow();
+    reparseAll(&rp, text.data(), text.size());
+    double parse = benchSeconds(t0, benchNow());
+    SymTab st;
+    symtabInit(&st);
+    string messages;
+    int errors = 0;
+    double spent = 0, best = 0;
+    for(int r = 0; r < ANALYZERUNS; r++) {
+        messages.clear();
+        BenchTime t1 = benchNow();
+        errors = analyze(&rp.ctx, rp.tree, &st, messages);
+        double secs = benchSeconds(t1, benchNow());
+        spent += secs;
+        if(r == 0 || secs < best) {
+            best = secs;
+        }
+    }
+    /* each keystroke is reparsed and analyzed before the
+       next: even ones change a digit of a constant, odd
+       ones make it a sum, moving the later tokens */
+    unsigned seed = 12345;
+    double keystrokes = 0, worst = 0;
+    for(int e = 0; e < KEYSTROKES; e++) {
+        seed = seed * 1103515245 + 12345;
+        size_t at = (seed >> 8) % (text.size() - 200);
+        while(text[at] < '0' || text[at] > '9') {
+            at++;
+        }
+        string inserted(1, (char)('0' + (seed >> 4) % 10));
+        if(e % 2 == 1) {
+            inserted += " + 1";
+        }
+        BenchTime t1 = benchNow();
+        reparseEdit(&rp, at, 1, inserted.data(), inserted.size());
+        messages.clear();
+        if(!rp.ctx.Error) {
+            analyze(&rp.ctx, rp.tree, &st, messages);
+        }
+        double secs = benchSeconds(t1, benchNow());
+        text.replace(at, 1, inserted);
+        keystrokes += secs;
+        if(secs > worst) {
+            worst = secs;
+        }
+    }
+    /* the edited tree must analyze as a fresh parse does */
+    ParseContext ctx;
+    initContext(&ctx);
+    ctx.listing = stderr;
+    SymTab fresh;
+    symtabInit(&fresh);
+    string expected;
+    analyze(&ctx, parseBuffer(&ctx, text.data(), text.size()), &fresh, expected);
+    printSymtab(&fresh, expected);
+    printSymtab(&st, messages);
+    int status = 0;
+    if(expected != messages) {
+        fprintf(stderr, "the analysis after editing differs from a fresh one\n");
+        status = 1;
+    }
+    /* the timings are of a program analyze accepts */
+    if(errors != 0) {
+        fprintf(stderr, "the program has %d type errors\n", errors);
+        status = 1;
+    }
+    printf("{\"bench\":\"analyze\",\"lines\":%d,\"tokens\":%d,\"symbols\":%d,"
+           "\"line_refs\":%d,\"type_errors\":%d,\"parse_ms\":%.2f,"
+           "\"analyze_ms_mean\":%.2f,\"analyze_ms_min\":%.2f,\"keystrokes\":%d,"
+           "\"keystroke_ms_mean\":%.2f,\"keystroke_ms_max\":%.2f}\n",
+           ANALYZELINES, rp.ctx.tokens.count, (int) st.symbols.size(), (int) st.lines.size(),
+           errors, parse * 1e3, spent / ANALYZERUNS * 1e3, best * 1e3, KEYSTROKES,
+           keystrokes / KEYSTROKES * 1e3, worst * 1e3);
+    freeContext(&ctx);
+    freeReparser(&rp);
+    return status;
+}
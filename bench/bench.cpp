@@ -0,0 +1,107 @@
+/****************************************************/
+/* File: bench.cpp                                  */
+/* Main program of the TinyBench target: runs the   */
+/* benchmarks named on the command line, or all;    */
+/* name=value arguments set the generated program   */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#ifdef _WIN32
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+#include "bench.h"
+
+size_t benchAllocs = 0;
+size_t benchAllocBytes = 0;
+GenOptions benchGen;
+
+/* operator new is replaced to count allocations; the
+ * array forms call it */
+void* operator new(size_t n)
+{
+    benchAllocs++;
+    benchAllocBytes += n;
+    void* p = malloc(n ? n : 1);
+    if(p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+long benchPeakKB(void)
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return -1;
+    }
+    return (long) (pmc.PeakWorkingSetSize / 1024);
+#else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+#ifdef __APPLE__
+    return (long) (usage.ru_maxrss / 1024); /* in bytes there */
+#else
+    return (long) usage.ru_maxrss;
+#endif
+#endif
+}
+
+static struct {
+    const char* name;
+    int (*run)(void);
+} benches[] = {
+    {"reserved", benchReserved},
+    {"scan", benchScanners},
+    {"flat", benchFlat},
+    {"reparse", benchReparse},
+    {"pipeline", benchPipeline},
+    {"vm", benchVm},
+    {"fold", benchFold},
+    {"tm", benchTm},
+    {"cache", benchCache},
+    {"analyze", benchAnalyze}
+};
+
+#define NBENCHES ((int) (sizeof(benches) / sizeof(benches[0])))
+
+int main(int argc, char* argv[])
+{
+    int status = 0;
+    int named = 0;
+    genDefaults(&benchGen);
+    for(int j = 1; j < argc; j++) {
+        if(strchr(argv[j], '=') == NULL) {
+            named++;
+        } else if(!genOption(&benchGen, argv[j])) {
+            fprintf(stderr, "unknown option %s\n", argv[j]);
+            return 1;
+        }
+    }
+    for(int i = 0; i < NBENCHES; i++) {
+        bool wanted = (named == 0);
+        for(int j = 1; j < argc; j++) {
+            if(strcmp(argv[j], benches[i].name) == 0) {
+                wanted = true;
+            }
+        }
+        if(wanted && benches[i].run() != 0) {
+            fprintf(stderr, "benchmark %s failed\n", benches[i].name);
+            status = 1;
+        }
+    }
+    return status;
+}
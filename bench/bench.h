@@ -0,0 +1,84 @@
+/****************************************************/
+/* File: bench.h                                    */
+/* Benchmarks of the TinyBench target; each prints  */
+/* one JSON object per line on stdout               */
+/****************************************************/
+#include <chrono>
+#include <stddef.h>
+#include "gen.h"
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+typedef std::chrono::steady_clock::time_point BenchTime;
+
+/* benchNow reads the benchmark clock */
+inline BenchTime benchNow(void)
+{
+    return std::chrono::steady_clock::now();
+}
+
+/* benchSeconds returns the seconds between two readings */
+inline double benchSeconds(BenchTime from, BenchTime to)
+{
+    return std::chrono::duration<double>(to - from).count();
+}
+
+/* benchAllocs and benchAllocBytes count the calls of
+ * operator new and the bytes asked for */
+extern size_t benchAllocs;
+extern size_t benchAllocBytes;
+
+/* benchPeakKB returns the peak resident set size of
+ * the process in kilobytes, or -1 if it is unknown */
+long benchPeakKB(void);
+
+/* the options of generated programs, which may be set
+ * on the command line as name=value */
+extern GenOptions benchGen;
+
+/* A BenchProgram is one of the loop-heavy programs
+ * run by the vm and tm benchmarks */
+typedef struct {
+    const char* name;
+    const char* text;
+} BenchProgram;
+
+extern const BenchProgram benchPrograms[];
+extern const int benchProgramCount;
+
+/* reserved word lookup: linear search against the switch */
+int benchReserved(void);
+
+/* whole-buffer scanning: hand-written against table-driven */
+int benchScanners(void);
+
+/* syntax trees: flat array against linked nodes */
+int benchFlat(void);
+
+/* small edits: incremental reparsing against parsing */
+int benchReparse(void);
+
+/* each phase of fun() over a generated program */
+int benchPipeline(void);
+
+/* loop-heavy programs: native code and bytecode
+ * against tree walking */
+int benchVm(void);
+
+/* constant folding: its cost and the nodes it saves */
+int benchFold(void);
+
+/* TM code: instructions executed with and without
+ * register allocation and the peephole pass */
+int benchTm(void);
+
+/* many small files: mapping cached trees against
+ * parsing */
+int benchCache(void);
+
+/* semantic analysis: a large program, whole and
+ * after each keystroke */
+int benchAnalyze(void);
+
+#endif
@@ -0,0 +1,128 @@
+/****************************************************/
+/* File: cachebench.cpp                             */
+/* Benchmark of the syntax tree cache: mapping      */
+/* the trees of many small files against parsing    */
+/****************************************************/
+
+#include <string>
+#include <vector>
+#include "globals.h"
+#include "util.h"
+#include "parse.h"
+#include "flat.h"
+#include "astcache.h"
+#include "bench.h"
+
+using namespace std;
+
+/* CACHEFILES = number of generated sources */
+#define CACHEFILES 10000
+
+/* CACHEBYTES = approximate size of each source */
+#define CACHEBYTES 4096
+
+/* CACHEDIR = where the cache is made; its files are
+ * removed afterwards */
+#define CACHEDIR "TinyBench.cache"
+
+/* hashSink keeps the timed hashing from being optimized
+ * away */
+static volatile unsigned long long hashSink;
+
+int benchCache(void)
+{
+    if(!makeCacheDir(CACHEDIR)) {
+        fprintf(stderr, "cannot create %s\n", CACHEDIR);
+        return 1;
+    }
+    vector<string> sources(CACHEFILES);
+    size_t bytes = 0;
+    for(int i = 0; i < CACHEFILES; i++) {
+        GenOptions opt = benchGen;
+        opt.seed = benchGen.seed + i;
+        opt.bytes = CACHEBYTES;
+        genProgram(&opt, sources[i]);
+        bytes += sources[i].size();
+    }
+    ParseContext ctx;
+    initContext(&ctx);
+    ctx.listing = stderr;
+    FlatTree flat;
+    initFlatTree(&flat);
+    int status = 0;
+
+    /* a cold run parses, flattens and stores each file */
+    size_t cacheBytes = 0;
+    BenchTime t0 = benchNow();
+    for(int i = 0; i < CACHEFILES; i++) {
+        TreeNode* tree = parseBuffer(&ctx, sources[i].data(), sources[i].size());
+        if(!flattenTree(&flat, tree, NULL)
+           || !storeCachedTree(CACHEDIR, sources[i].data(), sources[i].size(), &flat)) {
+            status = 1;
+        }
+        cacheBytes += flat.count * sizeof(FlatNode) + flat.nameCount * sizeof(unsigned)
+                      + flat.textSize;
+        releaseTree(&ctx);
+    }
+    BenchTime t1 = benchNow();
+
+    /* a warm run only maps them */
+    unsigned long nodes = 0;
+    for(int i = 0; i < CACHEFILES; i++) {
+        CachedTree cached;
+        if(!loadCachedTree(&cached, CACHEDIR, sources[i].data(), sources[i].size())) {
+            fprintf(stderr, "a stored tree was not found\n");
+            status = 1;
+            continue;
+        }
+        nodes += cached.tree.count;
+        releaseCachedTree(&cached);
+    }
+    BenchTime t2 = benchNow();
+
+    /* parsing alone, which a hit replaces */
+    for(int i = 0; i < CACHEFILES; i++) {
+        parseBuffer(&ctx, sources[i].data(), sources[i].size());
+        releaseTree(&ctx);
+    }
+    BenchTime t3 = benchNow();
+
+    /* hashing, which a hit or miss always costs */
+    for(int i = 0; i < CACHEFILES; i++) {
+        hashSink += hashSource(sources[i].data(), sources[i].size());
+    }
+    BenchTime t4 = benchNow();
+
+    /* the mapped trees must print as the parsed ones */
+    string parsed, mapped;
+    for(int i = 0; i < CACHEFILES && status == 0; i++) {
+        CachedTree cached;
+        if(!loadCachedTree(&cached, CACHEDIR, sources[i].data(), sources[i].size())) {
+            break;
+        }
+        parsed.clear();
+        mapped.clear();
+        printTree(parseBuffer(&ctx, sources[i].data(), sources[i].size()), parsed, 0);
+        printFlatTree(&cached.tree, mapped);
+        if(parsed != mapped) {
+            fprintf(stderr, "a cached tree prints differently\n");
+            status = 1;
+        }
+        releaseCachedTree(&cached);
+        releaseTree(&ctx);
+    }
+    for(int i = 0; i < CACHEFILES; i++) {
+        unsigned long long hash = hashSource(sources[i].data(), sources[i].size());
+        remove(cachePath(CACHEDIR, hash).c_str());
+    }
+    double load = benchSeconds(t1, t2);
+    double parse = benchSeconds(t2, t3);
+    printf("{\"bench\":\"cache\",\"files\":%d,\"source_mb\":%.1f,\"cache_mb\":%.1f,"
+           "\"nodes\":%lu,\"cold_s\":%.3f,\"warm_s\":%.3f,\"parse_s\":%.3f,"
+           "\"hash_gb_s\":%.1f,\"speedup\":%.1f}\n",
+           CACHEFILES, bytes / 1e6, cacheBytes / 1e6, nodes, benchSeconds(t0, t1), load, parse,
+           bytes / benchSeconds(t3, t4) / 1e9, parse / load);
+    freeFlatTree(&flat);
+    freeContext(&ctx);
+    return status;
+}
@@ -0,0 +1,132 @@
+/****************************************************/
+/* File: flatbench.cpp                              */
+/* Benchmark of the flat syntax tree against the    */
+/* pointer-linked one: size, and the time to print, */
+/* analyze and compile it                           */
+/****************************************************/
+
+#include <string>
+#include "globals.h"
+#include "util.h"
+#include "parse.h"
+#include "flat.h"
+#include "analyze.h"
+#include "vm.h"
+#include "bench.h"
+
+using namespace std;
+
+/* FLATBYTES = approximate size of the parsed text */
+#define FLATBYTES (4 * 1024 * 1024)
+
+/* REPEATS = runs per walk; the fastest is reported */
+#define REPEATS 5
+
+/* a fragment with statements of every kind that parses
+ * without errors, so the tree grows with the text */
+static const char* fragment =
+    "read n;\n"
+    "if (n > 0 and not n == 13)\n"
+    "  total = 0;;\n"
+    "  k = (a & b | c #) % 7 / 2 ^ 3;;\n"
+    "  for i = 1 to n do total = total + i * i - 0 enddo;\n"
+    "  repeat n -= 1 until n <= 0;\n"
+    "  for j = 20 downto 1 do write j < 3 enddo\n"
+    "else write 0 end;\n";
+
+/* best keeps the least of the times of a walk */
+static void best(double* least, int r, BenchTime from, BenchTime to)
+{
+    if(r == 0 || benchSeconds(from, to) < *least) {
+        *least = benchSeconds(from, to);
+    }
+}
+
+int benchFlat(void)
+{
+    string text;
+    while(text.size() < FLATBYTES) {
+        text += fragment;
+    }
+    text += "write 0\n";
+    ParseContext ctx;
+    initContext(&ctx);
+    ctx.listing = stderr;
+    TreeNode* tree = parseBuffer(&ctx, text.data(), text.size());
+    FlatTree flat;
+    initFlatTree(&flat);
+    BenchTime t0 = benchNow();
+    if(!flattenTree(&flat, tree, &ctx)) {
+        fprintf(stderr, "out of memory\n");
+        freeContext(&ctx);
+        return 1;
+    }
+    double flatten = benchSeconds(t0, benchNow());
+    string linked, flatText, linkedProblems, flatProblems;
+    double linkedBest = 0, flatBest = 0, analyzeBest = 0, analyzeFlatBest = 0;
+    SymTab st;
+    symtabInit(&st);
+    for(int r = 0; r < REPEATS; r++) {
+        linked.clear();
+        flatText.clear();
+        linkedProblems.clear();
+        flatProblems.clear();
+        BenchTime t1 = benchNow();
+        printTree(tree, linked, 0);
+        BenchTime t2 = benchNow();
+        printFlatTree(&flat, flatText);
+        BenchTime t3 = benchNow();
+        analyze(&ctx, tree, &st, linkedProblems);
+        BenchTime t4 = benchNow();
+        analyzeFlat(&flat, &st, flatProblems);
+        BenchTime t5 = benchNow();
+        best(&linkedBest, r, t1, t2);
+        best(&flatBest, r, t2, t3);
+        best(&analyzeBest, r, t3, t4);
+        best(&analyzeFlatBest, r, t4, t5);
+    }
+    int status = 0;
+    if(linked != flatText) {
+        fprintf(stderr, "the flat tree prints differently\n");
+        status = 1;
+    }
+    if(linkedProblems != flatProblems) {
+        fprintf(stderr, "the flat tree analyzes differently\n");
+        status = 1;
+    }
+    unsigned count = flat.count;
+    double nodes = count / 1e6;
+    /* the code generators refuse & | and #, so the
+       program compiled has + and - in their place */
+    string runnable = text;
+    for(size_t at = 0; (at = runnable.find("a & b | c #", at)) != string::npos; ) {
+        runnable.replace(at, 11, "a + b - c");
+    }
+    releaseTree(&ctx);
+    tree = parseBuffer(&ctx, runnable.data(), runnable.size());
+    Bytecode bc;
+    double compileBest = 0;
+    if(ctx.Error || !flattenTree(&flat, tree, NULL)) {
+        fprintf(stderr, "the compiled program does not parse\n");
+        status = 1;
+    } else {
+        for(int r = 0; r < REPEATS && status == 0; r++) {
+            BenchTime t1 = benchNow();
+            if(!compileFlatTree(&bc, &flat, stderr)) {
+                status = 1;
+            }
+            best(&compileBest, r, t1, benchNow());
+        }
+    }
+    printf("{\"bench\":\"flat\",\"nodes\":%u,\"tree_bytes_per_node\":%zu,"
+           "\"flat_bytes_per_node\":%zu,\"flatten_mnodes_s\":%.1f,"
+           "\"print_tree_mnodes_s\":%.1f,\"print_flat_mnodes_s\":%.1f,"
+           "\"analyze_tree_mnodes_s\":%.1f,\"analyze_flat_mnodes_s\":%.1f,"
+           "\"compile_flat_mnodes_s\":%.1f}\n",
+           count, sizeof(TreeNode), sizeof(FlatNode), nodes / flatten,
+           nodes / linkedBest, nodes / flatBest, nodes / analyzeBest, nodes / analyzeFlatBest,
+           flat.count / 1e6 / compileBest);
+    freeFlatTree(&flat);
+    freeContext(&ctx);
+    return status;
+}
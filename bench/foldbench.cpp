@@ -0,0 +1,101 @@
+/****************************************************/
+/* File: foldbench.cpp                              */
+/* Benchmark of constant folding over a generated   */
+/* program: its cost and what it saves the printer  */
+/****************************************************/
+
+#include <string>
+#include "globals.h"
+#include "util.h"
+#include "parse.h"
+#include "flat.h"
+#include "fold.h"
+#include "bench.h"
+
+using namespace std;
+
+/* REPEATS = runs per measurement; the fastest counts */
+#define REPEATS 5
+
+/* countNodes returns the number of nodes of a tree */
+static size_t countNodes(const TreeNode* t)
+{
+    size_t n = 0;
+    for(; t != NULL; t = t->sibling) {
+        n++;
+        for(int i = 0; i < MAXCHILDREN; i++) {
+            n += countNodes(t->child[i]);
+        }
+    }
+    return n;
+}
+
+/* printSeconds returns the fastest time to print tree */
+static double printSeconds(TreeNode* tree, size_t* bytes)
+{
+    double best = 0;
+    string s;
+    for(int i = 0; i < REPEATS; i++) {
+        s.clear();
+        BenchTime t0 = benchNow();
+        printTree(tree, s, 0);
+        double seconds = benchSeconds(t0, benchNow());
+        if(i == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    *bytes = s.size();
+    return best;
+}
+
+int benchFold(void)
+{
+    string text;
+    genProgram(&benchGen, text);
+    ParseContext ctx;
+    initContext(&ctx);
+    ctx.listing = stderr;
+    TreeNode* tree = parseBuffer(&ctx, text.data(), text.size());
+    FlatTree flat;
+    initFlatTree(&flat);
+    if(ctx.Error || !flattenTree(&flat, tree, NULL)) {
+        fprintf(stderr, "the generated program has syntax errors\n");
+        freeFlatTree(&flat);
+        freeContext(&ctx);
+        return 1;
+    }
+    size_t before = countNodes(tree);
+    size_t printedBefore;
+    double printBefore = printSeconds(tree, &printedBefore);
+
+    /* each run folds a fresh copy, as the folding is in place */
+    ParseContext copy;
+    initContext(&copy);
+    FoldCounts counts;
+    TreeNode* folded = NULL;
+    double best = 0;
+    for(int i = 0; i < REPEATS; i++) {
+        releaseTree(&copy);
+        TreeNode* t = unflattenTree(&copy, &flat);
+        BenchTime t0 = benchNow();
+        folded = foldTree(t, &counts);
+        double seconds = benchSeconds(t0, benchNow());
+        if(i == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    size_t after = countNodes(folded);
+    size_t printedAfter;
+    double printAfter = printSeconds(folded, &printedAfter);
+
+    printf("{\"bench\":\"fold\",\"nodes_before\":%zu,\"nodes_after\":%zu,"
+           "\"folded\":%d,\"simplified\":%d,\"pruned\":%d,\"fold_s\":%.6f,"
+           "\"nodes_s\":%.0f,\"print_before_s\":%.6f,\"print_after_s\":%.6f,"
+           "\"out_bytes_before\":%zu,\"out_bytes_after\":%zu}\n",
+           before, after, counts.folded, counts.simplified, counts.pruned, best,
+           before / best, printBefore, printAfter, printedBefore, printedAfter);
+    freeContext(&copy);
+    freeFlatTree(&flat);
+    freeContext(&ctx);
+    return 0;
+}
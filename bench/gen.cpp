@@ -0,0 +1,369 @@
+/****************************************************/
+/* File: gen.cpp                                    */
+/* Seeded generator of syntactically valid TINY     */
+/* programs for the benchmarks                      */
+/****************************************************/
+
+#include <string>
+#include "globals.h"
+#include "gen.h"
+
+using namespace std;
+
+/* MAXPARENS = deepest nesting of parenthesized
+ * expressions */
+#define MAXPARENS 2
+
+/* MAXBODY = most statements in a nested sequence */
+#define MAXBODY 4
+
+static const char* kindNames[GENKINDS] = {
+    "assign", "read", "write", "if", "repeat", "for", "dowhile"
+};
+
+/* relational operators, and the ones of the other
+ * precedence levels; & | and # are the Lop ones */
+static const char* relops[] = { "<", "<=", ">", ">=", "==", "<>" };
+static const char* addops[] = { "+", "-" };
+static const char* mulops[] = { "*", "/", "%" };
+
+/* comment texts, with the braces left out */
+static const char* remarks[] = {
+    "sum the squares", "count down", "read the limit",
+    "TODO check the bounds", "loop until done", "x"
+};
+
+#define COUNT(a) ((int) (sizeof(a) / sizeof(a[0])))
+
+/* A Gen is the state of one generated program */
+typedef struct {
+    const GenOptions* opt;
+    unsigned state; /* of the xorshift generator */
+    string* out;
+} Gen;
+
+void genDefaults(GenOptions* opt)
+{
+    opt->seed = 1;
+    opt->bytes = 4 * 1024 * 1024;
+    opt->depth = 4;
+    opt->idents = 64;
+    opt->comments = 5;
+    opt->lops = 10;
+    opt->mix[GenAssign] = 30;
+    opt->mix[GenRead] = 5;
+    opt->mix[GenWrite] = 15;
+    opt->mix[GenIf] = 15;
+    opt->mix[GenRepeat] = 10;
+    opt->mix[GenFor] = 15;
+    opt->mix[GenDoWhile] = 10;
+}
+
+int genOption(GenOptions* opt, const char* arg)
+{
+    const char* eq = strchr(arg, '=');
+    if(eq == NULL) {
+        return FALSE;
+    }
+    string name(arg, eq - arg);
+    long value = strtol(eq + 1, NULL, 10);
+    if(value < 0) {
+        return FALSE;
+    }
+    if(name == "seed") {
+        opt->seed = (unsigned) value;
+    } else if(name == "bytes") {
+        opt->bytes = (size_t) value;
+    } else if(name == "depth") {
+        opt->depth = (int) value;
+    } else if(name == "idents") {
+        opt->idents = (value > 0) ? (int) value : 1;
+    } else if(name == "comments") {
+        opt->comments = (int) value;
+    } else if(name == "lops") {
+        opt->lops = (int) value;
+    } else {
+        for(int k = 0; k < GENKINDS; k++) {
+            if(name == kindNames[k]) {
+                opt->mix[k] = (int) value;
+                return TRUE;
+            }
+        }
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void genOptionsJson(const GenOptions* opt, string& out)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "\"seed\":%u,\"bytes\":%zu,", opt->seed, opt->bytes);
+    out += buf;
+    snprintf(buf, sizeof(buf), "\"depth\":%d,\"idents\":%d,", opt->depth, opt->idents);
+    out += buf;
+    snprintf(buf, sizeof(buf), "\"comments\":%d,\"lops\":%d", opt->comments, opt->lops);
+    out += buf;
+    for(int k = 0; k < GENKINDS; k++) {
+        snprintf(buf, sizeof(buf), ",\"%s\":%d", kindNames[k], opt->mix[k]);
+        out += buf;
+    }
+}
+
+/* below returns a pseudo-random number in [0, n) */
+static int below(Gen* g, int n)
+{
+    unsigned x = g->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    g->state = x;
+    return (int) (x % (unsigned) n);
+}
+
+/* percent is TRUE with the given chance */
+static int percent(Gen* g, int chance)
+{
+    return below(g, 100) < chance;
+}
+
+/* ident writes one of the identifiers: v followed by
+ * its number in base 26, which is never reserved */
+static void ident(Gen* g)
+{
+    int n = below(g, g->opt->idents);
+    *g->out += 'v';
+    do {
+        *g->out += (char) ('a' + n % 26);
+        n /= 26;
+    } while(n > 0);
+}
+
+static void indent(Gen* g, int level)
+{
+    g->out->append(2 * level, ' ');
+}
+
+static void genExp2(Gen* g, int parens);
+
+static void genFactor(Gen* g, int parens)
+{
+    int choice = below(g, 12);
+    if(choice == 0 && parens < MAXPARENS) {
+        *g->out += '(';
+        genExp2(g, parens + 1);
+        *g->out += ')';
+    } else if(choice < 5) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%d", below(g, 1000));
+        *g->out += buf;
+    } else {
+        ident(g);
+    }
+}
+
+/* genTerm writes factor {^ factor} {mulop ...} {#} */
+static void genTerm(Gen* g, int parens)
+{
+    genFactor(g, parens);
+    if(below(g, 8) == 0) {
+        *g->out += " ^ ";
+        genFactor(g, parens);
+    }
+    while(below(g, 5) == 0) {
+        *g->out += ' ';
+        *g->out += mulops[below(g, COUNT(mulops))];
+        *g->out += ' ';
+        genFactor(g, parens);
+    }
+    if(percent(g, g->opt->lops / 2)) {
+        *g->out += " #";
+    }
+}
+
+static void genSimple(Gen* g, int parens)
+{
+    genTerm(g, parens);
+    while(below(g, 4) == 0) {
+        if(percent(g, g->opt->lops)) {
+            *g->out += below(g, 2) ? " & " : " | ";
+        } else {
+            *g->out += ' ';
+            *g->out += addops[below(g, COUNT(addops))];
+            *g->out += ' ';
+        }
+        genTerm(g, parens);
+    }
+}
+
+/* genExp writes a simple expression or a comparison;
+ * not is only written before a comparison, which it
+ * turns around */
+static void genExp(Gen* g, int parens)
+{
+    if(below(g, 2) == 0) {
+        genSimple(g, parens);
+        return;
+    }
+    if(below(g, 6) == 0) {
+        *g->out += "not ";
+    }
+    genSimple(g, parens);
+    *g->out += ' ';
+    *g->out += relops[below(g, COUNT(relops))];
+    *g->out += ' ';
+    genSimple(g, parens);
+}
+
+static void genExp2(Gen* g, int parens)
+{
+    genExp(g, parens);
+    while(below(g, 6) == 0) {
+        *g->out += below(g, 2) ? " and " : " or ";
+        genExp(g, parens);
+    }
+}
+
+/* pickKind draws a statement kind from the mix; below
+ * the deepest level only simple statements are drawn */
+static GenKind pickKind(Gen* g, int level)
+{
+    int compound = (level < g->opt->depth);
+    int total = 0;
+    for(int k = 0; k < GENKINDS; k++) {
+        if(compound || k <= GenWrite) {
+            total += g->opt->mix[k];
+        }
+    }
+    if(total <= 0) {
+        return GenAssign;
+    }
+    int n = below(g, total);
+    for(int k = 0; k < GENKINDS; k++) {
+        if(compound || k <= GenWrite) {
+            n -= g->opt->mix[k];
+            if(n < 0) {
+                return (GenKind) k;
+            }
+        }
+    }
+    return GenAssign;
+}
+
+static void genSequence(Gen* g, int level);
+
+/* genStatement writes one statement at the given
+ * nesting level and returns its kind */
+static GenKind genStatement(Gen* g, int level)
+{
+    if(percent(g, g->opt->comments)) {
+        indent(g, level);
+        *g->out += '{';
+        *g->out += remarks[below(g, COUNT(remarks))];
+        *g->out += "}\n";
+    }
+    GenKind kind = pickKind(g, level);
+    indent(g, level);
+    switch(kind) {
+        case GenAssign:
+            ident(g);
+            if(below(g, 8) == 0) {
+                *g->out += " -= ";
+                genSimple(g, 0);
+            } else {
+                *g->out += " = ";
+                genExp2(g, 0);
+            }
+            break;
+        case GenRead:
+            *g->out += "read ";
+            ident(g);
+            break;
+        case GenWrite:
+            *g->out += "write ";
+            genExp2(g, 0);
+            break;
+        case GenIf:
+            *g->out += "if (";
+            genExp2(g, 0);
+            *g->out += ")\n";
+            genSequence(g, level + 1);
+            if(below(g, 2) == 0) {
+                indent(g, level);
+                *g->out += "else\n";
+                genSequence(g, level + 1);
+            }
+            indent(g, level);
+            *g->out += "end";
+            break;
+        case GenRepeat:
+            *g->out += "repeat\n";
+            genSequence(g, level + 1);
+            indent(g, level);
+            *g->out += "until ";
+            genExp2(g, 0);
+            break;
+        case GenFor:
+            *g->out += "for ";
+            ident(g);
+            *g->out += " = ";
+            genExp2(g, 0);
+            *g->out += below(g, 2) ? " to " : " downto ";
+            genSimple(g, 0);
+            *g->out += " do\n";
+            genSequence(g, level + 1);
+            indent(g, level);
+            *g->out += "enddo";
+            break;
+        case GenDoWhile:
+            *g->out += "do\n";
+            genSequence(g, level + 1);
+            indent(g, level);
+            *g->out += "; while (";
+            genExp2(g, 0);
+            *g->out += ')';
+            break;
+        default:
+            break;
+    }
+    return kind;
+}
+
+/* separator ends a statement that has a successor;
+ * an assignment takes one ';' itself, so it needs two */
+static void separator(Gen* g, GenKind kind)
+{
+    *g->out += (kind == GenAssign) ? ";;\n" : ";\n";
+}
+
+static void genSequence(Gen* g, int level)
+{
+    int n = 1 + below(g, MAXBODY);
+    for(int i = 0; i < n; i++) {
+        GenKind kind = genStatement(g, level);
+        if(i + 1 < n) {
+            separator(g, kind);
+        } else {
+            *g->out += '\n';
+        }
+    }
+}
+
+void genProgram(const GenOptions* opt, string& out)
+{
+    Gen g;
+    g.opt = opt;
+    g.state = opt->seed * 2654435761u + 0x9e3779b9u;
+    if(g.state == 0) {
+        g.state = 1;
+    }
+    g.out = &out;
+    size_t end = out.size() + opt->bytes;
+    for(;;) {
+        GenKind kind = genStatement(&g, 0);
+        if(out.size() >= end) {
+            out += '\n';
+            break;
+        }
+        separator(&g, kind);
+    }
+}
@@ -0,0 +1,49 @@
+/****************************************************/
+/* File: gen.h                                      */
+/* Seeded generator of syntactically valid TINY     */
+/* programs for the benchmarks                      */
+/****************************************************/
+#include <string>
+
+#ifndef _GEN_H_
+#define _GEN_H_
+
+/* GenKind indexes the statement mix of GenOptions */
+typedef enum {
+    GenAssign, GenRead, GenWrite, GenIf, GenRepeat, GenFor, GenDoWhile,
+    GENKINDS
+} GenKind;
+
+typedef struct {
+    unsigned seed;     /* equal seeds give equal programs */
+    size_t bytes;      /* the program stops growing past this size */
+    int depth;         /* deepest nesting of compound statements */
+    int idents;        /* number of distinct identifiers */
+    int comments;      /* percent of statements after a comment */
+    int lops;          /* percent of operators that are & | # */
+    int mix[GENKINDS]; /* relative weight of each statement kind */
+} GenOptions;
+
+/* procedure genDefaults fills in the options the
+ * benchmarks use unless told otherwise
+ */
+void genDefaults(GenOptions* opt);
+
+/* function genOption sets the option named by an
+ * argument of the form name=value, where name is a
+ * field of GenOptions or a GenKind without its prefix
+ * in lower case; returns FALSE if there is no such one
+ */
+int genOption(GenOptions* opt, const char* arg);
+
+/* procedure genOptionsJson appends the options as the
+ * members of a JSON object, without the braces
+ */
+void genOptionsJson(const GenOptions* opt, std::string& out);
+
+/* procedure genProgram appends a program that parses
+ * without errors to out
+ */
+void genProgram(const GenOptions* opt, std::string& out);
+
+#endif
@@ -0,0 +1,95 @@
+/****************************************************/
+/* File: kwbench.cpp                                */
+/* Microbenchmark of reserved word recognition:     */
+/* the old linear search against reservedLookup     */
+/****************************************************/
+
+#include <string>
+#include <vector>
+#include "globals.h"
+#include "scan.h"
+#include "bench.h"
+
+using namespace std;
+
+/* ROUNDS = passes over the word list per method */
+#define ROUNDS 2000
+
+/* the lookup as it was: a string per call and a
+ * linear search over all reserved words
+ */
+static struct {
+    string str;
+    TokenType tok;
+} linearWords[MAXRESERVED]
+= {{"if", IF}, {"then", THEN}, {"else", ELSE}, {"end", END},
+    {"repeat", REPEAT}, {"until", UNTIL}, {"read", READ},
+    {"write", WRITE}, {"do", DO}, {"while", WHILE},
+    {"for", FOR}, {"to", TO}, {"downto", DOWNTO}, {"enddo", ENDDO},
+    {"and", AND}, {"or", OR}, {"not", NOT}
+};
+
+static TokenType linearLookup(string s)
+{
+    for(int i = 0; i < MAXRESERVED; i++)
+        if(s == linearWords[i].str) {
+            return linearWords[i].tok;
+        }
+    return ID;
+}
+
+/* makeWords builds a seeded mix of identifiers and
+ * reserved words, roughly one reserved word in four
+ */
+static vector<string> makeWords(int n)
+{
+    vector<string> words;
+    unsigned seed = 12345;
+    for(int i = 0; i < n; i++) {
+        seed = seed * 1103515245u + 12345u;
+        if((seed >> 16) % 4 == 0) {
+            words.push_back(linearWords[(seed >> 8) % MAXRESERVED].str);
+        } else {
+            string w;
+            int len = 1 + (seed >> 20) % 8;
+            for(int j = 0; j < len; j++) {
+                seed = seed * 1103515245u + 12345u;
+                w += (char) ('a' + (seed >> 16) % 26);
+            }
+            words.push_back(w);
+        }
+    }
+    return words;
+}
+
+int benchReserved(void)
+{
+    vector<string> words = makeWords(10000);
+    long sumLinear = 0, sumSwitch = 0;
+
+    BenchTime t0 = benchNow();
+    for(int r = 0; r < ROUNDS; r++) {
+        for(size_t i = 0; i < words.size(); i++) {
+            sumLinear += linearLookup(words[i].c_str());
+        }
+    }
+    BenchTime t1 = benchNow();
+    for(int r = 0; r < ROUNDS; r++) {
+        for(size_t i = 0; i < words.size(); i++) {
+            sumSwitch += reservedLookup(words[i].c_str(), (int) words[i].size());
+        }
+    }
+    BenchTime t2 = benchNow();
+
+    if(sumLinear != sumSwitch) {
+        fprintf(stderr, "reservedLookup disagrees with linear search\n");
+        return 1;
+    }
+    double n = (double) ROUNDS * words.size();
+    double linearNs = benchSeconds(t0, t1) * 1e9 / n;
+    double switchNs = benchSeconds(t1, t2) * 1e9 / n;
+    printf("{\"bench\":\"reserved\",\"lookups\":%.0f,"
+           "\"linear_ns\":%.2f,\"switch_ns\":%.2f}\n",
+           n, linearNs, switchNs);
+    return 0;
+}
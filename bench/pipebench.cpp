@@ -0,0 +1,224 @@
+/****************************************************/
+/* File: pipebench.cpp                              */
+/* Benchmark of each phase of the compiler over a   */
+/* generated program, and of the whole of fun()     */
+/****************************************************/
+
+#include <string>
+#include "globals.h"
+#include "util.h"
+#include "scan.h"
+#include "parse.h"
+#include "cmain.h"
+#include "gen.h"
+#include "bench.h"
+
+using namespace std;
+
+/* REPEATS = runs per phase; the fastest is reported */
+#define REPEATS 5
+
+/* PIPEFILE = where the program is put for fun() */
+#define PIPEFILE "TinyBench.tny"
+
+/* A Phase collects the measurements of one phase */
+typedef struct {
+    const char* name;
+    double best;      /* seconds of the fastest run */
+    size_t allocs;    /* operator new calls of the last run */
+    size_t allocBytes;
+    double tokens;    /* tokens, nodes and bytes handled */
+    double nodes;     /* by one run, 0 where they are not */
+    double bytes;
+    size_t outBytes;  /* bytes of printed tree */
+} Phase;
+
+static void startPhase(Phase* p, const char* name)
+{
+    p->name = name;
+    p->best = 0;
+    p->allocs = 0;
+    p->allocBytes = 0;
+    p->tokens = 0;
+    p->nodes = 0;
+    p->bytes = 0;
+    p->outBytes = 0;
+}
+
+/* A Run times one run of a phase, and counts what it
+ * allocates through operator new */
+typedef struct {
+    BenchTime start;
+    size_t allocs;
+    size_t allocBytes;
+} Run;
+
+static void startRun(Run* r)
+{
+    r->allocs = benchAllocs;
+    r->allocBytes = benchAllocBytes;
+    r->start = benchNow();
+}
+
+static void endRun(Run* r, Phase* p, int repeat)
+{
+    double seconds = benchSeconds(r->start, benchNow());
+    if(repeat == 0 || seconds < p->best) {
+        p->best = seconds;
+    }
+    p->allocs = benchAllocs - r->allocs;
+    p->allocBytes = benchAllocBytes - r->allocBytes;
+}
+
+/* arenaBytes returns the memory held by an arena */
+static size_t arenaBytes(const Arena* a, size_t* blocks)
+{
+    size_t total = 0;
+    *blocks = 0;
+    for(const ArenaBlock* b = a->head; b != NULL; b = b->next) {
+        total += b->size;
+        (*blocks)++;
+    }
+    return total;
+}
+
+/* countNodes returns the number of nodes of a tree */
+static size_t countNodes(const TreeNode* t)
+{
+    size_t n = 0;
+    for(; t != NULL; t = t->sibling) {
+        n++;
+        for(int i = 0; i < MAXCHILDREN; i++) {
+            n += countNodes(t->child[i]);
+        }
+    }
+    return n;
+}
+
+/* report prints a phase; arena is the one its nodes
+ * went to, or NULL if it is not the bench's own */
+static void report(const Phase* p, const Arena* arena)
+{
+    size_t blocks = 0;
+    size_t held = (arena != NULL) ? arenaBytes(arena, &blocks) : 0;
+    printf("{\"bench\":\"pipeline\",\"phase\":\"%s\",\"seconds\":%.6f,"
+           "\"tokens_s\":%.0f,\"mb_s\":%.1f,\"nodes_s\":%.0f,\"out_bytes\":%zu,"
+           "\"allocs\":%zu,\"alloc_bytes\":%zu,\"arena_blocks\":%zu,"
+           "\"arena_bytes\":%zu,\"peak_rss_kb\":%ld}\n",
+           p->name, p->best, p->tokens / p->best, p->bytes / p->best / 1e6,
+           p->nodes / p->best, p->outBytes, p->allocs, p->allocBytes, blocks,
+           held, benchPeakKB());
+}
+
+int benchPipeline(void)
+{
+    string text;
+    genProgram(&benchGen, text);
+    string options;
+    genOptionsJson(&benchGen, options);
+    ParseContext ctx;
+    initContext(&ctx);
+    ctx.listing = stderr;
+    Phase p;
+    Run r;
+
+    /* getToken alone, one call per token */
+    startPhase(&p, "gettoken");
+    for(int i = 0; i < REPEATS; i++) {
+        startRun(&r);
+        scanBuffer(&ctx, text.data(), text.size());
+        int tokens = 1;
+        while(getToken(&ctx) != ENDFILE) {
+            tokens++;
+        }
+        endRun(&r, &p, i);
+        p.tokens = tokens;
+    }
+    p.bytes = text.size();
+    report(&p, &ctx.arena);
+
+    /* lexBuffer, which parse() reads from */
+    startPhase(&p, "lex");
+    for(int i = 0; i < REPEATS; i++) {
+        startRun(&r);
+        scanBuffer(&ctx, text.data(), text.size());
+        lexBuffer(&ctx);
+        endRun(&r, &p, i);
+    }
+    int tokens = ctx.tokens.count;
+    p.tokens = tokens;
+    p.bytes = text.size();
+    report(&p, &ctx.arena);
+
+    /* parse() of the lexed tokens */
+    startPhase(&p, "parse");
+    TreeNode* tree = NULL;
+    for(int i = 0; i < REPEATS; i++) {
+        releaseTree(&ctx);
+        ctx.Error = FALSE;
+        startRun(&r);
+        tree = parse(&ctx);
+        endRun(&r, &p, i);
+        if(ctx.Error) {
+            fprintf(stderr, "the generated program has syntax errors\n");
+            freeContext(&ctx);
+            return 1;
+        }
+    }
+    size_t nodes = countNodes(tree);
+    p.tokens = tokens;
+    p.nodes = nodes;
+    p.bytes = text.size();
+    report(&p, &ctx.arena);
+
+    /* printTree of the parsed tree */
+    startPhase(&p, "print");
+    string printed;
+    for(int i = 0; i < REPEATS; i++) {
+        printed.clear();
+        startRun(&r);
+        printTree(tree, printed, 0);
+        endRun(&r, &p, i);
+    }
+    p.nodes = nodes;
+    p.bytes = printed.size();
+    p.outBytes = printed.size();
+    report(&p, &ctx.arena);
+
+    /* fun(), from the file name to the printed tree */
+    FILE* f = fopen(PIPEFILE, "wb");
+    if(f == NULL || fwrite(text.data(), 1, text.size(), f) != text.size()) {
+        fprintf(stderr, "cannot write %s\n", PIPEFILE);
+        if(f != NULL) {
+            fclose(f);
+        }
+        freeContext(&ctx);
+        return 1;
+    }
+    fclose(f);
+    startPhase(&p, "fun");
+    char name[] = PIPEFILE;
+    string result;
+    for(int i = 0; i < REPEATS; i++) {
+        result.clear();
+        startRun(&r);
+        result = fun(name);
+        endRun(&r, &p, i);
+    }
+    remove(PIPEFILE);
+    p.tokens = tokens;
+    p.nodes = nodes;
+    p.bytes = text.size();
+    p.outBytes = result.size();
+    report(&p, NULL);
+
+    printf("{\"bench\":\"pipeline\",\"phase\":\"input\",%s,\"text_bytes\":%zu,"
+           "\"tokens\":%d,\"nodes\":%zu}\n",
+           options.c_str(), text.size(), tokens, nodes);
+    freeContext(&ctx);
+    if(result != printed) {
+        fprintf(stderr, "fun() prints a different tree\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,167 @@
+/****************************************************/
+/* File: reparsebench.cpp                           */
+/* Benchmark of incremental reparsing: small edits  */
+/* to a large program against parsing it again      */
+/****************************************************/
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "globals.h"
+#include "util.h"
+#include "parse.h"
+#include "reparse.h"
+#include "bench.h"
+
+using namespace std;
+
+/* REPARSELINES = approximate number of lines edited */
+#define REPARSELINES 100000
+
+/* EDITS = number of timed edits at random places,
+ * half of each kind, and of nearby statement edits */
+#define EDITS 2000
+
+/* a fragment of eight lines that parses without errors */
+static const char* fragment =
+    "read n;\n"
+    "if (n > 0 and not n == 13)\n"
+    "  total = 0;;\n"
+    "  k = (a & b | c #) % 7 / 2 ^ 3;;\n"
+    "  for i = 1 to n do total = total + i * i - 0 enddo;\n"
+    "  repeat n -= 1 until n <= 0;\n"
+    "  for j = 20 downto 1 do write j < 3 enddo\n"
+    "else write 0 end;\n";
+
+/* statements that can be put in front of any line of
+ * the fragment but the last two */
+static const char* inserts[] = {
+    "write 5;\n",
+    "y = 3;;\n",
+    "repeat z = z - 1;; write z until z < 0;\n"
+};
+
+/* statementPlace returns the start of the line of text
+ * holding at, or of a later line if that is one of the
+ * last two of a fragment */
+static size_t statementPlace(const string& text, size_t at)
+{
+    while(at > 0 && text[at - 1] != '\n') {
+        at--;
+    }
+    while(text.compare(at, 4, "else") == 0 || text.compare(at, 4, "  fo") == 0) {
+        at = text.find('\n', at) + 1;
+        at = text.find('\n', at) + 1;
+    }
+    return at;
+}
+
+/* NEARBYSTEP = most bytes between nearby edits */
+#define NEARBYSTEP 200
+
+/* EDITBOUND = seconds within which every edit should
+ * be reparsed; the max is reported against it with
+ * the 99th percentile, which one preempted edit does
+ * not move */
+#define EDITBOUND 1e-3
+
+int benchReparse(void)
+{
+    string text;
+    for(int i = 0; i < REPARSELINES / 8; i++) {
+        text += fragment;
+    }
+    text += "write 0\n";
+    Reparser rp;
+    initReparser(&rp);
+    rp.ctx.listing = stderr;
+    BenchTime t0 = benchNow();
+    reparseAll(&rp, text.data(), text.size());
+    double full = benchSeconds(t0, benchNow());
+    /* even edits change a digit of a constant; odd ones
+       insert a statement that the next one removes */
+    unsigned seed = 12345;
+    double spent[2] = { 0, 0 };
+    vector<double> times;
+    int fallbacks = 0;
+    size_t pending = 0, pendingSize = 0;
+    for(int e = 0; e < EDITS; e++) {
+        seed = seed * 1103515245 + 12345;
+        size_t at = (seed >> 8) % (text.size() - 200);
+        size_t removed = 0;
+        string inserted;
+        if(e % 2 == 0) {
+            while(text[at] < '0' || text[at] > '9') {
+                at++;
+            }
+            removed = 1;
+            inserted = (char)('0' + (seed >> 4) % 10);
+        } else if(pendingSize > 0) {
+            at = pending;
+            removed = pendingSize;
+            pendingSize = 0;
+        } else {
+            at = statementPlace(text, at);
+            inserted = inserts[(seed >> 12) % 3];
+            pending = at;
+            pendingSize = inserted.size();
+        }
+        BenchTime t1 = benchNow();
+        reparseEdit(&rp, at, removed, inserted.data(), inserted.size());
+        double secs = benchSeconds(t1, benchNow());
+        text.replace(at, removed, inserted);
+        spent[e % 2] += secs;
+        times.push_back(secs);
+        fallbacks += rp.full;
+    }
+    /* statements inserted and removed again a few lines
+       apart, as when typing moves down the document:
+       the gaps of the reparser move only that far */
+    double nearby = 0;
+    size_t at = text.size() / 2;
+    for(int e = 0; e < EDITS; e++) {
+        size_t removed = 0;
+        const char* inserted = "";
+        if(e % 2 == 0) {
+            seed = seed * 1103515245 + 12345;
+            at = statementPlace(text, at + (seed >> 8) % NEARBYSTEP);
+            inserted = inserts[(seed >> 12) % 3];
+        } else {
+            removed = strlen(inserts[(seed >> 12) % 3]);
+        }
+        BenchTime t1 = benchNow();
+        reparseEdit(&rp, at, removed, inserted, strlen(inserted));
+        double secs = benchSeconds(t1, benchNow());
+        text.replace(at, removed, inserted);
+        nearby += secs;
+        times.push_back(secs);
+        fallbacks += rp.full;
+    }
+    /* the edited tree must print as a fresh parse does */
+    ParseContext ctx;
+    initContext(&ctx);
+    ctx.listing = stderr;
+    string expected, got;
+    printTree(parseBuffer(&ctx, text.data(), text.size()), expected, 0);
+    printTree(rp.tree, got, 0);
+    string kept;
+    ropeCopy(&rp.text, 0, rp.text.size, kept);
+    int status = 0;
+    if(expected != got || kept != text) {
+        fprintf(stderr, "the reparsed tree differs from a full parse\n");
+        status = 1;
+    }
+    sort(times.begin(), times.end());
+    int over = (int) (times.end() - upper_bound(times.begin(), times.end(), EDITBOUND));
+    printf("{\"bench\":\"reparse\",\"lines\":%d,\"tokens\":%d,\"full_parse_ms\":%.2f,"
+           "\"edits\":%d,\"digit_us_mean\":%.1f,\"statement_us_mean\":%.1f,"
+           "\"nearby_us_mean\":%.1f,\"edit_us_p99\":%.1f,\"edit_us_max\":%.1f,"
+           "\"edit_us_bound\":%.0f,\"edits_over_bound\":%d,\"full_reparses\":%d}\n",
+           REPARSELINES, rp.ctx.tokens.count, full * 1e3, EDITS, spent[0] / (EDITS / 2) * 1e6,
+           spent[1] / (EDITS / 2) * 1e6, nearby / EDITS * 1e6,
+           times[times.size() * 99 / 100] * 1e6, times.back() * 1e6, EDITBOUND * 1e6, over,
+           fallbacks);
+    freeContext(&ctx);
+    freeReparser(&rp);
+    return status;
+}
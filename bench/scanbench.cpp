@@ -0,0 +1,97 @@
+/****************************************************/
+/* File: scanbench.cpp                              */
+/* Benchmark of the two scanners over one large     */
+/* buffer: hand-written switch against table walk   */
+/****************************************************/
+
+#include <string>
+#include <vector>
+#include "globals.h"
+#include "util.h"
+#include "scan.h"
+#include "scankern.h"
+#include "bench.h"
+
+using namespace std;
+
+/* SCANBYTES = approximate size of the scanned text */
+#define SCANBYTES (8 * 1024 * 1024)
+
+/* REPEATS = runs per scanner; the fastest is reported */
+#define REPEATS 5
+
+/* a fragment using every kind of token, with the long
+ * comments and indentation of generated programs */
+static const char* fragment =
+    "{ sum the squares of the numbers from one to n, skipping\n"
+    "  thirteen; this comment is as long as generated ones are }\n"
+    "read n;\n"
+    "if (n > 0 and not n == 13)\n"
+    "  total = 0;;\n"
+    "  for i = 1 to n do total = total + i * i - 0 enddo;\n"
+    "  repeat n -= 1 until n <= 0;\n"
+    "  do k = (a & b | c #) % 7 / 2 ^ 3;; write k ; while (k >= 10 or k <> 3);\n"
+    "  for j = 20 downto 1 do write j < 3 enddo\n"
+    "else write 0 end\n";
+
+typedef TokenType (*Scanner)(ParseContext*);
+
+/* scanAll runs one scanner over the text, recording
+ * the token kinds if kinds is not NULL, and returns
+ * the fastest time of REPEATS runs */
+static double scanAll(Scanner scan, const string& text, vector<unsigned char>* kinds)
+{
+    ParseContext ctx;
+    initContext(&ctx);
+    double best = 0;
+    for(int r = 0; r < REPEATS; r++) {
+        scanBuffer(&ctx, text.data(), text.size());
+        BenchTime t0 = benchNow();
+        TokenType t;
+        do {
+            t = scan(&ctx);
+            if(kinds != NULL && r == 0) {
+                kinds->push_back((unsigned char) t);
+            }
+        } while(t != ENDFILE);
+        double secs = benchSeconds(t0, benchNow());
+        if(r == 0 || secs < best) {
+            best = secs;
+        }
+    }
+    freeContext(&ctx);
+    return best;
+}
+
+int benchScanners(void)
+{
+    static const char* kernels[] = { "scalar", "sse2", "avx2" };
+    string text;
+    while(text.size() < SCANBYTES) {
+        text += fragment;
+    }
+    const ScanKernels* best = scanKernels;
+    vector<unsigned char> switchKinds;
+    /* the first run records the tokens; it is not timed */
+    scanAll(getTokenSwitch, text, &switchKinds);
+    double mb = text.size() / 1e6;
+    printf("{\"bench\":\"scan\",\"bytes\":%zu,\"tokens\":%zu,\"switch_mb_s\":%.1f",
+           text.size(), switchKinds.size(), mb / scanAll(getTokenSwitch, text, NULL));
+    int status = 0;
+    for(int i = 0; i < 3; i++) {
+        if(!selectScanKernels(kernels[i])) {
+            continue;
+        }
+        vector<unsigned char> tableKinds;
+        scanAll(getTokenTable, text, &tableKinds);
+        if(tableKinds != switchKinds) {
+            fprintf(stderr, "the %s table scanner disagrees\n", kernels[i]);
+            status = 1;
+        }
+        printf(",\"table_%s_mb_s\":%.1f", kernels[i],
+               mb / scanAll(getTokenTable, text, NULL));
+    }
+    printf(",\"default\":\"%s\"}\n", best->name);
+    scanKernels = best;
+    return status;
+}
@@ -0,0 +1,91 @@
+/****************************************************/
+/* File: tmbench.cpp                                */
+/* Benchmark of TM code with and without register   */
+/* allocation and the peephole pass                 */
+/****************************************************/
+
+#include <string>
+#include <vector>
+#include "globals.h"
+#include "util.h"
+#include "parse.h"
+#include "vm.h"
+#include "tm.h"
+#include "bench.h"
+
+using namespace std;
+
+/* the option sets compared, from Louden's way of
+ * keeping every temporary in memory to both passes */
+static struct {
+    const char* name;
+    int options;
+} modes[] = {
+    {"memory", 0},
+    {"peephole", TM_PEEPHOLE},
+    {"allocate", TM_ALLOCATE},
+    {"both", TM_ALLOCATE | TM_PEEPHOLE}
+};
+
+#define NMODES ((int) (sizeof(modes) / sizeof(modes[0])))
+
+static int noInput(VmIO*, int*)
+{
+    return FALSE;
+}
+
+static void recordWrite(VmIO* io, int value)
+{
+    ((vector<int>*) io->data)->push_back(value);
+}
+
+int benchTm(void)
+{
+    int status = 0;
+    for(int p = 0; p < benchProgramCount; p++) {
+        ParseContext ctx;
+        initContext(&ctx);
+        ctx.listing = stderr;
+        const char* text = benchPrograms[p].text;
+        TreeNode* tree = parseBuffer(&ctx, text, strlen(text));
+        Bytecode bc;
+        if(ctx.Error || !compileTree(&bc, tree, stderr)) {
+            fprintf(stderr, "program %s does not compile\n", benchPrograms[p].name);
+            freeContext(&ctx);
+            status = 1;
+            continue;
+        }
+        vector<int> expected;
+        VmIO io = { noInput, recordWrite, &expected };
+        int outcome = runBytecode(&bc, &io);
+        long long baseline = 0;
+        for(int m = 0; m < NMODES; m++) {
+            TmProgram prog;
+            BenchTime t0 = benchNow();
+            genTm(&prog, tree, modes[m].options, stderr);
+            BenchTime t1 = benchNow();
+            vector<int> output;
+            io.data = &output;
+            long long steps = 0;
+            int tmOutcome = runTm(&prog, &io, &steps);
+            BenchTime t2 = benchNow();
+            if(tmOutcome != outcome || output != expected) {
+                fprintf(stderr, "program %s runs differently as TM code (%s)\n",
+                        benchPrograms[p].name, modes[m].name);
+                status = 1;
+            }
+            if(m == 0) {
+                baseline = steps;
+            }
+            double run = benchSeconds(t1, t2);
+            printf("{\"bench\":\"tm\",\"program\":\"%s\",\"mode\":\"%s\",\"instructions\":%zu,"
+                   "\"spills\":%d,\"gen_s\":%.6f,\"steps\":%lld,\"steps_saved\":%.3f,"
+                   "\"run_s\":%.4f,\"msteps_s\":%.0f}\n",
+                   benchPrograms[p].name, modes[m].name, prog.code.size(), prog.spills,
+                   benchSeconds(t0, t1), steps, 1.0 - (double) steps / baseline, run,
+                   steps / run / 1e6);
+        }
+        freeContext(&ctx);
+    }
+    return status;
+}
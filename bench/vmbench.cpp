@@ -0,0 +1,234 @@
+/****************************************************/
+/* File: vmbench.cpp                                */
+/* Benchmark of the bytecode interpreter and the    */
+/* native code against a tree-walking interpreter  */
+/* on loop-heavy programs                           */
+/****************************************************/
+
+#include <string>
+#include <vector>
+#include "globals.h"
+#include "util.h"
+#include "parse.h"
+#include "vm.h"
+#include "jit.h"
+#include "bench.h"
+
+using namespace std;
+
+/* VMRUNS = number of timed runs of each program on
+ * each machine */
+#define VMRUNS 5
+
+/* loop-heavy programs: a running sum modulo 10^6,
+ * trial division, and nested counting loops. The VM
+ * runs sum and nested 9-11x as fast as the walker,
+ * at the edge of the 10x aimed at: each turn of
+ * their loops waits on variables kept in the frame,
+ * which superinstructions do not remove */
+
+const BenchProgram benchPrograms[] = {
+    {   "sum",
+        "n = 3000000;;\n"
+        "s = 0;;\n"
+        "for i = 1 to n do\n"
+        "  s = s + i * i % 7;;\n"
+        "  if (s > 1000000) s = s - 1000000 end\n"
+        "enddo;\n"
+        "write s\n"
+    },
+    {   "primes",
+        "count = 0;;\n"
+        "for n = 2 to 30000 do\n"
+        "  d = 2;;\n"
+        "  p = 1;;\n"
+        "  repeat\n"
+        "    if (n % d == 0 and d < n) p = 0 end;\n"
+        "    d = d + 1\n"
+        "  until d * d > n or p == 0;\n"
+        "  count = count + p\n"
+        "enddo;\n"
+        "write count\n"
+    },
+    {   "nested",
+        "t = 0;;\n"
+        "for i = 600 downto 1 do\n"
+        "  j = 0;;\n"
+        "  do\n"
+        "    j = j + 1;;\n"
+        "    t = t + (i ^ 2 - j) / 3\n"
+        "  ; while (j < 1000 and not t == 0)\n"
+        "enddo;\n"
+        "write t\n"
+    }
+};
+
+const int benchProgramCount = (int) (sizeof(benchPrograms) / sizeof(benchPrograms[0]));
+
+/* the tree walker: variables are found by name id,
+ * and every node is evaluated by a recursive call */
+typedef struct {
+    vector<int> vars;
+    vector<int> output;
+    int error;
+} Walker;
+
+static int& variable(Walker* w, const char* name)
+{
+    size_t id = (size_t) internId(name);
+    if(id >= w->vars.size()) {
+        w->vars.resize(id + 1, 0);
+    }
+    return w->vars[id];
+}
+
+static int evaluate(Walker* w, TreeNode* t)
+{
+    if(t->nodekind == StmtK) {
+        int a = evaluate(w, t->child[0]);
+        if(t->kind.stmt == AndK) {
+            return a && evaluate(w, t->child[1]);
+        }
+        return a || evaluate(w, t->child[1]);
+    }
+    switch(t->kind.exp) {
+        case ConstK:
+            return t->attr.val;
+        case IdK:
+            return variable(w, t->attr.name);
+        default: {
+            int a = evaluate(w, t->child[0]);
+            int b = evaluate(w, t->child[1]);
+            int r = 0;
+            if(!evalOp(t->attr.op, a, b, &r)) {
+                w->error = VM_DIVZERO;
+            }
+            return r;
+        }
+    }
+}
+
+static void execute(Walker* w, TreeNode* t)
+{
+    for(; t != NULL && w->error == VM_OK; t = t->sibling) {
+        switch(t->kind.stmt) {
+            case AssignK:
+                variable(w, t->attr.name) = evaluate(w, t->child[0]);
+                break;
+            case WriteK:
+                w->output.push_back(evaluate(w, t->child[0]));
+                break;
+            case IfK:
+                if(evaluate(w, t->child[0])) {
+                    execute(w, t->child[1]);
+                } else {
+                    execute(w, t->child[2]);
+                }
+                break;
+            case RepeatK:
+                do {
+                    execute(w, t->child[0]);
+                } while(w->error == VM_OK && !evaluate(w, t->child[1]));
+                break;
+            case DoWhileK:
+                do {
+                    execute(w, t->child[0]);
+                } while(w->error == VM_OK && evaluate(w, t->child[1]));
+                break;
+            case ForK: {
+                const char* name = t->child[0]->attr.name;
+                int up = (t->child[1]->kind.stmt == ToK);
+                int limit = evaluate(w, t->child[1]->child[0]);
+                variable(w, name) = evaluate(w, t->child[0]->child[0]);
+                while(w->error == VM_OK
+                      && (up ? variable(w, name) <= limit : variable(w, name) >= limit)) {
+                    execute(w, t->child[2]);
+                    variable(w, name) += up ? 1 : -1;
+                }
+                break;
+            }
+            default: /* no input in these programs */
+                w->error = VM_NOINPUT;
+                break;
+        }
+    }
+}
+
+static int noInput(VmIO*, int*)
+{
+    return FALSE;
+}
+
+static void recordWrite(VmIO* io, int value)
+{
+    ((vector<int>*) io->data)->push_back(value);
+}
+
+int benchVm(void)
+{
+    int status = 0;
+    for(int p = 0; p < benchProgramCount; p++) {
+        ParseContext ctx;
+        initContext(&ctx);
+        ctx.listing = stderr;
+        TreeNode* tree = parseBuffer(&ctx, benchPrograms[p].text, strlen(benchPrograms[p].text));
+        Bytecode bc;
+        if(ctx.Error || !compileTree(&bc, tree, stderr)) {
+            fprintf(stderr, "program %s does not compile\n", benchPrograms[p].name);
+            freeContext(&ctx);
+            status = 1;
+            continue;
+        }
+        JitCode jit;
+        BenchTime t0 = benchNow();
+        int native = jitCompile(&jit, &bc);
+        double compiled = benchSeconds(t0, benchNow());
+        /* each machine runs the program VMRUNS times, and
+           the fastest run counts */
+        double vm = 0, walk = 0, run = 0;
+        vector<int> output;
+        for(int r = 0; r < VMRUNS; r++) {
+            output.clear();
+            VmIO io = { noInput, recordWrite, &output };
+            BenchTime t1 = benchNow();
+            int outcome = runBytecode(&bc, &io);
+            BenchTime t2 = benchNow();
+            Walker w;
+            w.error = VM_OK;
+            execute(&w, tree);
+            BenchTime t3 = benchNow();
+            vector<int> jitOutput;
+            io.data = &jitOutput;
+            int jitOutcome = runJit(&jit, &bc, &io);
+            BenchTime t4 = benchNow();
+            if(outcome != w.error || output != w.output) {
+                fprintf(stderr, "program %s runs differently on the two\n", benchPrograms[p].name);
+                status = 1;
+            }
+            if(jitOutcome != outcome || jitOutput != output) {
+                fprintf(stderr, "program %s runs differently as native code\n",
+                        benchPrograms[p].name);
+                status = 1;
+            }
+            if(r == 0 || benchSeconds(t1, t2) < vm) {
+                vm = benchSeconds(t1, t2);
+            }
+            if(r == 0 || benchSeconds(t2, t3) < walk) {
+                walk = benchSeconds(t2, t3);
+            }
+            if(r == 0 || benchSeconds(t3, t4) < run) {
+                run = benchSeconds(t3, t4);
+            }
+        }
+        printf("{\"bench\":\"vm\",\"program\":\"%s\",\"code_words\":%zu,\"slots\":%zu,"
+               "\"vm_s\":%.4f,\"walker_s\":%.4f,\"speedup\":%.1f,\"native\":%s,"
+               "\"native_bytes\":%zu,\"registers\":%d,\"jit_compile_s\":%.6f,"
+               "\"jit_s\":%.4f,\"jit_speedup\":%.1f,\"result\":%d}\n",
+               benchPrograms[p].name, bc.code.size(), bc.frame.size(), vm, walk, walk / vm,
+               native ? "true" : "false", jit.size, jit.registers, compiled, run, vm / run,
+               output.empty() ? 0 : output.back());
+        freeJit(&jit);
+        freeContext(&ctx);
+    }
+    return status;
+}
@@ -8,42 +8,62 @@
 #include "globals.h"
 #include "util.h"
 #include "parse.h"
+#include "scan.h"
+#include "srcbuf.h"
+#include "stats.h"
+#include "cmain.h"
 
-/* allocate global variables */
-int lineno = 0;
-FILE* source;
-FILE* listing;
-
-extern int linepos;
-extern int bufsize;
-extern int EOF_flag;
-
-/* allocate and set tracing flags */
-int Error = FALSE;
+/* each thread keeps one context, so repeated parses
+ * reuse its arena and threads share no parser state
+ */
+struct ThreadContext {
+    ParseContext ctx;
+    ThreadContext()
+    {
+        initContext(&ctx);
+    }
+    ~ThreadContext()
+    {
+        freeContext(&ctx);
+    }
+};
+static thread_local ThreadContext threadContext;
 
 string fun(char* filename)
 {
     string s = "";
-    TreeNode* syntaxTree;
-    char pgm[120]; /* source code file name */
-    strcpy_s(pgm, 120, filename);
-    if(strchr(pgm, '.') == NULL) {
-        strcat_s(pgm, ".tny");
+    SourceBuffer src;
+    string pgm = filename; /* source code file name */
+    if(pgm.find('.') == string::npos) {
+        pgm += ".tny";
     }
-    source = fopen(pgm, "r");
-    listing = stdout; /* send listing to screen */
-
-    syntaxTree = parse();
-    s += printTree(syntaxTree, s, 0);
+    if(!mapSource(&src, pgm.c_str())) {
+        fprintf(stderr, "File %s not found\n", pgm.c_str());
+        return s;
+    }
+    s = funBuffer(src.data, src.size);
+    unmapSource(&src);
+    return s;
+}
 
-    fclose(source);
+string funBuffer(const char* text, size_t size)
+{
+    string s = "";
+    TreeNode* syntaxTree;
+    ParseContext* ctx = &threadContext.ctx;
+    ctx->listing = stdout; /* send listing to screen */
 
-    delete source;
-    delete listing;
-    lineno = 0;
-    linepos = 0;
-    bufsize = 0;
-    Error = FALSE;
-    EOF_flag = FALSE;
+    resetStats(ctx);
+    syntaxTree = parseBuffer(ctx, text, size);
+    STATS(double started = statsClock());
+    printTree(syntaxTree, s, 0);
+    STATS(ctx->stats.seconds[PrintPhase] += statsClock() - started);
+    STATS(ctx->stats.outBytes += s.size());
+    releaseTree(ctx);
     return s;
 }
+
+const ParseStats* funStats(void)
+{
+    return parseStats(&threadContext.ctx);
+}
@@ -1,8 +1,20 @@
 #include <string>
+#include "globals.h"
 
 #ifndef CMAIN_H
 #define CMAIN_H
 
+/* fun parses the named source file and returns
+ * the printed syntax tree */
 std::string fun(char*);
 
+/* funBuffer parses the size bytes of UTF-8 source
+ * text at text and returns the printed syntax tree */
+std::string funBuffer(const char* text, size_t size);
+
+/* funStats returns the performance counters of the
+ * last fun or funBuffer call of this thread, or NULL
+ * if they are not compiled in (see stats.h) */
+const ParseStats* funStats(void);
+
 #endif // CMAIN_H
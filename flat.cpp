@@ -0,0 +1,305 @@
+/****************************************************/
+/* File: flat.cpp                                   */
+/* Flat syntax tree implementation                  */
+/****************************************************/
+
+#include <vector>
+#include "flat.h"
+#include "util.h"
+
+using namespace std;
+
+void initFlatTree(FlatTree* flat)
+{
+    flat->nodes = NULL;
+    flat->line = NULL;
+    flat->count = 0;
+    flat->capacity = 0;
+    flat->nameStart = NULL;
+    flat->nameCount = 0;
+    flat->nameCapacity = 0;
+    flat->text = NULL;
+    flat->textSize = 0;
+    flat->textCapacity = 0;
+}
+
+void freeFlatTree(FlatTree* flat)
+{
+    free(flat->nodes);
+    free(flat->line);
+    free(flat->nameStart);
+    free(flat->text);
+    initFlatTree(flat);
+}
+
+/* hasName tells whether a node's attr is a name */
+static bool hasName(const TreeNode* t)
+{
+    return (t->nodekind == StmtK && (t->kind.stmt == AssignK || t->kind.stmt == ReadK))
+           || (t->nodekind == ExpK && t->kind.exp == IdK);
+}
+
+static bool hasName(const FlatNode* n)
+{
+    return (n->nodekind == StmtK && (n->kind == AssignK || n->kind == ReadK))
+           || (n->nodekind == ExpK && n->kind == IdK);
+}
+
+/* growBuffer makes room for need more elements in a
+ * malloc'd array; returns FALSE if out of memory */
+static int growBuffer(void** buf, size_t used, size_t need, size_t* capacity, size_t elem)
+{
+    if(used + need <= *capacity) {
+        return TRUE;
+    }
+    size_t n = (*capacity == 0) ? 256 : *capacity * 2;
+    while(n < used + need) {
+        n *= 2;
+    }
+    void* p = realloc(*buf, n * elem);
+    if(p == NULL) {
+        return FALSE;
+    }
+    *buf = p;
+    *capacity = n;
+    return TRUE;
+}
+
+/* A FlatStep is work left for flattenChain: a chain to
+ * append, with the shift of the tokens of its first
+ * node as for nodeLine, or with tree NULL, the subtree
+ * of node close to end */
+typedef struct {
+    TreeNode* tree;
+    unsigned close;
+    int shift;
+} FlatStep;
+
+typedef struct {
+    FlatTree* flat;
+    const ParseContext* ctx; /* that made the tree, if lines are kept */
+    vector<int> nameIndex; /* intern id -> name index, or -1 */
+    vector<FlatStep> steps;
+    bool failed;
+} Flattener;
+
+static int addName(Flattener* f, const char* name)
+{
+    FlatTree* flat = f->flat;
+    unsigned id = internId(name);
+    if(id >= f->nameIndex.size()) {
+        f->nameIndex.resize(id + 1, -1);
+    }
+    if(f->nameIndex[id] >= 0) {
+        return f->nameIndex[id];
+    }
+    size_t len = strlen(name) + 1;
+    size_t nameCapacity = flat->nameCapacity;
+    if(!growBuffer((void**) &flat->nameStart, flat->nameCount, 1, &nameCapacity, sizeof(unsigned))
+       || !growBuffer((void**) &flat->text, flat->textSize, len, &flat->textCapacity, 1)) {
+        f->failed = true;
+        return 0;
+    }
+    flat->nameCapacity = (unsigned) nameCapacity;
+    memcpy(flat->text + flat->textSize, name, len);
+    flat->nameStart[flat->nameCount] = (unsigned) flat->textSize;
+    flat->textSize += len;
+    f->nameIndex[id] = (int) flat->nameCount;
+    return (int) flat->nameCount++;
+}
+
+/* flattenChain appends a node, its subtree and its
+ * siblings in preorder, from an explicit stack so deep
+ * trees need no native stack */
+static void flattenChain(Flattener* f, TreeNode* tree)
+{
+    FlatTree* flat = f->flat;
+    f->steps.clear();
+    if(tree != NULL) {
+        f->steps.push_back({tree, 0, 0});
+    }
+    while(!f->steps.empty() && !f->failed) {
+        FlatStep step = f->steps.back();
+        f->steps.pop_back();
+        tree = step.tree;
+        if(tree == NULL) {
+            flat->nodes[step.close].size = flat->count - step.close;
+            continue;
+        }
+        size_t capacity = flat->capacity;
+        if(!growBuffer((void**) &flat->nodes, flat->count, 1, &capacity, sizeof(FlatNode))) {
+            f->failed = true;
+            return;
+        }
+        if(f->ctx != NULL && capacity != flat->capacity) {
+            int* line = (int*) realloc(flat->line, capacity * sizeof(int));
+            if(line == NULL) {
+                f->failed = true;
+                return;
+            }
+            flat->line = line;
+        }
+        flat->capacity = (unsigned) capacity;
+        unsigned i = flat->count++;
+        FlatNode* n = &flat->nodes[i];
+        int shift = step.shift;
+        if(f->ctx != NULL) {
+            flat->line[i] = nodeLine(f->ctx, tree, shift);
+            shift += nodeShift(f->ctx, tree);
+        }
+        n->nodekind = (unsigned char) tree->nodekind;
+        n->kind = (unsigned char)((tree->nodekind == StmtK) ? (int) tree->kind.stmt
+                                   : (int) tree->kind.exp);
+        n->flags = (tree->sibling != NULL) ? FLAT_NEXT : 0;
+        n->unused = 0;
+        if(hasName(tree)) {
+            n->attr = addName(f, tree->attr.name);
+        } else if(tree->nodekind == ExpK && tree->kind.exp == ConstK) {
+            n->attr = tree->attr.val;
+        } else {
+            n->attr = (int) tree->attr.op;
+        }
+        /* the children come out first, in order, then the
+           end of this subtree, then the sibling */
+        if(tree->sibling != NULL) {
+            f->steps.push_back({tree->sibling, 0, shift});
+        }
+        f->steps.push_back({NULL, i, 0});
+        for(int k = MAXCHILDREN - 1; k >= 0; k--) {
+            if(tree->child[k] != NULL) {
+                n->flags |= FLAT_CHILD(k);
+                f->steps.push_back({tree->child[k], 0, shift});
+            }
+        }
+    }
+}
+
+int flattenTree(FlatTree* flat, TreeNode* tree, const ParseContext* ctx)
+{
+    Flattener f;
+    f.flat = flat;
+    f.ctx = ctx;
+    f.failed = false;
+    /* the lines grow with the nodes, so they start at
+       the capacity already reached */
+    if(ctx == NULL) {
+        free(flat->line);
+        flat->line = NULL;
+    } else if(flat->line == NULL && flat->capacity > 0) {
+        flat->line = (int*) malloc(flat->capacity * sizeof(int));
+        if(flat->line == NULL) {
+            return FALSE;
+        }
+    }
+    flat->count = 0;
+    flat->nameCount = 0;
+    flat->textSize = 0;
+    flattenChain(&f, tree);
+    return !f.failed;
+}
+
+const char* flatName(const FlatTree* flat, const FlatNode* node)
+{
+    return flat->text + flat->nameStart[node->attr];
+}
+
+unsigned flatChild(const FlatTree* flat, unsigned i, int k)
+{
+    const FlatNode* n = &flat->nodes[i];
+    if(!(n->flags & FLAT_CHILD(k))) {
+        return 0;
+    }
+    /* the chains of the earlier children come first */
+    unsigned j = i + 1;
+    for(int c = 0; c < k; c++) {
+        if(n->flags & FLAT_CHILD(c)) {
+            while(flat->nodes[j].flags & FLAT_NEXT) {
+                j += flat->nodes[j].size;
+            }
+            j += flat->nodes[j].size;
+        }
+    }
+    return j;
+}
+
+/* buildChain rebuilds the nodes in preorder; links
+ * holds the pointers the next nodes go into, the top
+ * one first, so deep trees need no native stack */
+static TreeNode* buildChain(ParseContext* ctx, const FlatTree* flat,
+                            const vector<char*>& names)
+{
+    TreeNode* first = NULL;
+    vector<TreeNode**> links(1, &first);
+    for(unsigned i = 0; i < flat->count && !links.empty(); i++) {
+        const FlatNode* n = &flat->nodes[i];
+        TreeNode* t = (n->nodekind == StmtK) ? newStmtNode(ctx, (StmtKind) n->kind)
+                      : newExpNode(ctx, (ExpKind) n->kind);
+        if(t == NULL) {
+            break;
+        }
+        nodeToken(ctx, t)->token = -1;
+        *links.back() = t;
+        links.pop_back();
+        if(hasName(n)) {
+            t->attr.name = names[n->attr];
+        } else if(n->nodekind == ExpK && n->kind == ConstK) {
+            t->attr.val = n->attr;
+        } else {
+            t->attr.op = (TokenType) n->attr;
+        }
+        if(n->flags & FLAT_NEXT) {
+            links.push_back(&t->sibling);
+        }
+        for(int k = MAXCHILDREN - 1; k >= 0; k--) {
+            if(n->flags & FLAT_CHILD(k)) {
+                links.push_back(&t->child[k]);
+            }
+        }
+    }
+    return first;
+}
+
+TreeNode* unflattenTree(ParseContext* ctx, const FlatTree* flat)
+{
+    if(flat->count == 0) {
+        return NULL;
+    }
+    vector<char*> names(flat->nameCount);
+    for(unsigned k = 0; k < flat->nameCount; k++) {
+        const char* name = flat->text + flat->nameStart[k];
+        names[k] = internName(ctx, name, (int) strlen(name));
+    }
+    return buildChain(ctx, flat, names);
+}
+
+void printFlatTree(const FlatTree* flat, string& s)
+{
+    /* ends holds one past the subtree of each open node;
+     * the indentation is the number still open */
+    vector<unsigned> ends;
+    TreeNode label;
+    for(unsigned i = 0; i < flat->count; i++) {
+        const FlatNode* n = &flat->nodes[i];
+        while(!ends.empty() && ends.back() <= i) {
+            ends.pop_back();
+        }
+        s.append(2 * ends.size(), ' ');
+        label.nodekind = (NodeKind) n->nodekind;
+        if(n->nodekind == StmtK) {
+            label.kind.stmt = (StmtKind) n->kind;
+        } else {
+            label.kind.exp = (ExpKind) n->kind;
+        }
+        if(hasName(n)) {
+            label.attr.name = (char*) flatName(flat, n);
+        } else if(n->nodekind == ExpK && n->kind == ConstK) {
+            label.attr.val = n->attr;
+        } else {
+            label.attr.op = (TokenType) n->attr;
+        }
+        printNodeLine(s, &label);
+        if(n->size > 1) {
+            ends.push_back(i + n->size);
+        }
+    }
+}
@@ -0,0 +1,91 @@
+/****************************************************/
+/* File: flat.h                                     */
+/* Flat syntax tree: nodes in one array in preorder */
+/* with 32-bit sizes instead of child pointers      */
+/****************************************************/
+#include "globals.h"
+#include <string>
+
+#ifndef _FLAT_H_
+#define _FLAT_H_
+
+/* flags of a FlatNode: bit k is set when child[k] of
+ * the TreeNode was present; FLAT_NEXT when it had a
+ * sibling
+ */
+#define FLAT_CHILD(k) (1 << (k))
+#define FLAT_NEXT 0x08
+
+/* A FlatNode is one node of the tree; the subtree of
+ * node i (not its siblings) fills indices i to
+ * i + size - 1, starting with the sibling chains of
+ * its children in child order, and its next sibling,
+ * if FLAT_NEXT is set, is node i + size
+ */
+typedef struct {
+    unsigned char nodekind; /* NodeKind */
+    unsigned char kind;     /* StmtKind or ExpKind */
+    unsigned char flags;
+    unsigned char unused;
+    int attr;               /* op, val, or name index */
+    unsigned size;
+} FlatNode;
+
+/* A FlatTree owns its nodes and the text of its names;
+ * name i is the NUL-terminated string at text + nameStart[i].
+ * printFlatTree, analyzeFlat, compileFlatTree, which
+ * compileTree goes through, and the tree cache walk it;
+ * analyze keeps a walk of the TreeNode tree for the
+ * reparser's trees, and foldTree and genTm walk only
+ * that, so the parse worker goes through unflattenTree
+ * to fold a copy
+ */
+typedef struct {
+    FlatNode* nodes;
+    int* line; /* source line of each node, or NULL */
+    unsigned count;
+    unsigned capacity;
+    unsigned* nameStart;
+    unsigned nameCount;
+    unsigned nameCapacity;
+    char* text;
+    size_t textSize;
+    size_t textCapacity;
+} FlatTree;
+
+/* Procedure initFlatTree makes an empty flat tree */
+void initFlatTree(FlatTree*);
+
+/* Procedure freeFlatTree returns its memory */
+void freeFlatTree(FlatTree*);
+
+/* Function flattenTree stores the tree, with all its
+ * siblings, into flat, replacing its contents; with a
+ * ctx, the one that made the tree, it stores the line
+ * of each node too, else line is NULL. Returns FALSE
+ * if out of memory
+ */
+int flattenTree(FlatTree* flat, TreeNode* tree, const ParseContext* ctx);
+
+/* Function unflattenTree rebuilds the pointer-linked
+ * tree in the arena of ctx
+ */
+TreeNode* unflattenTree(ParseContext* ctx, const FlatTree* flat);
+
+/* Function flatName returns the name of an AssignK,
+ * ReadK or IdK node; equal names of one tree have
+ * equal addresses
+ */
+const char* flatName(const FlatTree* flat, const FlatNode* node);
+
+/* Function flatChild returns the index of the first
+ * node of child k of node i, or 0 if it has none
+ */
+unsigned flatChild(const FlatTree* flat, unsigned i, int k);
+
+/* Procedure printFlatTree appends the tree to s in the
+ * format of printTree, in one forward pass over nodes
+ */
+void printFlatTree(const FlatTree* flat, std::string& s);
+
+#endif
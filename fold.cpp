@@ -0,0 +1,277 @@
+/****************************************************/
+/* File: fold.cpp                                   */
+/* Constant folding and algebraic simplification    */
+/* of syntax trees                                  */
+/****************************************************/
+
+#include "globals.h"
+#include "vm.h"
+#include "fold.h"
+
+static int isConst(const TreeNode* t)
+{
+    return t != NULL && t->nodekind == ExpK && t->kind.exp == ConstK;
+}
+
+static int isConst(const TreeNode* t, int value)
+{
+    return isConst(t) && t->attr.val == value;
+}
+
+static int isRelop(TokenType op)
+{
+    return op == LT || op == LTE || op == GT || op == GTE || op == EQ || op == NE;
+}
+
+/* isLogical tells whether t is an And, Or or comparison,
+ * or a constant 0 or 1, so its value is 0 or 1 */
+static int isLogical(const TreeNode* t)
+{
+    if(t->nodekind == StmtK) {
+        return t->kind.stmt == AndK || t->kind.stmt == OrK;
+    }
+    if(t->kind.exp == ConstK) {
+        return t->attr.val == 0 || t->attr.val == 1;
+    }
+    return t->kind.exp == OpK && isRelop(t->attr.op);
+}
+
+/* canFail tells whether evaluating t might divide by
+ * zero, in which case it must not be dropped */
+static int canFail(const TreeNode* t)
+{
+    if(t == NULL || isConst(t) || (t->nodekind == ExpK && t->kind.exp == IdK)) {
+        return FALSE;
+    }
+    if(t->nodekind == ExpK && t->kind.exp == OpK
+       && (t->attr.op == OVER || t->attr.op == MOD)
+       && (!isConst(t->child[1]) || t->child[1]->attr.val == 0)) {
+        return TRUE;
+    }
+    for(int i = 0; i < MAXCHILDREN; i++) {
+        if(canFail(t->child[i])) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* makeConst turns node t into the constant value */
+static TreeNode* makeConst(TreeNode* t, int value)
+{
+    t->nodekind = ExpK;
+    t->kind.exp = ConstK;
+    t->attr.val = value;
+    for(int i = 0; i < MAXCHILDREN; i++) {
+        t->child[i] = NULL;
+    }
+    return t;
+}
+
+/* foldOp simplifies an OpK node whose operands are
+ * already folded */
+static TreeNode* foldOp(TreeNode* t, FoldCounts* n)
+{
+    TreeNode* a = t->child[0];
+    TreeNode* b = t->child[1];
+    if(a == NULL || b == NULL) {
+        return t;
+    }
+    TokenType op = t->attr.op;
+    int value;
+    if(isConst(a) && isConst(b) && evalOp(op, a->attr.val, b->attr.val, &value)) {
+        n->folded++;
+        return makeConst(t, value);
+    }
+    switch(op) {
+        case PLUS:
+            if(isConst(b, 0)) {
+                n->simplified++;
+                return a;
+            }
+            if(isConst(a, 0)) {
+                n->simplified++;
+                return b;
+            }
+            break;
+        case MINUS:
+            if(isConst(b, 0)) {
+                n->simplified++;
+                return a;
+            }
+            break;
+        case TIMES:
+            if(isConst(b, 1)) {
+                n->simplified++;
+                return a;
+            }
+            if(isConst(a, 1)) {
+                n->simplified++;
+                return b;
+            }
+            if((isConst(a, 0) && !canFail(b)) || (isConst(b, 0) && !canFail(a))) {
+                n->simplified++;
+                return makeConst(t, 0);
+            }
+            break;
+        case OVER:
+            if(isConst(b, 1)) {
+                n->simplified++;
+                return a;
+            }
+            break;
+        case POWER:
+            if(isConst(b, 1)) {
+                n->simplified++;
+                return a;
+            }
+            if(isConst(b, 0) && !canFail(a)) {
+                n->simplified++;
+                return makeConst(t, 1);
+            }
+            break;
+        default:
+            break;
+    }
+    return t;
+}
+
+/* foldLogic simplifies an And or Or node whose
+ * operands are already folded; the result must still
+ * be 0 or 1 */
+static TreeNode* foldLogic(TreeNode* t, FoldCounts* n)
+{
+    TreeNode* a = t->child[0];
+    TreeNode* b = t->child[1];
+    if(a == NULL || b == NULL) {
+        return t;
+    }
+    int isAnd = (t->kind.stmt == AndK);
+    if(isConst(a)) {
+        /* 0 and x, 1 or x: decided by a */
+        if((a->attr.val != 0) != isAnd) {
+            n->folded++;
+            return makeConst(t, !isAnd);
+        }
+        /* 1 and x, 0 or x: the truth of x */
+        if(isConst(b)) {
+            n->folded++;
+            return makeConst(t, b->attr.val != 0);
+        }
+        if(isLogical(b)) {
+            n->simplified++;
+            return b;
+        }
+    } else if(isConst(b)) {
+        if((b->attr.val != 0) != isAnd) {
+            if(!canFail(a)) {
+                n->simplified++;
+                return makeConst(t, !isAnd);
+            }
+        } else if(isLogical(a)) {
+            n->simplified++;
+            return a;
+        }
+    }
+    return t;
+}
+
+/* foldExp folds an expression and returns the node
+ * that replaces it */
+static TreeNode* foldExp(TreeNode* t, FoldCounts* n)
+{
+    if(t == NULL) {
+        return NULL;
+    }
+    for(int i = 0; i < MAXCHILDREN; i++) {
+        t->child[i] = foldExp(t->child[i], n);
+    }
+    if(t->nodekind == StmtK) {
+        return (t->kind.stmt == AndK || t->kind.stmt == OrK) ? foldLogic(t, n) : t;
+    }
+    return (t->kind.exp == OpK) ? foldOp(t, n) : t;
+}
+
+static TreeNode* foldStatements(TreeNode* t, FoldCounts* n);
+
+/* foldStatement folds one statement, whose sibling has
+ * been cut off, and returns the list replacing it */
+static TreeNode* foldStatement(TreeNode* t, FoldCounts* n)
+{
+    switch(t->kind.stmt) {
+        case AssignK:
+        case WriteK:
+            t->child[0] = foldExp(t->child[0], n);
+            return t;
+        case IfK:
+            t->child[0] = foldExp(t->child[0], n);
+            t->child[1] = foldStatements(t->child[1], n);
+            t->child[2] = foldStatements(t->child[2], n);
+            if(isConst(t->child[0])) {
+                n->pruned++;
+                return t->child[(t->child[0]->attr.val != 0) ? 1 : 2];
+            }
+            return t;
+        case RepeatK:
+        case DoWhileK:
+            t->child[0] = foldStatements(t->child[0], n);
+            t->child[1] = foldExp(t->child[1], n);
+            /* repeat until true and do while false run once */
+            if(isConst(t->child[1])
+               && (t->child[1]->attr.val != 0) == (t->kind.stmt == RepeatK)) {
+                n->pruned++;
+                return t->child[0];
+            }
+            return t;
+        case ForK: {
+            TreeNode* start = t->child[0];
+            TreeNode* limit = t->child[1];
+            if(start != NULL) {
+                start->child[0] = foldExp(start->child[0], n);
+            }
+            if(limit != NULL) {
+                limit->child[0] = foldExp(limit->child[0], n);
+            }
+            t->child[2] = foldStatements(t->child[2], n);
+            if(start != NULL && limit != NULL && isConst(start->child[0])
+               && isConst(limit->child[0])) {
+                int from = start->child[0]->attr.val;
+                int to = limit->child[0]->attr.val;
+                if((limit->kind.stmt == ToK) ? from > to : from < to) {
+                    n->pruned++;
+                    start->sibling = NULL;
+                    return start;
+                }
+            }
+            return t;
+        }
+        default:
+            return t;
+    }
+}
+
+static TreeNode* foldStatements(TreeNode* t, FoldCounts* n)
+{
+    TreeNode* head = NULL;
+    TreeNode** link = &head;
+    while(t != NULL) {
+        TreeNode* next = t->sibling;
+        t->sibling = NULL;
+        *link = foldStatement(t, n);
+        while(*link != NULL) {
+            link = &(*link)->sibling;
+        }
+        t = next;
+    }
+    return head;
+}
+
+TreeNode* foldTree(TreeNode* tree, FoldCounts* counts)
+{
+    FoldCounts n = { 0, 0, 0 };
+    tree = foldStatements(tree, &n);
+    if(counts != NULL) {
+        *counts = n;
+    }
+    return tree;
+}
@@ -0,0 +1,37 @@
+/****************************************************/
+/* File: fold.h                                     */
+/* Constant folding and algebraic simplification    */
+/* of syntax trees                                  */
+/****************************************************/
+#include "globals.h"
+
+#ifndef _FOLD_H_
+#define _FOLD_H_
+
+/* A FoldCounts tells what one foldTree did */
+typedef struct {
+    int folded;     /* operators on constants replaced by their value */
+    int simplified; /* identities such as x + 0 applied */
+    int pruned;     /* statements decided by a constant condition */
+} FoldCounts;
+
+/* Function foldTree simplifies a syntax tree bottom-up
+ * in place, with the arithmetic of the VM, and returns
+ * its new first statement:
+ *   operators on constants become constants, except
+ *   division or % by zero, which is left to fail at
+ *   run time;
+ *   x+0, 0+x, x-0, x*1, 1*x, x/1 and x^1 become x, and
+ *   x*0, 0*x and x^0 become constants when x cannot
+ *   fail; and/or with a constant operand are decided
+ *   where that keeps their 0 or 1 value;
+ *   an if with a constant condition becomes the branch
+ *   taken, a repeat that ends at once or a do-while
+ *   that does not loop becomes its body, and a for
+ *   that never runs becomes its first assignment.
+ * No node is allocated; the nodes left out stay in the
+ * arena. counts may be NULL
+ */
+TreeNode* foldTree(TreeNode* tree, FoldCounts* counts);
+
+#endif
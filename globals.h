@@ -13,6 +13,10 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <atomic>
+
+#include "arena.h"
+#include "intern.h"
 
 #ifndef FALSE
     #define FALSE 0
@@ -39,11 +43,6 @@ typedef enum
     LTE, GT, GTE, NE, LINK, LOR, CLOSURE
 } TokenType;
 
-extern FILE* source; /* source code text file */
-extern FILE* listing; /* listing output text file */
-
-extern int lineno; /* source line number for listing */
-
 /**************************************************/
 /***********   Syntax tree for parsing ************/
 /**************************************************/
@@ -55,8 +54,11 @@ typedef enum { IfK, RepeatK, AssignK, ReadK, WriteK,
              } StmtKind;  // 语句
 typedef enum { OpK, ConstK, IdK, LopK } ExpKind;
 
-/* ExpType is used for type checking */
-//typedef enum { Void, Integer, Boolean } ExpType;
+/* ExpType is used for type checking; a Boolean is
+ * the 0 or 1 of a comparison, and Void marks an
+ * expression already found to be in error
+ */
+typedef enum { Void, Integer, Boolean } ExpType;
 
 #define MAXCHILDREN 3
 
@@ -73,13 +75,241 @@ typedef struct treeNode {
         int val;
         char* name;
     } attr;
-    //    ExpType type; /* for type checking of exps */
+    ExpType type; /* for type checking of exps */
+    int id; /* of its NodeToken in the context that made it */
 } TreeNode;
 
+/* A NodeToken gives the token a node was made at, kept
+ * apart from the node so that the passes over the tree
+ * do not load it: token is its index in ctx->tokens,
+ * which gives the node's line, less the sum of shift
+ * over the node, its ancestors and the earlier
+ * siblings of both, or -1 for a node not made by the
+ * parser. shift moves the tokens of a node, its
+ * children and its later siblings: the reparser
+ * shifts all that follows an edit in a list there
+ * rather than renumbering its nodes
+ */
+typedef struct {
+    int token;
+    int shift;
+} NodeToken;
+
+/**************************************************/
+/***********   Performance counters    ************/
+/**************************************************/
+
+/* the number of TokenTypes, StmtKinds and ExpKinds */
+#define NTOKENTYPES (CLOSURE + 1)
+#define NSTMTKINDS (OrK + 1)
+#define NEXPKINDS (LopK + 1)
+
+/* the phases timed by the counters */
+typedef enum { LexPhase, ParsePhase, PrintPhase, NPHASES } StatsPhase;
+
+/* ParseStats are the counters kept in a ParseContext
+ * when TINY_STATS is defined; see stats.h
+ */
+typedef struct {
+    double seconds[NPHASES]; /* wall time of each phase */
+    unsigned long tokens[NTOKENTYPES];
+    unsigned long stmts[NSTMTKINDS]; /* nodes of each kind */
+    unsigned long exps[NEXPKINDS];
+    size_t allocBytes; /* nodes, names and token arrays */
+    int depth; /* statements and parentheses open now */
+    int maxDepth;
+    size_t outBytes; /* of printed trees */
+} ParseStats;
+
 /**************************************************/
-/***********   Flags for tracing       ************/
+/***********   State of one parse      ************/
 /**************************************************/
 
-/* Error = TRUE prevents further passes if an error occurs */
-extern int Error;
+/* MAXTOKENLEN is the maximum size of a token */
+#define MAXTOKENLEN 40
+
+/* MAXERRORS is the default number of syntax errors
+ * after which a parse gives up
+ */
+#define MAXERRORS 20
+
+/* MAXNESTING is the default limit on the nesting of
+ * statements and parentheses and on the depth of
+ * expression trees, and the highest one allowed: it
+ * keeps statement parsing and the passes that walk
+ * trees recursively within a native stack of 1 MB
+ */
+#define MAXNESTING 4096
+
+/* TOKENBLOCK = most tokens in one block of a TokenArray */
+#define TOKENBLOCK 1024
+
+/* A TokenBlock holds a run of the tokens of a source in
+ * struct-of-arrays form, with their offsets and lines
+ * stored less those of the block
+ */
+typedef struct {
+    unsigned char kind[TOKENBLOCK]; /* TokenType of each token */
+    unsigned start[TOKENBLOCK]; /* offset of the lexeme in the source */
+    unsigned length[TOKENBLOCK];
+    int line[TOKENBLOCK]; /* source line of each token */
+} TokenBlock;
+
+/* A TokenArray holds the tokens of a whole source in
+ * blocks of at most TOKENBLOCK. The reparser replaces
+ * the tokens around an edit by rewriting only the
+ * blocks holding them: those after it move by changing
+ * the first token, offset and line of each later block,
+ * never token by token. Use tokenKind, tokenStart,
+ * tokenLength and tokenLine to read token i
+ */
+typedef struct {
+    TokenBlock** block; /* the blocks in use, then spare ones */
+    int* first; /* index of the first token of each block,
+                   and count after the last */
+    unsigned* start; /* offset of each block */
+    int* line; /* line of each block */
+    int blocks; /* in use */
+    int spare; /* kept for the next lexing */
+    int capacity; /* entries of the four arrays */
+    int count;
+    mutable int hint; /* the block last looked up */
+} TokenArray;
+
+/* findTokenBlock returns the block of a holding token
+ * i, 0 <= i < count, and makes it the hint
+ */
+int findTokenBlock(const TokenArray* a, int i);
+
+/* tokenBlock is findTokenBlock, trying the hint first */
+static inline int tokenBlock(const TokenArray* a, int i)
+{
+    int b = a->hint;
+    return (i >= a->first[b] && i < a->first[b + 1]) ? b : findTokenBlock(a, i);
+}
+
+/* tokenKind, tokenStart, tokenLength and tokenLine
+ * read the TokenType, the offset and length of the
+ * lexeme, and the line of token i of a
+ */
+static inline TokenType tokenKind(const TokenArray* a, int i)
+{
+    int b = tokenBlock(a, i);
+    return (TokenType) a->block[b]->kind[i - a->first[b]];
+}
+
+static inline unsigned tokenStart(const TokenArray* a, int i)
+{
+    int b = tokenBlock(a, i);
+    return a->start[b] + a->block[b]->start[i - a->first[b]];
+}
+
+static inline unsigned tokenLength(const TokenArray* a, int i)
+{
+    int b = tokenBlock(a, i);
+    return a->block[b]->length[i - a->first[b]];
+}
+
+static inline int tokenLine(const TokenArray* a, int i)
+{
+    int b = tokenBlock(a, i);
+    return a->line[b] + a->block[b]->line[i - a->first[b]];
+}
+
+/* A StmtSpan records that stmt was parsed from the
+ * tokens [first, end), where end is the lookahead that
+ * ended it, and that depth statements hold it; the
+ * spans of the statements nested in it follow it
+ * directly
+ */
+typedef struct {
+    TreeNode* stmt;
+    int first;
+    int end;
+    int depth;
+} StmtSpan;
+
+/* SPANBLOCK = most spans in one block of a SpanArray */
+#define SPANBLOCK 512
+
+/* A SpanBlock holds a run of the spans of a SpanArray,
+ * with first and end stored less the token of the block
+ */
+typedef struct {
+    StmtSpan span[SPANBLOCK];
+} SpanBlock;
+
+/* A SpanArray holds the spans of all statements of a
+ * tree in the order they were started, i.e. preorder,
+ * in blocks as a TokenArray holds tokens: the reparser
+ * rewrites only the blocks of the spans it replaces,
+ * and moves the later blocks by their first span and
+ * token. The statement holding a span is the last one
+ * before it of less depth, which the least depth of
+ * each block lets a search pass over whole blocks.
+ * The parser only appends spans
+ */
+typedef struct {
+    SpanBlock** block; /* the blocks in use, then spare ones */
+    int* first; /* index of the first span of each block,
+                   and count after the last */
+    int* token; /* that first and end are stored less */
+    int* depth; /* of each block, at most that of its spans */
+    int blocks; /* in use */
+    int spare;
+    int capacity; /* entries of the four arrays */
+    int count;
+    int open; /* statements being parsed */
+    mutable int hint; /* the block last looked up */
+} SpanArray;
+
+/* A ParseContext holds everything the scanner and
+ * parser change while they run, so each thread can
+ * parse with its own context; it must not be copied
+ * or moved once initContext has been called
+ */
+typedef struct parseContext {
+    /* scanner input */
+    const struct textRope* rope; /* if set, holds the source, and the
+                                    buffer only what is rescanned */
+    const char* bufStart; /* first character of the source */
+    const char* bufPos; /* next character to scan */
+    const char* bufEnd; /* one past the last character */
+    int EOF_flag; /* corrects ungetNextChar behavior on EOF */
+    int lineno; /* source line number for listing */
+    /* tokenString array stores the lexeme of each token */
+    char tokenString[MAXTOKENLEN + 1];
+    /* the lexed source and the parser's place in it */
+    TokenArray tokens;
+    int cur; /* index of the current token */
+    TokenType token; /* holds current token, tokens.kind[cur] */
+    FILE* listing; /* listing output text file */
+    /* Error = TRUE prevents further passes if an error occurs */
+    int Error;
+    int quiet; /* TRUE keeps syntax errors off the listing */
+    int errors; /* syntax errors found by this parse */
+    int maxErrors; /* the parse stops at this many, 0 for no limit */
+    int recovering; /* TRUE from a syntax error until a token is
+                       matched; errors meanwhile are not reported */
+    int nesting; /* statements and parentheses open now */
+    int maxNesting; /* the limit on nesting, at most MAXNESTING;
+                       0 for MAXNESTING */
+    struct expFrame* frames; /* stack of the expression parser */
+    int frameCapacity;
+    SpanArray* spans; /* statement spans are recorded if set */
+    /* a parse is cancelled, silently and with Error set,
+       once *latest no longer equals ticket */
+    const std::atomic<int>* latest;
+    int ticket;
+    int cancelled;
+    /* storage for the nodes and names of the tree */
+    Arena arena;
+    InternTable names;
+    NodeToken* nodeTokens; /* by node id */
+    int nodeCount;
+    int nodeCapacity;
+#ifdef TINY_STATS
+    ParseStats stats;
+#endif
+} ParseContext;
 #endif
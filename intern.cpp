@@ -0,0 +1,124 @@
+/****************************************************/
+/* File: intern.cpp                                 */
+/* Interned identifier table implementation         */
+/****************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+
+/* INITSLOTS = slots allocated on first use */
+#define INITSLOTS 256
+
+#define ENTRY_NAME(e) ((char*) (e) + sizeof(InternEntry))
+#define NAME_ENTRY(s) ((const InternEntry*) ((s) - sizeof(InternEntry)))
+
+void internInit(InternTable* t, Arena* arena)
+{
+    t->slots = NULL;
+    t->stamps = NULL;
+    t->generation = 1;
+    t->capacity = 0;
+    t->count = 0;
+    t->arena = arena;
+}
+
+/* FNV-1a hash of the len characters at s */
+static unsigned hashName(const char* s, int len)
+{
+    unsigned h = 2166136261u;
+    for(int i = 0; i < len; i++) {
+        h = (h ^ (unsigned char) s[i]) * 16777619u;
+    }
+    return h;
+}
+
+/* growTable doubles the slot array and rehashes the
+ * slots in use; returns 0 if out of memory
+ */
+static int growTable(InternTable* t)
+{
+    int capacity = (t->capacity == 0) ? INITSLOTS : t->capacity * 2;
+    InternEntry** slots = (InternEntry**) malloc(capacity * sizeof(InternEntry*));
+    unsigned* stamps = (unsigned*) calloc(capacity, sizeof(unsigned));
+    if(slots == NULL || stamps == NULL) {
+        free(slots);
+        free(stamps);
+        return 0;
+    }
+    for(int i = 0; i < t->capacity; i++) {
+        if(t->stamps[i] == t->generation) {
+            InternEntry* e = t->slots[i];
+            unsigned j = e->hash & (capacity - 1);
+            while(stamps[j] == t->generation) {
+                j = (j + 1) & (capacity - 1);
+            }
+            slots[j] = e;
+            stamps[j] = t->generation;
+        }
+    }
+    free(t->slots);
+    free(t->stamps);
+    t->slots = slots;
+    t->stamps = stamps;
+    t->capacity = capacity;
+    return 1;
+}
+
+char* internString(InternTable* t, const char* s, int len)
+{
+    if(2 * (t->count + 1) > t->capacity && !growTable(t)) {
+        return NULL;
+    }
+    unsigned h = hashName(s, len);
+    unsigned mask = t->capacity - 1;
+    unsigned i = h & mask;
+    InternEntry* e;
+    while(t->stamps[i] == t->generation) {
+        e = t->slots[i];
+        if(e->hash == h && e->len == len
+           && memcmp(ENTRY_NAME(e), s, len) == 0) {
+            return ENTRY_NAME(e);
+        }
+        i = (i + 1) & mask;
+    }
+    e = (InternEntry*) arenaAlloc(t->arena, sizeof(InternEntry) + len + 1);
+    if(e == NULL) {
+        return NULL;
+    }
+    e->hash = h;
+    e->id = t->count++;
+    e->len = len;
+    memcpy(ENTRY_NAME(e), s, len);
+    ENTRY_NAME(e)[len] = '\0';
+    t->slots[i] = e;
+    t->stamps[i] = t->generation;
+    return ENTRY_NAME(e);
+}
+
+int internId(const char* name)
+{
+    return NAME_ENTRY(name)->id;
+}
+
+/* a reset only moves to the next generation, which
+ * empties every slot at once; the stamps are cleared
+ * only when the generation wraps around to 0
+ */
+void internReset(InternTable* t)
+{
+    if(t->count > 0) {
+        t->count = 0;
+        if(++t->generation == 0) {
+            memset(t->stamps, 0, t->capacity * sizeof(unsigned));
+            t->generation = 1;
+        }
+    }
+}
+
+void internFree(InternTable* t)
+{
+    free(t->slots);
+    free(t->stamps);
+    internInit(t, t->arena);
+}
@@ -0,0 +1,50 @@
+/****************************************************/
+/* File: intern.h                                   */
+/* Interned identifier table: each distinct name    */
+/* is stored once and gets a stable pointer and id  */
+/****************************************************/
+#include "arena.h"
+
+#ifndef _INTERN_H_
+#define _INTERN_H_
+
+typedef struct internEntry {
+    unsigned hash;
+    int id;   /* 0, 1, 2, ... in order of first appearance */
+    int len;
+} InternEntry; /* the NUL-terminated name follows the entry */
+
+typedef struct {
+    InternEntry** slots; /* open addressing, linear probing */
+    unsigned* stamps;    /* a slot is in use only if its stamp
+                            is the current generation */
+    unsigned generation; /* advanced by each reset */
+    int capacity;        /* power of two, or 0 before first use */
+    int count;           /* number of distinct names */
+    Arena* arena;        /* storage for the entries */
+} InternTable;
+
+/* Procedure internInit makes an empty table whose
+ * names live in the given arena
+ */
+void internInit(InternTable*, Arena*);
+
+/* Function internString returns the unique copy of the
+ * len characters at s; equal names give equal pointers,
+ * so names can be compared with ==
+ */
+char* internString(InternTable*, const char* s, int len);
+
+/* Function internId returns the id of an interned name */
+int internId(const char* name);
+
+/* Procedure internReset forgets every name in constant
+ * time; it must be called whenever the arena holding
+ * them is reset
+ */
+void internReset(InternTable*);
+
+/* Procedure internFree releases the slot array */
+void internFree(InternTable*);
+
+#endif
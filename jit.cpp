@@ -0,0 +1,613 @@
+/****************************************************/
+/* File: jit.cpp                                    */
+/* Translation of bytecode to x86-64 machine code   */
+/****************************************************/
+
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include "globals.h"
+#include "vm.h"
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__linux__) && !defined(TINY_NO_JIT)
+    #define JIT_NATIVE
+    #include <sys/mman.h>
+#endif
+
+using namespace std;
+
+void initJit(JitCode* jit)
+{
+    jit->code = NULL;
+    jit->size = 0;
+    jit->registers = 0;
+}
+
+#ifdef JIT_NATIVE
+
+/* The code is one function int f(int* frame, VmIO* io)
+ * of the System V ABI. rbp points at the frame, and
+ * the most used variables and temporaries live in the
+ * callee-saved registers, so read and write are plain
+ * calls through io; constants become immediates. eax,
+ * ecx and edx are scratch. [rsp] receives a read
+ * number and [rsp+8] holds io
+ */
+
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RBP 5
+#define RSI 6
+#define RDI 7
+#define R12 12
+#define R13 13
+#define R14 14
+#define R15 15
+
+/* the registers given to slots, in order */
+static const int varRegs[] = { RBX, R12, R13, R14, R15 };
+
+#define NVARREGS ((int) (sizeof(varRegs) / sizeof(varRegs[0])))
+
+/* condition codes of jcc and setcc */
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_L 0xC
+#define CC_GE 0xD
+#define CC_LE 0xE
+#define CC_G 0xF
+
+/* the largest constant exponent raised inline */
+#define MAXINLINEPOWER 16
+
+/* jump targets that are not bytecode indices */
+#define TO_LEAVE (-1)
+#define TO_DIVZERO (-2)
+#define TO_NOINPUT (-3)
+
+/* An Operand is where a slot lives */
+typedef enum { InReg, Imm, InFrame } OperandKind;
+
+typedef struct {
+    OperandKind kind;
+    int value; /* register, constant, or frame offset */
+} Operand;
+
+/* A Translator is the state of one jitCompile */
+typedef struct {
+    const Bytecode* bc;
+    vector<unsigned char> out;
+    vector<int> regOf; /* register of each slot, or -1 */
+    vector<int> at;    /* offset in out of each instruction */
+    vector<int> fixups; /* pairs: rel32 position, target */
+    int exits[3];      /* offsets of the TO_ targets */
+} Translator;
+
+static void byte(Translator* t, int b)
+{
+    t->out.push_back((unsigned char) b);
+}
+
+static void bytes(Translator* t, const char* s, int n)
+{
+    t->out.insert(t->out.end(), (const unsigned char*) s, (const unsigned char*) s + n);
+}
+
+static void word32(Translator* t, int v)
+{
+    unsigned u = (unsigned) v;
+    for(int i = 0; i < 4; i++) {
+        byte(t, (u >> (8 * i)) & 0xff);
+    }
+}
+
+static Operand reg(int r)
+{
+    Operand x = { InReg, r };
+    return x;
+}
+
+static int isConstant(Translator* t, int slot)
+{
+    int vars = (int) t->bc->names.size();
+    return slot >= vars && slot < vars + t->bc->constants;
+}
+
+/* operand returns where slot lives */
+static Operand operand(Translator* t, int slot)
+{
+    Operand x;
+    if(t->regOf[slot] >= 0) {
+        x.kind = InReg;
+        x.value = t->regOf[slot];
+    } else if(isConstant(t, slot)) {
+        x.kind = Imm;
+        x.value = t->bc->frame[slot];
+    } else {
+        x.kind = InFrame;
+        x.value = slot * (int) sizeof(int);
+    }
+    return x;
+}
+
+/* modrm emits the 32-bit instruction op, of one or two
+ * bytes, with register r and the register or frame
+ * slot x; r may be the digit of a group opcode */
+static void modrm(Translator* t, int op, int r, Operand x)
+{
+    int rm = (x.kind == InReg) ? x.value : RBP;
+    int rex = 0x40 | ((r & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+    if(rex != 0x40) {
+        byte(t, rex);
+    }
+    if(op > 0xff) {
+        byte(t, op >> 8);
+    }
+    byte(t, op & 0xff);
+    if(x.kind == InReg) {
+        byte(t, 0xc0 | ((r & 7) << 3) | (rm & 7));
+    } else {
+        byte(t, 0x80 | ((r & 7) << 3) | (rm & 7));
+        word32(t, x.value);
+    }
+}
+
+/* load sets register r to x */
+static void load(Translator* t, int r, Operand x)
+{
+    if(x.kind == Imm) {
+        if(r & 8) {
+            byte(t, 0x41);
+        }
+        byte(t, 0xb8 + (r & 7));
+        word32(t, x.value);
+    } else if(x.kind != InReg || x.value != r) {
+        modrm(t, 0x8b, r, x);
+    }
+}
+
+/* store sets the register or frame slot x to r */
+static void store(Translator* t, Operand x, int r)
+{
+    if(x.kind != InReg || x.value != r) {
+        modrm(t, 0x89, r, x);
+    }
+}
+
+/* alu emits r = r op x for add, sub or cmp, given by
+ * the opcode of the r, r/m form and the group digit */
+static void alu(Translator* t, int op, int digit, int r, Operand x)
+{
+    if(x.kind == Imm) {
+        modrm(t, 0x81, digit, reg(r));
+        word32(t, x.value);
+    } else {
+        modrm(t, op, r, x);
+    }
+}
+
+#define ALU_ADD 0x03, 0
+#define ALU_SUB 0x2b, 5
+#define ALU_CMP 0x3b, 7
+
+static void multiply(Translator* t, int r, Operand x)
+{
+    if(x.kind == Imm) {
+        modrm(t, 0x69, r, reg(r));
+        word32(t, x.value);
+    } else {
+        modrm(t, 0x0faf, r, x);
+    }
+}
+
+/* jump emits a jmp, or a jcc if cc >= 0, to target */
+static void jump(Translator* t, int cc, int target)
+{
+    if(cc < 0) {
+        byte(t, 0xe9);
+    } else {
+        byte(t, 0x0f);
+        byte(t, 0x80 | cc);
+    }
+    t->fixups.push_back((int) t->out.size());
+    t->fixups.push_back(target);
+    word32(t, 0);
+}
+
+/* compare sets the flags from a - b */
+static void compare(Translator* t, Operand a, Operand b)
+{
+    if(a.kind == InReg) {
+        alu(t, ALU_CMP, a.value, b);
+    } else {
+        load(t, RAX, a);
+        alu(t, ALU_CMP, RAX, b);
+    }
+}
+
+/* arith emits d = a op b for add, sub and mul, in d
+ * itself when that does not overwrite b first */
+static void arith(Translator* t, int op, Operand d, Operand a, Operand b)
+{
+    int r = RAX;
+    if(d.kind == InReg && !(b.kind == InReg && b.value == d.value)) {
+        r = d.value;
+    }
+    load(t, r, a);
+    if(op == VmAdd) {
+        alu(t, ALU_ADD, r, b);
+    } else if(op == VmSub) {
+        alu(t, ALU_SUB, r, b);
+    } else {
+        multiply(t, r, b);
+    }
+    store(t, d, r);
+}
+
+/* divide emits d = a / b or a % b with the checks of
+ * the interpreter: b == 0 stops the run, and b == -1
+ * avoids the trap of idiv on INT_MIN */
+static void divide(Translator* t, int op, Operand d, Operand a, Operand b)
+{
+    int mod = (op == VmMod);
+    if(b.kind == Imm && b.value == 0) {
+        jump(t, -1, TO_DIVZERO);
+        return;
+    }
+    if(b.kind != Imm) {
+        load(t, RCX, b);
+        bytes(t, "\x85\xc9", 2);               /* test ecx, ecx */
+        jump(t, CC_E, TO_DIVZERO);
+        load(t, RAX, a);
+        bytes(t, "\x83\xf9\xff", 3);           /* cmp ecx, -1 */
+        bytes(t, "\x75\x04", 2);               /* jne idiv */
+    } else {
+        load(t, RAX, a);
+    }
+    if(b.kind != Imm || b.value == -1) {
+        bytes(t, mod ? "\x31\xc0" : "\xf7\xd8", 2); /* xor eax, eax or neg eax */
+    }
+    if(b.kind != Imm) {
+        bytes(t, mod ? "\xeb\x05" : "\xeb\x03", 2); /* jmp store */
+    }
+    if(b.kind != Imm || b.value != -1) {
+        if(b.kind == Imm) {
+            load(t, RCX, b);
+        }
+        bytes(t, "\x99\xf7\xf9", 3);           /* cdq; idiv ecx */
+        if(mod) {
+            bytes(t, "\x89\xd0", 2);           /* mov eax, edx */
+        }
+    }
+    store(t, d, RAX);
+}
+
+/* callAddress emits a call of the function at p */
+static void callAddress(Translator* t, const void* p)
+{
+    unsigned long long a = (unsigned long long) (size_t) p;
+    bytes(t, "\x48\xb8", 2);                   /* mov rax, imm64 */
+    for(int i = 0; i < 8; i++) {
+        byte(t, (int) ((a >> (8 * i)) & 0xff));
+    }
+    bytes(t, "\xff\xd0", 2);                   /* call rax */
+}
+
+/* raise emits d = a ^ n for a small constant n >= 0,
+ * squaring ecx and multiplying into eax as power does */
+static void raise(Translator* t, Operand d, Operand a, int n)
+{
+    int started = FALSE;
+    load(t, RCX, a);
+    while(n > 0) {
+        if(n & 1) {
+            if(started) {
+                multiply(t, RAX, reg(RCX));
+            } else {
+                load(t, RAX, reg(RCX));
+            }
+            started = TRUE;
+        }
+        n >>= 1;
+        if(n > 0) {
+            multiply(t, RCX, reg(RCX));
+        }
+    }
+    if(!started) {
+        Operand one = { Imm, 1 };
+        load(t, RAX, one);
+    }
+    store(t, d, RAX);
+}
+
+static int jitPower(int a, int b)
+{
+    int r;
+    evalOp(POWER, a, b, &r);
+    return r;
+}
+
+/* ccOf returns the condition of a comparison opcode
+ * counted from first, the one for < */
+static int ccOf(int op, int first)
+{
+    static const int cc[6] = { CC_L, CC_LE, CC_G, CC_GE, CC_E, CC_NE };
+    return cc[op - first];
+}
+
+/* chooseRegisters gives the registers to the variables
+ * and temporaries used most, a use inside k loops
+ * counting 8^k */
+static void chooseRegisters(Translator* t)
+{
+    const vector<int>& code = t->bc->code;
+    int slots = (int) t->bc->frame.size();
+    vector<int> depth(code.size() + 1, 0);
+    for(size_t i = 0; i < code.size(); i += 1 + vmOperands(code[i])) {
+        int op = code[i];
+        if(op >= VmJump && op <= VmJumpNe) {
+            int target = code[i + vmOperands(op)];
+            if(target <= (int) i) {
+                depth[target]++;
+                depth[i + 1]--;
+            }
+        }
+    }
+    vector<double> weight(slots, 0);
+    int nesting = 0;
+    for(size_t i = 0; i < code.size(); i++) {
+        nesting += depth[i];
+        depth[i] = nesting;
+    }
+    for(size_t i = 0; i < code.size(); i += 1 + vmOperands(code[i])) {
+        int op = code[i];
+        int n = (op >= VmJump && op <= VmJumpNe) ? vmOperands(op) - 1 : vmOperands(op);
+        if(op == VmInc) {
+            n = 1;
+        }
+        double w = 1;
+        for(int k = 0; k < depth[i] && k < 8; k++) {
+            w *= 8;
+        }
+        for(int k = 1; k <= n; k++) {
+            if(!isConstant(t, code[i + k])) {
+                weight[code[i + k]] += w;
+            }
+        }
+    }
+    t->regOf.assign(slots, -1);
+    for(int r = 0; r < NVARREGS; r++) {
+        int best = -1;
+        for(int v = 0; v < slots; v++) {
+            if(t->regOf[v] < 0 && weight[v] > 0 && (best < 0 || weight[v] > weight[best])) {
+                best = v;
+            }
+        }
+        if(best < 0) {
+            break;
+        }
+        t->regOf[best] = varRegs[r];
+    }
+}
+
+static void prologue(Translator* t)
+{
+    bytes(t, "\x55\x53\x41\x54\x41\x55\x41\x56\x41\x57", 10); /* push rbp rbx r12-r15 */
+    bytes(t, "\x48\x83\xec\x18", 4);           /* sub rsp, 24 */
+    bytes(t, "\x48\x89\xfd", 3);               /* mov rbp, rdi */
+    bytes(t, "\x48\x89\x74\x24\x08", 5);       /* mov [rsp+8], rsi */
+    for(size_t v = 0; v < t->regOf.size(); v++) {
+        if(t->regOf[v] >= 0) {
+            Operand x = { InFrame, (int) (v * sizeof(int)) };
+            load(t, t->regOf[v], x);
+        }
+    }
+}
+
+/* epilogue emits the exits, which return their outcome */
+static void epilogue(Translator* t)
+{
+    t->exits[-1 - TO_DIVZERO] = (int) t->out.size();
+    byte(t, 0xb8);                             /* mov eax, VM_DIVZERO */
+    word32(t, VM_DIVZERO);
+    jump(t, -1, TO_LEAVE);
+    t->exits[-1 - TO_NOINPUT] = (int) t->out.size();
+    byte(t, 0xb8);                             /* mov eax, VM_NOINPUT */
+    word32(t, VM_NOINPUT);
+    t->exits[-1 - TO_LEAVE] = (int) t->out.size();
+    bytes(t, "\x48\x83\xc4\x18", 4);           /* add rsp, 24 */
+    bytes(t, "\x41\x5f\x41\x5e\x41\x5d\x41\x5c\x5b\x5d\xc3", 11); /* pop; ret */
+}
+
+static void translate(Translator* t, size_t i)
+{
+    const int* w = t->bc->code.data() + i;
+    int op = w[0];
+    switch(op) {
+        case VmHalt:
+            bytes(t, "\x31\xc0", 2);           /* xor eax, eax */
+            jump(t, -1, TO_LEAVE);
+            break;
+        case VmMove: {
+            Operand d = operand(t, w[1]);
+            Operand s = operand(t, w[2]);
+            if(d.kind == InReg) {
+                load(t, d.value, s);
+            } else if(s.kind == InReg) {
+                store(t, d, s.value);
+            } else if(s.kind == Imm) {
+                modrm(t, 0xc7, 0, d);          /* mov dword, imm32 */
+                word32(t, s.value);
+            } else {
+                load(t, RAX, s);
+                store(t, d, RAX);
+            }
+            break;
+        }
+        case VmAdd:
+        case VmSub:
+        case VmMul:
+            arith(t, op, operand(t, w[1]), operand(t, w[2]), operand(t, w[3]));
+            break;
+        case VmDiv:
+        case VmMod:
+            divide(t, op, operand(t, w[1]), operand(t, w[2]), operand(t, w[3]));
+            break;
+        case VmPow: {
+            Operand b = operand(t, w[3]);
+            if(b.kind == Imm && b.value >= 0 && b.value <= MAXINLINEPOWER) {
+                raise(t, operand(t, w[1]), operand(t, w[2]), b.value);
+                break;
+            }
+            load(t, RDI, operand(t, w[2]));
+            load(t, RSI, operand(t, w[3]));
+            callAddress(t, (const void*) jitPower);
+            store(t, operand(t, w[1]), RAX);
+            break;
+        }
+        case VmLt:
+        case VmLe:
+        case VmGt:
+        case VmGe:
+        case VmEq:
+        case VmNe:
+            compare(t, operand(t, w[2]), operand(t, w[3]));
+            byte(t, 0x0f);
+            byte(t, 0x90 | ccOf(op, VmLt));    /* setcc al */
+            byte(t, 0xc0);
+            bytes(t, "\x0f\xb6\xc0", 3);       /* movzx eax, al */
+            store(t, operand(t, w[1]), RAX);
+            break;
+        case VmInc:
+            modrm(t, 0x81, 0, operand(t, w[1])); /* add, imm32 */
+            word32(t, w[2]);
+            break;
+        case VmJump:
+            jump(t, -1, w[1]);
+            break;
+        case VmJumpZero:
+        case VmJumpNonZero: {
+            Operand a = operand(t, w[1]);
+            int cc = (op == VmJumpZero) ? CC_E : CC_NE;
+            if(a.kind == Imm) {
+                if((a.value == 0) == (op == VmJumpZero)) {
+                    jump(t, -1, w[2]);
+                }
+                break;
+            }
+            if(a.kind == InReg) {
+                modrm(t, 0x85, a.value, a);    /* test r, r */
+            } else {
+                modrm(t, 0x83, 7, a);          /* cmp dword, 0 */
+                byte(t, 0);
+            }
+            jump(t, cc, w[2]);
+            break;
+        }
+        case VmJumpLt:
+        case VmJumpLe:
+        case VmJumpGt:
+        case VmJumpGe:
+        case VmJumpEq:
+        case VmJumpNe:
+            compare(t, operand(t, w[1]), operand(t, w[2]));
+            jump(t, ccOf(op, VmJumpLt), w[3]);
+            break;
+        case VmRead:
+            bytes(t, "\x48\x8b\x7c\x24\x08", 5); /* mov rdi, [rsp+8] */
+            bytes(t, "\x48\x8d\x34\x24", 4);   /* lea rsi, [rsp] */
+            bytes(t, "\xff\x57", 2);           /* call [rdi+read] */
+            byte(t, (int) offsetof(VmIO, read));
+            bytes(t, "\x85\xc0", 2);           /* test eax, eax */
+            jump(t, CC_E, TO_NOINPUT);
+            bytes(t, "\x8b\x04\x24", 3);       /* mov eax, [rsp] */
+            store(t, operand(t, w[1]), RAX);
+            break;
+        case VmWrite:
+            load(t, RSI, operand(t, w[1]));
+            bytes(t, "\x48\x8b\x7c\x24\x08", 5); /* mov rdi, [rsp+8] */
+            bytes(t, "\xff\x57", 2);           /* call [rdi+write] */
+            byte(t, (int) offsetof(VmIO, write));
+            break;
+        default:
+            break;
+    }
+}
+
+int jitCompile(JitCode* jit, const Bytecode* bc)
+{
+    initJit(jit);
+    Translator t;
+    t.bc = bc;
+    t.at.assign(bc->code.size(), 0);
+    chooseRegisters(&t);
+    prologue(&t);
+    for(size_t i = 0; i < bc->code.size(); i += 1 + vmOperands(bc->code[i])) {
+        t.at[i] = (int) t.out.size();
+        translate(&t, i);
+    }
+    epilogue(&t);
+    for(size_t f = 0; f < t.fixups.size(); f += 2) {
+        int at = t.fixups[f];
+        int target = t.fixups[f + 1];
+        int to = (target >= 0) ? t.at[target] : t.exits[-1 - target];
+        int rel = to - (at + 4);
+        memcpy(&t.out[at], &rel, 4);
+    }
+
+    /* the code is written, then made executable and no
+       longer writable */
+    size_t size = t.out.size();
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED) {
+        return FALSE;
+    }
+    memcpy(p, t.out.data(), size);
+    if(mprotect(p, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(p, size);
+        return FALSE;
+    }
+    jit->code = p;
+    jit->size = size;
+    for(size_t v = 0; v < t.regOf.size(); v++) {
+        jit->registers += (t.regOf[v] >= 0);
+    }
+    return TRUE;
+}
+
+void freeJit(JitCode* jit)
+{
+    if(jit->code != NULL) {
+        munmap(jit->code, jit->size);
+    }
+    initJit(jit);
+}
+
+#else
+
+int jitCompile(JitCode* jit, const Bytecode*)
+{
+    initJit(jit);
+    return FALSE;
+}
+
+void freeJit(JitCode* jit)
+{
+    initJit(jit);
+}
+
+#endif
+
+int runJit(const JitCode* jit, const Bytecode* bc, VmIO* io)
+{
+    if(jit->code == NULL) {
+        return runBytecode(bc, io);
+    }
+    typedef int (*Entry)(int* frame, VmIO* io);
+    vector<int> frame(bc->frame);
+    frame.push_back(0); /* so the frame is never empty */
+    return ((Entry) jit->code)(frame.data(), io);
+}
@@ -0,0 +1,41 @@
+/****************************************************/
+/* File: jit.h                                      */
+/* Native code for the bytecode of vm.h on x86-64   */
+/* Linux, with the interpreter as the fallback      */
+/****************************************************/
+#include "globals.h"
+#include "vm.h"
+
+#ifndef _JIT_H_
+#define _JIT_H_
+
+/* A JitCode is a Bytecode translated to machine code
+ * in an executable mapping of its own
+ */
+typedef struct {
+    void* code;    /* entry point, or NULL if not compiled */
+    size_t size;   /* of the mapping */
+    int registers; /* variables and temporaries kept in
+                      registers */
+} JitCode;
+
+/* Procedure initJit makes jit empty */
+void initJit(JitCode* jit);
+
+/* Procedure freeJit unmaps the code of jit */
+void freeJit(JitCode* jit);
+
+/* Function jitCompile translates bc into jit; returns
+ * FALSE, leaving jit empty, where no native code can
+ * be made: on other machines, when built with
+ * TINY_NO_JIT, or when memory cannot be mapped
+ */
+int jitCompile(JitCode* jit, const Bytecode* bc);
+
+/* Function runJit runs the native code of jit, or bc
+ * on the interpreter if jit is empty, and returns
+ * VM_OK or the error that stopped it
+ */
+int runJit(const JitCode* jit, const Bytecode* bc, VmIO* io);
+
+#endif
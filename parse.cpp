@@ -7,58 +7,249 @@
 
 #include "globals.h"
 #include "util.h"
+#include "spans.h"
 #include "scan.h"
 #include "parse.h"
-
-static TokenType token; /* holds current token */
+#include "srcbuf.h"
+#include "stats.h"
 
 /* function prototypes for recursive calls */
-static TreeNode* stmt_sequence(void);
-static TreeNode* statement(void);
-static TreeNode* if_stmt(void);
-static TreeNode* repeat_stmt(void);
-static TreeNode* doWhile_stmt(void);  // do while循环
-static TreeNode* for_stmt(void);  // for循环
-static TreeNode* to_stmt(void);  // to/downto
-static TreeNode* assign_stmt(void);
-static TreeNode* read_stmt(void);
-static TreeNode* write_stmt(void);
-static TreeNode* exp(void);
-static TreeNode* exp2(void);  // 实现逻辑表达式and, or
-static TreeNode* minunseq_exp(char*);  // -=运算
-static TreeNode* simple_exp(void);
-static TreeNode* term(void);
-static TreeNode* term2(void);  // 乘方运算
-static TreeNode* factor(void);
-
-static void syntaxError(string message)
-{
-    fprintf(listing, "\n>>> ");
-    fprintf(listing, "Syntax error at line %d: %s", lineno, message.c_str());
-    Error = TRUE;
-}
-
-static void match(TokenType expected)
-{
-    if(token == expected) {
-        token = getToken();
+static TreeNode* stmt_sequence(ParseContext*);
+static TreeNode* statement(ParseContext*);
+static TreeNode* if_stmt(ParseContext*);
+static TreeNode* repeat_stmt(ParseContext*);
+static TreeNode* doWhile_stmt(ParseContext*);  // do while循环
+static TreeNode* for_stmt(ParseContext*);  // for循环
+static TreeNode* to_stmt(ParseContext*);  // to/downto
+static TreeNode* assign_stmt(ParseContext*);
+static TreeNode* read_stmt(ParseContext*);
+static TreeNode* write_stmt(ParseContext*);
+static TreeNode* exp2(ParseContext*);  // 实现逻辑表达式and, or
+static TreeNode* minunseq_exp(ParseContext*, char*);  // -=运算
+static TreeNode* simple_exp(ParseContext*);
+
+/* A TokenSet holds one bit for each TokenType */
+typedef unsigned long long TokenSet;
+#define TOKENBIT(t) ((TokenSet) 1 << (t))
+
+/* The synchronizing sets of panic-mode recovery: after
+ * a syntax error, tokens are skipped up to one that
+ * can end the broken construct or begin the next one.
+ * ENDFILE stops every skip. An ID does not begin a
+ * statement here, since garbage is so often made of
+ * them
+ */
+#define SEQ_END (TOKENBIT(END) | TOKENBIT(ELSE) | TOKENBIT(UNTIL) \
+                 | TOKENBIT(WHILE) | TOKENBIT(ENDDO) | TOKENBIT(ENDFILE))
+#define STMT_FIRST (TOKENBIT(IF) | TOKENBIT(REPEAT) | TOKENBIT(READ) \
+                    | TOKENBIT(WRITE) | TOKENBIT(DO) | TOKENBIT(FOR))
+#define STMT_SYNC (SEQ_END | STMT_FIRST | TOKENBIT(SEMI))
+#define FACTOR_FIRST (TOKENBIT(NUM) | TOKENBIT(ID) | TOKENBIT(LPAREN))
+#define EXP_FOLLOW (STMT_SYNC | TOKENBIT(RPAREN) | TOKENBIT(TO) | TOKENBIT(DOWNTO) \
+                    | TOKENBIT(AND) | TOKENBIT(OR) | TOKENBIT(LT) | TOKENBIT(LTE) \
+                    | TOKENBIT(GT) | TOKENBIT(GTE) | TOKENBIT(EQ) | TOKENBIT(NE))
+
+static bool inSet(ParseContext* ctx, TokenSet set)
+{
+    return (set & TOKENBIT(ctx->token)) != 0;
+}
+
+/* advance moves to the next token of ctx->tokens;
+ * the final ENDFILE is never passed
+ */
+static void advance(ParseContext* ctx)
+{
+    const TokenArray* a = &ctx->tokens;
+    if(ctx->cur + 1 < a->count) {
+        ctx->cur++;
+    }
+    ctx->token = tokenKind(a, ctx->cur);
+}
+
+/* lexeme returns the first character of the current
+ * lexeme, which lies in one block of the rope if the
+ * source is kept in one */
+static const char* lexeme(ParseContext* ctx)
+{
+    unsigned start = tokenStart(&ctx->tokens, ctx->cur);
+    if(ctx->rope != NULL) {
+        size_t from, length;
+        return ropeBlock(ctx->rope, start, &from, &length) + (start - from);
+    }
+    return ctx->bufStart + start;
+}
+
+/* tokenText returns a copy of the current lexeme */
+static string tokenText(ParseContext* ctx)
+{
+    return string(lexeme(ctx), tokenLength(&ctx->tokens, ctx->cur));
+}
+
+/* tokenName returns the interned name of the current ID */
+static char* tokenName(ParseContext* ctx)
+{
+    return internName(ctx, lexeme(ctx), tokenLength(&ctx->tokens, ctx->cur));
+}
+
+/* tokenValue returns the value of the current NUM */
+static int tokenValue(ParseContext* ctx)
+{
+    const char* p = lexeme(ctx);
+    unsigned length = tokenLength(&ctx->tokens, ctx->cur);
+    unsigned val = 0;
+    for(unsigned i = 0; i < length; i++) {
+        val = val * 10 + (p[i] - '0');
+    }
+    return (int) val;
+}
+
+/* skipTo discards tokens up to the first in sync */
+static void skipTo(ParseContext* ctx, TokenSet sync)
+{
+    while(!inSet(ctx, sync | TOKENBIT(ENDFILE))) {
+        advance(ctx);
+    }
+}
+
+/* stopParse moves to ENDFILE, so the parse just
+ * unwinds */
+static void stopParse(ParseContext* ctx)
+{
+    const TokenArray* a = &ctx->tokens;
+    ctx->cur = a->count - 1;
+    ctx->token = tokenKind(a, ctx->cur);
+}
+
+/* syntaxError reports an error unless one was reported
+ * since the last matched token; at the maxErrors-th it
+ * stops the parse
+ */
+static void syntaxError(ParseContext* ctx, string message)
+{
+    ctx->Error = TRUE;
+    if(ctx->recovering) {
+        return;
+    }
+    ctx->recovering = TRUE;
+    bool listed = !ctx->quiet && !ctx->cancelled;
+    if(listed) {
+        fprintf(ctx->listing, "\n>>> ");
+        fprintf(ctx->listing, "Syntax error at line %d: %s",
+                tokenLine(&ctx->tokens, ctx->cur), message.c_str());
+    }
+    if(++ctx->errors == ctx->maxErrors) {
+        if(listed) {
+            fprintf(ctx->listing, "\n>>> Too many syntax errors, parsing stopped\n");
+        }
+        stopParse(ctx);
+    }
+}
+
+/* nestingLimit is maxNesting, or MAXNESTING if that is
+ * 0 or less, or more than MAXNESTING: statements are
+ * still parsed, and trees folded and compiled, by
+ * native recursion */
+static int nestingLimit(const ParseContext* ctx)
+{
+    return (ctx->maxNesting > 0 && ctx->maxNesting < MAXNESTING) ? ctx->maxNesting : MAXNESTING;
+}
+
+/* tooDeep reports nesting beyond the limit, even
+ * while recovering, and stops the parse */
+static void tooDeep(ParseContext* ctx)
+{
+    char message[64];
+    snprintf(message, sizeof(message), "nested deeper than %d\n", nestingLimit(ctx));
+    ctx->recovering = FALSE;
+    syntaxError(ctx, message);
+    stopParse(ctx);
+}
+
+#ifdef TINY_STATS
+/* enterDepth counts one more level of nesting */
+static void enterDepth(ParseContext* ctx)
+{
+    if(++ctx->stats.depth > ctx->stats.maxDepth) {
+        ctx->stats.maxDepth = ctx->stats.depth;
+    }
+}
+#endif
+
+/* enterNesting opens a statement or parenthesis */
+static void enterNesting(ParseContext* ctx)
+{
+    STATS(enterDepth(ctx));
+    if(++ctx->nesting > nestingLimit(ctx)) {
+        tooDeep(ctx);
+    }
+}
+
+static void unexpectedToken(ParseContext* ctx)
+{
+    if(ctx->recovering) { /* would not be reported */
+        ctx->Error = TRUE;
+        return;
+    }
+    syntaxError(ctx, "unexpected token -> " + printToken(ctx->token, tokenText(ctx)));
+}
+
+/* match takes the expected token; if another is found
+ * it is left for the caller, as if the expected one
+ * had been missing
+ */
+static void match(ParseContext* ctx, TokenType expected)
+{
+    if(ctx->token == expected) {
+        advance(ctx);
+        ctx->recovering = FALSE;
     } else {
-        syntaxError("unexpected token -> ");
-        printToken(token, tokenString);
-        fprintf(listing, "      ");
+        unexpectedToken(ctx);
+    }
+}
+
+/* openSpan starts the span of a statement at the
+ * current token; returns its index, or -1 if spans
+ * are not recorded or memory ran out */
+static int openSpan(ParseContext* ctx)
+{
+    SpanArray* a = ctx->spans;
+    if(a == NULL) {
+        return -1;
     }
+    StmtSpan span = { NULL, ctx->cur, ctx->cur, a->open };
+    if(!appendSpan(a, span)) {
+        fprintf(ctx->listing, "Out of memory error at line %d\n",
+                tokenLine(&ctx->tokens, ctx->cur));
+        ctx->Error = TRUE;
+        return -1;
+    }
+    a->open++;
+    return a->count - 1;
 }
 
-TreeNode* stmt_sequence(void)
+/* closeSpan ends span i with the statement just parsed */
+static void closeSpan(ParseContext* ctx, int i, TreeNode* t)
 {
-    TreeNode* t = statement();
+    if(i >= 0) {
+        StmtSpan span = spanAt(ctx->spans, i);
+        span.stmt = t;
+        span.end = ctx->cur;
+        setSpan(ctx->spans, i, span);
+        ctx->spans->open--;
+    }
+}
+
+TreeNode* stmt_sequence(ParseContext* ctx)
+{
+    TreeNode* t = statement(ctx);
     TreeNode* p = t;
-    while((token != ENDFILE) && (token != END) &&
-          (token != ELSE) && (token != UNTIL) &&
-          (token != WHILE) && (token != ENDDO)) {
+    while(!inSet(ctx, SEQ_END) && !parseCancelled(ctx)) {
         TreeNode* q;
-        match(SEMI);
-        q = statement();
+        match(ctx, SEMI);
+        if(ctx->token == WHILE) {
+            break; /* the ';' before the while of do-while */
+        }
+        q = statement(ctx);
         if(q != NULL) {
             if(t == NULL) {
                 t = p = q;
@@ -71,354 +262,506 @@ TreeNode* stmt_sequence(void)
     return t;
 }
 
-TreeNode* statement(void)
+TreeNode* statement(ParseContext* ctx)
 {
     TreeNode* t = NULL;
-    switch(token) {
+    enterNesting(ctx);
+    int span = openSpan(ctx);
+    switch(ctx->token) {
         case IF :
-            t = if_stmt();
+            t = if_stmt(ctx);
             break;
         case REPEAT :
-            t = repeat_stmt();
+            t = repeat_stmt(ctx);
             break;
         case ID :
-            t = assign_stmt();
+            t = assign_stmt(ctx);
             break;
         case READ :
-            t = read_stmt();
+            t = read_stmt(ctx);
             break;
         case WRITE :
-            t = write_stmt();
+            t = write_stmt(ctx);
             break;
         case DO:
-            t = doWhile_stmt();
+            t = doWhile_stmt(ctx);
             break;
         case FOR:
-            t = for_stmt();
+            t = for_stmt(ctx);
             break;
         default :
-            syntaxError("unexpected token -> ");
-            printToken(token, tokenString);
-            token = getToken();
+            unexpectedToken(ctx);
+            skipTo(ctx, STMT_SYNC);
             break;
     } /* end case */
+    closeSpan(ctx, span, t);
+    ctx->nesting--;
+    STATS(ctx->stats.depth--);
     return t;
 }
 
-TreeNode* if_stmt(void)
+TreeNode* if_stmt(ParseContext* ctx)
 {
-    TreeNode* t = newStmtNode(IfK);
-    match(IF);
-    match(LPAREN);
+    TreeNode* t = newStmtNode(ctx, IfK);
+    match(ctx, IF);
+    match(ctx, LPAREN);
     if(t != NULL) {
-        t->child[0] = exp2();
+        t->child[0] = exp2(ctx);
     }
-    match(RPAREN);
+    match(ctx, RPAREN);
     //    match(THEN);
     if(t != NULL) {
-        t->child[1] = stmt_sequence();
+        t->child[1] = stmt_sequence(ctx);
     }
-    if(token == ELSE) {
-        match(ELSE);
+    if(ctx->token == ELSE) {
+        match(ctx, ELSE);
         if(t != NULL) {
-            t->child[2] = stmt_sequence();
+            t->child[2] = stmt_sequence(ctx);
         }
     }
-    match(END);
+    match(ctx, END);
     return t;
 }
 
 // 实现do while循环
-treeNode* doWhile_stmt(void)
+/* do-while -> do stmt-sequence [;] while ( exp );
+ * stmt_sequence stops at a while after a ';', so the
+ * ';' before the while may be left out
+ */
+treeNode* doWhile_stmt(ParseContext* ctx)
 {
-    TreeNode* t = newStmtNode(DoWhileK);
-    match(DO);
+    TreeNode* t = newStmtNode(ctx, DoWhileK);
+    match(ctx, DO);
     if(t != NULL) {
-        t->child[0] = stmt_sequence();
+        t->child[0] = stmt_sequence(ctx);
+    }
+    /* the ';' is usually taken by stmt_sequence, or by
+       an assignment ending the body */
+    if(ctx->token == SEMI) {
+        match(ctx, SEMI);
     }
-    match(SEMI);
-    match(WHILE);
-    match(LPAREN);
+    match(ctx, WHILE);
+    match(ctx, LPAREN);
     if(t != NULL) {
-        t->child[1] = exp2();
+        t->child[1] = exp2(ctx);
     }
-    match(RPAREN);
+    match(ctx, RPAREN);
     return t;
 }
 
 // 实现for循环
-TreeNode* for_stmt(void)
+TreeNode* for_stmt(ParseContext* ctx)
 {
-    TreeNode* t = newStmtNode(ForK);
-    match(FOR);
+    TreeNode* t = newStmtNode(ctx, ForK);
+    match(ctx, FOR);
     if(t != NULL) {
-        t->child[0] = assign_stmt();
+        t->child[0] = assign_stmt(ctx);
     }
     if(t != NULL) {
-        t->child[1] = to_stmt();
+        t->child[1] = to_stmt(ctx);
     }
-    match(DO);
+    match(ctx, DO);
     if(t != NULL) {
-        t->child[2] = stmt_sequence();
+        t->child[2] = stmt_sequence(ctx);
     }
-    match(ENDDO);
+    match(ctx, ENDDO);
     return t;
 }
-TreeNode* to_stmt(void)
+TreeNode* to_stmt(ParseContext* ctx)
 {
     TreeNode* t = NULL;
-    if(token == TO) {
-        t = newStmtNode(ToK);
-        match(TO);
-    } else if(token == DOWNTO) {
-        t = newStmtNode(DowntoK);
-        match(DOWNTO);
+    if(ctx->token == TO) {
+        t = newStmtNode(ctx, ToK);
+        match(ctx, TO);
+    } else if(ctx->token == DOWNTO) {
+        t = newStmtNode(ctx, DowntoK);
+        match(ctx, DOWNTO);
     }
     if(t != NULL) {
-        t->child[0] = simple_exp();
+        t->child[0] = simple_exp(ctx);
     }
     return t;
 }
 
-TreeNode* repeat_stmt(void)
+TreeNode* repeat_stmt(ParseContext* ctx)
 {
-    TreeNode* t = newStmtNode(RepeatK);
-    match(REPEAT);
+    TreeNode* t = newStmtNode(ctx, RepeatK);
+    match(ctx, REPEAT);
     if(t != NULL) {
-        t->child[0] = stmt_sequence();
+        t->child[0] = stmt_sequence(ctx);
     }
-    match(UNTIL);
+    match(ctx, UNTIL);
     if(t != NULL) {
-        t->child[1] = exp2();
+        t->child[1] = exp2(ctx);
     }
     return t;
 }
 
-TreeNode* assign_stmt(void)
+TreeNode* assign_stmt(ParseContext* ctx)
 {
-    TreeNode* t = newStmtNode(AssignK);
+    TreeNode* t = newStmtNode(ctx, AssignK);
     char* varname = NULL;
-    if((t != NULL) && (token == ID)) {
-        t->attr.name = copyString(tokenString);
+    if((t != NULL) && (ctx->token == ID)) {
+        t->attr.name = tokenName(ctx);
         varname = t->attr.name;
     }
-    match(ID);
-    if(token == ASSIGN) {
-        match(ASSIGN);
+    match(ctx, ID);
+    if(ctx->token == ASSIGN) {
+        match(ctx, ASSIGN);
         if(t != NULL) {
-            t->child[0] = exp2();
+            t->child[0] = exp2(ctx);
         }
-    } else if(token == MINUSEQ) {
-        match(MINUSEQ);
+    } else if(ctx->token == MINUSEQ) {
+        match(ctx, MINUSEQ);
         if(t != NULL) {
-            t->child[0] = minunseq_exp(varname);
+            t->child[0] = minunseq_exp(ctx, varname);
         }
+    } else {
+        unexpectedToken(ctx);
     }
-    if(token == SEMI) {
-        match(SEMI);
+    if(ctx->token == SEMI) {
+        match(ctx, SEMI);
     }
     return t;
 }
 
-TreeNode* read_stmt(void)
+TreeNode* read_stmt(ParseContext* ctx)
 {
-    TreeNode* t = newStmtNode(ReadK);
-    match(READ);
-    if((t != NULL) && (token == ID)) {
-        t->attr.name = copyString(tokenString);
+    TreeNode* t = newStmtNode(ctx, ReadK);
+    match(ctx, READ);
+    if((t != NULL) && (ctx->token == ID)) {
+        t->attr.name = tokenName(ctx);
     }
-    match(ID);
+    match(ctx, ID);
     return t;
 }
 
-TreeNode* write_stmt(void)
+TreeNode* write_stmt(ParseContext* ctx)
 {
-    TreeNode* t = newStmtNode(WriteK);
-    match(WRITE);
+    TreeNode* t = newStmtNode(ctx, WriteK);
+    match(ctx, WRITE);
     if(t != NULL) {
-        t->child[0] = exp2();
+        t->child[0] = exp2(ctx);
     }
     return t;
 }
 
-TreeNode* exp(void)
+/* Expressions are parsed by precedence climbing over
+ * the table below, without recursion: each operator
+ * waiting for its right operand, each not and each
+ * open parenthesis is an ExpFrame on ctx->frames, so
+ * nesting is bounded by the heap and maxNesting rather
+ * than the native stack
+ */
+
+/* Binding powers, loosest first: an operator takes as
+ * its right operand everything that binds tighter */
+enum { OrPower = 1, RelPower, AddPower, ClosurePower, MulPower, PowPower };
+
+/* Left operators are binary and left associative; a
+ * Single operator is binary and ends the expression if
+ * it comes again at the same level; a Postfix one is
+ * unary and ends it at any tighter operator after it
+ */
+typedef enum { Left, Single, Postfix } Fixity;
+
+typedef struct {
+    TokenType token;
+    unsigned char power;
+    unsigned char fixity;   /* Fixity */
+    unsigned char nodekind; /* NodeKind of the node built */
+    unsigned char kind;     /* StmtKind or ExpKind */
+} Operator;
+
+static const Operator operators[] = {
+    // 实现逻辑表达式and, or
+    { AND, OrPower, Left, StmtK, AndK },
+    { OR, OrPower, Left, StmtK, OrK },
+    { LT, RelPower, Single, ExpK, OpK },
+    { LTE, RelPower, Single, ExpK, OpK },
+    { GT, RelPower, Single, ExpK, OpK },
+    { GTE, RelPower, Single, ExpK, OpK },
+    { EQ, RelPower, Single, ExpK, OpK },
+    { NE, RelPower, Single, ExpK, OpK },
+    { PLUS, AddPower, Left, ExpK, OpK },
+    { MINUS, AddPower, Left, ExpK, OpK },
+    // 连接&和或|
+    { LINK, AddPower, Left, ExpK, LopK },
+    { LOR, AddPower, Left, ExpK, LopK },
+    // 闭包#
+    { CLOSURE, ClosurePower, Postfix, ExpK, LopK },
+    { TIMES, MulPower, Left, ExpK, OpK },
+    { OVER, MulPower, Left, ExpK, OpK },
+    { MOD, MulPower, Left, ExpK, OpK },
+    // 乘方运算，优先级最高
+    { POWER, PowPower, Left, ExpK, OpK },
+};
+
+/* An OperatorIndex finds the operator of a token */
+typedef struct {
+    const Operator* of[NTOKENTYPES];
+} OperatorIndex;
+
+static OperatorIndex indexOperators(void)
 {
-    bool hasNot = false;
-    if(token == NOT) {
-        match(token);
-        hasNot = true;
+    OperatorIndex index;
+    for(int i = 0; i < NTOKENTYPES; i++) {
+        index.of[i] = NULL;
+    }
+    for(size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); i++) {
+        index.of[operators[i].token] = &operators[i];
     }
+    return index;
+}
 
-    TreeNode* t = simple_exp();
-    if(token == LT || token == LTE
-       || token == GT || token == GTE
-       || token == EQ || token == NE) {
-        TreeNode* p = newExpNode(OpK);
-        if(p != NULL) {
-            p->child[0] = t;
-            p->attr.op = token;
-            t = p;
-        }
-        match(token);
-        if(t != NULL) {
-            t->child[1] = simple_exp();
+static const OperatorIndex* operatorIndex(void)
+{
+    static const OperatorIndex index = indexOperators();
+    return &index;
+}
+
+/* POWERBIT is the bit of a binding power in a set of
+ * closed powers, whose operators end the expression */
+#define POWERBIT(p) (1u << (p))
+
+typedef enum { OperandF, NotF, ParenF } FrameKind;
+
+typedef struct expFrame {
+    unsigned char kind;   /* FrameKind */
+    unsigned char power;  /* the least power taken under it */
+    unsigned closed;      /* ParenF: closed powers outside */
+    TreeNode* p;          /* OperandF: operator and left operand */
+    int depth;            /* OperandF: of the left operand */
+} ExpFrame;
+
+/* pushFrame returns a new frame on top of the top in
+ * use; NULL, stopping the parse, if out of memory */
+static ExpFrame* pushFrame(ParseContext* ctx, int* top)
+{
+    if(*top == ctx->frameCapacity) {
+        int capacity = (*top == 0) ? 64 : 2 * *top;
+        ExpFrame* frames = (ExpFrame*) realloc(ctx->frames, capacity * sizeof(ExpFrame));
+        if(frames == NULL) {
+            fprintf(ctx->listing, "Out of memory error at line %d\n",
+                    tokenLine(&ctx->tokens, ctx->cur));
+            ctx->Error = TRUE;
+            stopParse(ctx);
+            return NULL;
         }
+        ctx->frames = frames;
+        ctx->frameCapacity = capacity;
     }
-    // 实现not
-    if(hasNot) {
-        switch(t->attr.op) {
-            case LT:
-                t->attr.op = GTE;
-                break;
-            case LTE:
-                t->attr.op = GT;
-                break;
-            case GT:
-                t->attr.op = LTE;
-                break;
-            case GTE:
-                t->attr.op = LT;
-                break;
-            case EQ:
-                t->attr.op = NE;
-                break;
-            case NE:
-                t->attr.op = EQ;
-                break;
-            default:
-                break;
-        }
+    return &ctx->frames[(*top)++];
+}
+
+/* joinDepth returns the depth of an operator node over
+ * operands of the given depths, reporting a tree that
+ * has just grown too deep for nestingLimit */
+static int joinDepth(ParseContext* ctx, int left, int right)
+{
+    int depth = 1 + ((left > right) ? left : right);
+    if(ctx->nesting + depth == nestingLimit(ctx) + 1) {
+        tooDeep(ctx);
     }
-    return t;
+    return depth;
 }
 
-// 实现逻辑表达式and, or
-TreeNode* exp2(void)
+/* operatorNode makes the node of op for the current
+ * token, with left as its left operand, and matches the
+ * token; NULL if out of memory */
+static TreeNode* operatorNode(ParseContext* ctx, const Operator* op, TreeNode* left)
 {
-    TreeNode* t = exp();
-    while(token == AND || token == OR) {
-        TreeNode* p = NULL;
-        if(token == AND) {
-            p = newStmtNode(AndK);
-        } else if(token == OR) {
-            p = newStmtNode(OrK);
-        }
-        match(token);
-        if(p != NULL) {
-            p->child[0] = t;
-            p->child[1] = exp();
-            t = p;
+    TreeNode* p = (op->nodekind == StmtK) ? newStmtNode(ctx, (StmtKind) op->kind)
+                  : newExpNode(ctx, (ExpKind) op->kind);
+    if(p != NULL) {
+        p->child[0] = left;
+        if(op->nodekind == ExpK) {
+            p->attr.op = ctx->token;
         }
     }
-    return t;
+    match(ctx, ctx->token);
+    return p;
 }
 
-// 实现-=赋值号
-TreeNode* minunseq_exp(char* varname)
+// 实现not
+static void negateComparison(TreeNode* t)
 {
-    TreeNode* t = newExpNode(OpK);
-    TreeNode* p = newExpNode(IdK);
-    if(t != NULL && p != NULL) {
-        p->attr.name = varname;
-        t->child[0] = p;
-        t->child[1] = simple_exp();
-        t->attr.op = MINUS;
+    switch(t->attr.op) {
+        case LT:
+            t->attr.op = GTE;
+            break;
+        case LTE:
+            t->attr.op = GT;
+            break;
+        case GT:
+            t->attr.op = LTE;
+            break;
+        case GTE:
+            t->attr.op = LT;
+            break;
+        case EQ:
+            t->attr.op = NE;
+            break;
+        case NE:
+            t->attr.op = EQ;
+            break;
+        default:
+            break;
     }
-    return t;
 }
 
-TreeNode* simple_exp(void)
+/* parseExp parses an expression of operators binding
+ * at least power. A not may begin an expression, or
+ * the right operand of and/or, and flips the comparison
+ * under it, in parentheses or not. An operator whose power is
+ * closed, a second comparison or a tighter operator
+ * after #, ends the expression up to the innermost
+ * parenthesis, where it is an error */
+static TreeNode* parseExp(ParseContext* ctx, int power)
 {
-    TreeNode* t = term();
-    while(token == PLUS || token == MINUS
-          || token == LINK || token == LOR) { // 连接&和或|
-        TreeNode* p = NULL;
-        if(token == LINK || token == LOR) {
-            p = newExpNode(LopK);
-        } else {
-            p = newExpNode(OpK);
+    const OperatorIndex* index = operatorIndex();
+    int top = 0;
+    unsigned closed = 0;
+    bool ended = false;
+    bool canNot = power <= RelPower;
+    TreeNode* t;
+    int depth;
+    for(;;) {
+        ExpFrame* f;
+        /* an operand, or what opens one */
+        switch(ctx->token) {
+            case NUM :
+                t = newExpNode(ctx, ConstK);
+                if(t != NULL) {
+                    t->attr.val = tokenValue(ctx);
+                }
+                depth = 1;
+                match(ctx, NUM);
+                break;
+            case ID :
+                t = newExpNode(ctx, IdK);
+                if(t != NULL) {
+                    t->attr.name = tokenName(ctx);
+                }
+                depth = 1;
+                match(ctx, ID);
+                break;
+            case LPAREN :
+                if((f = pushFrame(ctx, &top)) == NULL) {
+                    return NULL;
+                }
+                f->kind = ParenF;
+                f->power = (unsigned char) power;
+                f->closed = closed;
+                match(ctx, LPAREN);
+                enterNesting(ctx);
+                power = OrPower;
+                closed = 0;
+                canNot = true;
+                continue;
+            case NOT :
+                if(canNot) {
+                    if((f = pushFrame(ctx, &top)) == NULL) {
+                        return NULL;
+                    }
+                    f->kind = NotF;
+                    f->power = (unsigned char) power;
+                    match(ctx, NOT);
+                    power = RelPower;
+                    canNot = false;
+                    continue;
+                }
+            /* fall through */
+            default:
+                /* a missing operand is left missing; any
+                   other token is skipped up to one that can
+                   begin an operand, which is then parsed, or
+                   follow one */
+                unexpectedToken(ctx);
+                skipTo(ctx, FACTOR_FIRST | EXP_FOLLOW);
+                if(inSet(ctx, FACTOR_FIRST)) {
+                    continue;
+                }
+                t = NULL;
+                depth = 0;
+                break;
         }
-        if(p != NULL) {
-            p->child[0] = t;
-            p->attr.op = token;
-            t = p;
-            match(token);
-            t->child[1] = term();
+        /* operators after it, and the frames they end */
+        for(;;) {
+            const Operator* op = index->of[ctx->token];
+            if(op != NULL && (closed & POWERBIT(op->power))) {
+                ended = true;
+            }
+            if(op != NULL && !ended && op->power >= power) {
+                TreeNode* p = operatorNode(ctx, op, t);
+                if(p == NULL) {
+                    continue;
+                }
+                if(op->fixity == Postfix) {
+                    t = p;
+                    depth = joinDepth(ctx, depth, 0);
+                    closed |= ~(2 * POWERBIT(op->power) - 1);
+                    continue;
+                }
+                if((f = pushFrame(ctx, &top)) == NULL) {
+                    return NULL;
+                }
+                f->kind = OperandF;
+                f->power = (unsigned char) power;
+                f->p = p;
+                f->depth = depth;
+                closed &= 2 * POWERBIT(op->power) - 1;
+                if(op->fixity == Single) {
+                    closed |= POWERBIT(op->power);
+                }
+                power = op->power + 1;
+                canNot = (power <= RelPower);
+                break;
+            }
+            if(top == 0) {
+                return t;
+            }
+            f = &ctx->frames[--top];
+            power = f->power;
+            if(f->kind == OperandF) {
+                f->p->child[1] = t;
+                depth = joinDepth(ctx, f->depth, depth);
+                t = f->p;
+            } else if(f->kind == NotF) {
+                if(t != NULL && t->nodekind == ExpK && t->kind.exp == OpK) {
+                    negateComparison(t);
+                }
+            } else {
+                ctx->nesting--;
+                STATS(ctx->stats.depth--);
+                match(ctx, RPAREN);
+                closed = f->closed;
+                ended = false;
+            }
         }
     }
-    return t;
 }
 
-TreeNode* term(void)
+TreeNode* exp2(ParseContext* ctx)
 {
-    TreeNode* t = term2();
-    while(token == TIMES || token == OVER || token == MOD) {
-        TreeNode* p = newExpNode(OpK);
-        if(p != NULL) {
-            p->child[0] = t;
-            p->attr.op = token;
-            t = p;
-            match(token);
-            p->child[1] = term2();
-        }
-    }
-    while(token == CLOSURE) { // 闭包#
-        TreeNode* p = newExpNode(LopK);
-        if(p != NULL) {
-            p->child[0] = t;
-            p->attr.op = token;
-            t = p;
-            match(token);
-        }
-    }
-    return t;
+    return parseExp(ctx, OrPower);
 }
 
-// 乘方运算，优先级最高
-TreeNode* term2(void)
+TreeNode* simple_exp(ParseContext* ctx)
 {
-    TreeNode* t = factor();
-    while(token == POWER) {
-        TreeNode* p = newExpNode(OpK);
-        if(p != NULL) {
-            p->child[0] = t;
-            p->attr.op = token;
-            t = p;
-            match(token);
-            p->child[1] = factor();
-        }
-    }
-    return t;
+    return parseExp(ctx, AddPower);
 }
 
-TreeNode* factor(void)
+// 实现-=赋值号
+TreeNode* minunseq_exp(ParseContext* ctx, char* varname)
 {
-    TreeNode* t = NULL;
-    switch(token) {
-        case NUM :
-            t = newExpNode(ConstK);
-            if((t != NULL) && (token == NUM)) {
-                t->attr.val = atoi(tokenString);
-            }
-            match(NUM);
-            break;
-        case ID :
-            t = newExpNode(IdK);
-            if((t != NULL) && (token == ID)) {
-                t->attr.name = copyString(tokenString);
-            }
-            match(ID);
-            break;
-        case LPAREN :
-            match(LPAREN);
-            t = exp2();
-            match(RPAREN);
-            break;
-        default:
-            syntaxError("unexpected token -> ");
-            printToken(token, tokenString);
-            token = getToken();
-            break;
+    TreeNode* t = newExpNode(ctx, OpK);
+    TreeNode* p = newExpNode(ctx, IdK);
+    if(t != NULL && p != NULL) {
+        p->attr.name = varname;
+        t->child[0] = p;
+        t->child[1] = simple_exp(ctx);
+        t->attr.op = MINUS;
     }
     return t;
 }
@@ -429,13 +772,55 @@ TreeNode* factor(void)
 /* Function parse returns the newly
  * constructed syntax tree
  */
-TreeNode* parse(void)
+TreeNode* parse(ParseContext* ctx)
 {
     TreeNode* t;
-    token = getToken();
-    t = stmt_sequence();
-    if(token != ENDFILE) {
-        syntaxError("Code ends before file\n");
+    if(ctx->tokens.count == 0) {
+        return NULL;
     }
+    STATS(double started = statsClock());
+    ctx->cur = 0;
+    ctx->token = tokenKind(&ctx->tokens, 0);
+    ctx->errors = 0;
+    ctx->recovering = FALSE;
+    ctx->nesting = 0;
+    t = stmt_sequence(ctx);
+    /* an end, else, until, while or enddo that closes
+       nothing is skipped, and the statements after it
+       are kept */
+    TreeNode* last = t;
+    while(ctx->token != ENDFILE && !parseCancelled(ctx)) {
+        unexpectedToken(ctx);
+        advance(ctx);
+        TreeNode* q = stmt_sequence(ctx);
+        while(last != NULL && last->sibling != NULL) {
+            last = last->sibling;
+        }
+        if(last == NULL) {
+            t = last = q;
+        } else {
+            last->sibling = q;
+        }
+    }
+    STATS(ctx->stats.seconds[ParsePhase] += statsClock() - started);
     return t;
 }
+
+TreeNode* parseStatement(ParseContext* ctx, int first)
+{
+    ctx->cur = first;
+    ctx->token = tokenKind(&ctx->tokens, first);
+    ctx->errors = 0;
+    ctx->recovering = FALSE;
+    ctx->nesting = 0;
+    return statement(ctx);
+}
+
+TreeNode* parseBuffer(ParseContext* ctx, const char* text, size_t size)
+{
+    scanBuffer(ctx, text, size);
+    ctx->Error = FALSE;
+    ctx->cancelled = FALSE;
+    lexBuffer(ctx);
+    return parse(ctx);
+}
@@ -10,8 +10,22 @@
 #define _PARSE_H_
 
 /* Function parse returns the newly
- * constructed syntax tree
+ * constructed syntax tree of the tokens
+ * left in ctx by lexBuffer
  */
-TreeNode* parse(void);
+TreeNode* parse(ParseContext* ctx);
+
+/* Function parseBuffer parses the size bytes of
+ * source text at text, which need not be
+ * NUL-terminated, and returns the syntax tree;
+ * the tree lives until releaseTree(ctx)
+ */
+TreeNode* parseBuffer(ParseContext* ctx, const char* text, size_t size);
+
+/* Function parseStatement parses the one statement
+ * starting at token index first of ctx->tokens and
+ * leaves ctx->cur on the token after it
+ */
+TreeNode* parseStatement(ParseContext* ctx, int first);
 
 #endif
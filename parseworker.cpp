@@ -0,0 +1,71 @@
+#include "parseworker.h"
+#include "util.h"
+#include "fold.h"
+#include "analyze.h"
+
+ParseWorker::ParseWorker(const std::atomic<int>* latest)
+    : latest(latest), fold(false), showSymtab(false)
+{
+    initReparser(&reparser);
+    reparser.ctx.latest = latest;
+    initFlatTree(&copy);
+    initContext(&scratch);
+    symtabInit(&symtab);
+}
+
+ParseWorker::~ParseWorker()
+{
+    freeReparser(&reparser);
+    freeFlatTree(&copy);
+    freeContext(&scratch);
+}
+
+/* 函数功能：打开或关闭常量折叠，下一次分析起生效 */
+void ParseWorker::setFolding(bool on)
+{
+    fold = on;
+}
+
+/* 函数功能：打开或关闭符号表的显示，下一次分析起生效 */
+void ParseWorker::setSymtab(bool on)
+{
+    showSymtab = on;
+}
+
+/* 函数功能：分析 text 并把打印好的语法树发回界面线程 */
+void ParseWorker::parse(QByteArray text, int ticket)
+{
+    // 队列里已经有更新的请求，这个不用做了
+    if(ticket != latest->load()) {
+        return;
+    }
+    reparser.ctx.ticket = ticket;
+    TreeNode* tree = reparseText(&reparser, text.constData(), text.size());
+    if(ticket != latest->load()) {
+        return;
+    }
+    // 没有语法错误才做语义分析，类型错误和警告放在语法树前面
+    std::string s;
+    if(!reparser.ctx.Error) {
+        analyze(&reparser.ctx, tree, &symtab, s);
+        if(showSymtab) {
+            if(!s.empty()) {
+                s += '\n';
+            }
+            printSymtab(&symtab, s);
+        }
+        if(!s.empty()) {
+            s += '\n';
+        }
+    }
+    // 有语法错误的树不折叠；折叠前先复制一份
+    if(fold && !reparser.ctx.Error && flattenTree(&copy, tree, NULL)) {
+        releaseTree(&scratch);
+        tree = foldTree(unflattenTree(&scratch, &copy), NULL);
+    }
+    printTree(tree, s, 0);
+    if(ticket != latest->load()) {
+        return;
+    }
+    emit treeReady(QString::fromStdString(s), ticket);
+}
@@ -0,0 +1,41 @@
+#ifndef PARSEWORKER_H
+#define PARSEWORKER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <atomic>
+#include "reparse.h"
+#include "flat.h"
+#include "symtab.h"
+
+/* ParseWorker 在后台线程里分析源程序并打印语法树。
+ * 每个请求带一个编号；*latest 一旦变成更新的编号，
+ * 正在进行的分析就会中途放弃，过时的结果也不会发出。
+ */
+class ParseWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    ParseWorker(const std::atomic<int>* latest);
+    ~ParseWorker();
+
+public slots:
+    void parse(QByteArray text, int ticket);
+    void setFolding(bool on);
+    void setSymtab(bool on);
+
+signals:
+    void treeReady(QString tree, int ticket);
+
+private:
+    const std::atomic<int>* latest;
+    Reparser reparser; // 保留上次的记号和语法树，只重新分析修改过的部分
+    bool fold;         // 是否显示常量折叠后的语法树
+    FlatTree copy;     // 折叠在语法树的副本上做，不破坏 reparser 保留的树
+    ParseContext scratch; // 副本所在的结点区
+    bool showSymtab;   // 是否在语法树前显示符号表
+    SymTab symtab;     // 每次分析重建，内存留着下次用
+};
+#endif // PARSEWORKER_H
@@ -0,0 +1,384 @@
+/****************************************************/
+/* File: reparse.cpp                                */
+/* Incremental reparsing implementation             */
+/****************************************************/
+
+#include <vector>
+#include "globals.h"
+#include "util.h"
+#include "spans.h"
+#include "scan.h"
+#include "parse.h"
+#include "reparse.h"
+
+using namespace std;
+
+void initReparser(Reparser* rp)
+{
+    initContext(&rp->ctx);
+    initSpans(&rp->spans);
+    initSpans(&rp->fresh);
+    rp->ctx.spans = &rp->spans;
+    rp->ctx.rope = &rp->text;
+    ropeAssign(&rp->text, NULL, 0);
+    rp->tree = NULL;
+    rp->parsed = FALSE;
+    rp->garbage = 0;
+    rp->full = FALSE;
+    rp->reparsed = 0;
+}
+
+void freeReparser(Reparser* rp)
+{
+    freeContext(&rp->ctx);
+    freeSpans(&rp->spans);
+    freeSpans(&rp->fresh);
+    ropeAssign(&rp->text, NULL, 0);
+    rp->tree = NULL;
+    rp->parsed = FALSE;
+}
+
+/* fullParse parses the whole document again, dropping
+ * the nodes of earlier trees; the size bytes at text
+ * are its text, or if text is NULL a copy of the rope */
+static TreeNode* fullParse(Reparser* rp, const char* text, size_t size)
+{
+    string copy;
+    if(text == NULL) {
+        ropeCopy(&rp->text, 0, rp->text.size, copy);
+        text = copy.data();
+        size = copy.size();
+    }
+    releaseTree(&rp->ctx);
+    clearSpans(&rp->spans);
+    rp->ctx.rope = NULL;
+    rp->tree = parseBuffer(&rp->ctx, text, size);
+    rp->ctx.rope = &rp->text;
+    scanBuffer(&rp->ctx, NULL, 0);
+    rp->parsed = TRUE;
+    rp->garbage = 0;
+    rp->full = TRUE;
+    rp->reparsed = rp->spans.count;
+    return rp->tree;
+}
+
+TreeNode* reparseAll(Reparser* rp, const char* text, size_t size)
+{
+    ropeAssign(&rp->text, text, size);
+    return fullParse(rp, text, size);
+}
+
+/* A Candidate is a run of sibling statements, the spans
+ * i to j, whose tokens cover the damaged ones */
+typedef struct {
+    int i;
+    int j;
+} Candidate;
+
+/* nextSibling returns the span of the statement after
+ * span e in its list, or -1 */
+static int nextSibling(const SpanArray* a, int e)
+{
+    int next = spanAfter(a, e);
+    if(next >= a->count || spanAt(a, e).stmt->sibling != spanAt(a, next).stmt) {
+        return -1;
+    }
+    return next;
+}
+
+/* findCandidates lists the runs of statements that can
+ * be reparsed in place of the damaged old tokens
+ * [r, k), innermost first: the siblings the damage
+ * spans, then each statement that holds it */
+static void findCandidates(const SpanArray* a, int r, int k, vector<Candidate>& found)
+{
+    /* x is the last statement started at or before r */
+    int lo = 0, hi = a->count;
+    while(lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if(spanAt(a, mid).first <= r) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    /* climb from x to the innermost statement e that
+       holds the damage; c is the one below it */
+    int c = -1;
+    int e = lo - 1;
+    while(e >= 0 && spanAt(a, e).end < k) {
+        c = e;
+        e = spanParent(a, e);
+    }
+    if(c >= 0) {
+        int j = c;
+        while(j >= 0 && spanAt(a, j).end < k) {
+            j = nextSibling(a, j);
+        }
+        if(j >= 0) {
+            Candidate run = { c, j };
+            found.push_back(run);
+        }
+    }
+    for(; e >= 0; e = spanParent(a, e)) {
+        Candidate holder = { e, e };
+        found.push_back(holder);
+    }
+}
+
+/* tokenOf returns the NodeToken of a node of the tree */
+static NodeToken* tokenOf(Reparser* rp, const TreeNode* t)
+{
+    return nodeToken(&rp->ctx, t);
+}
+
+/* Outcomes of one reparse attempt */
+#define ATTEMPT_DONE 0   /* the tree is up to date */
+#define ATTEMPT_WIDER 1  /* the edit reaches past the run */
+#define ATTEMPT_FAILED 2 /* syntax error or no memory */
+
+/* parseRun parses the statements of candidate c anew,
+ * into head to tail; the new tokens [r, n) replaced
+ * the old [r, k), so later tokens moved by n - k.
+ * Statements are parsed as stmt_sequence does until
+ * one ends on the old end of a statement of the run's
+ * list, at or after span j, past the damage: that is
+ * span *last */
+static int parseRun(Reparser* rp, const Candidate* c, int k, int n,
+                    int* last, TreeNode** head, TreeNode** tail)
+{
+    ParseContext* ctx = &rp->ctx;
+    const SpanArray* a = &rp->spans;
+    int shift = n - k;
+    int e = c->j;
+    int cur = spanAt(a, c->i).first;
+    *head = NULL;
+    *tail = NULL;
+    for(;;) {
+        TreeNode* t = parseStatement(ctx, cur);
+        if(ctx->Error) {
+            return ATTEMPT_FAILED;
+        }
+        if(*tail == NULL) {
+            *head = t;
+        } else {
+            (*tail)->sibling = t;
+        }
+        *tail = t;
+        cur = ctx->cur;
+        if(cur >= n) {
+            int old = cur - shift;
+            while(spanAt(a, e).end < old) {
+                e = nextSibling(a, e);
+                if(e < 0) {
+                    return ATTEMPT_WIDER;
+                }
+            }
+            if(spanAt(a, e).end == old) {
+                *last = e;
+                return ATTEMPT_DONE;
+            }
+        }
+        TokenType next = tokenKind(&ctx->tokens, cur);
+        if(next != SEMI) {
+            return (next == ENDFILE || next == END || next == ELSE || next == UNTIL
+                    || next == WHILE || next == ENDDO) ? ATTEMPT_WIDER : ATTEMPT_FAILED;
+        }
+        cur++;
+    }
+}
+
+/* attempt reparses candidate c, recording the spans of
+ * the new statements in rp->fresh, and puts them in
+ * place of the old ones. Only the ancestors of the run
+ * and the first node after it in each list that holds
+ * it are changed, and the spans of the blocks holding
+ * the old ones and of the ancestors */
+static int attempt(Reparser* rp, const Candidate* c, int k, int n)
+{
+    ParseContext* ctx = &rp->ctx;
+    SpanArray* a = &rp->spans;
+    SpanArray* fresh = &rp->fresh;
+    int shift = n - k;
+    int e;
+    TreeNode* head;
+    TreeNode* tail;
+    clearSpans(fresh);
+    ctx->spans = fresh;
+    ctx->Error = FALSE;
+    int outcome = parseRun(rp, c, k, n, &e, &head, &tail);
+    ctx->spans = a;
+    if(outcome != ATTEMPT_DONE) {
+        return outcome;
+    }
+    StmtSpan first = spanAt(a, c->i);
+    int from = c->i;
+    int to = spanAfter(a, e);
+    int added = fresh->count;
+    TreeNode* target = first.stmt;
+    TreeNode* after = spanAt(a, e).stmt->sibling;
+    /* put the new spans in place of the old ones, nested
+       as deep, the first holding target as the first new
+       statement will; where nothing moved they are
+       stored over the old ones */
+    vector<StmtSpan> spans(added);
+    for(int s = 0; s < added; s++) {
+        spans[s] = spanAt(fresh, s);
+        if(spans[s].stmt == head) {
+            spans[s].stmt = target;
+        }
+        spans[s].depth += first.depth;
+    }
+    if(shift == 0 && added == to - from) {
+        for(int s = 0; s < added; s++) {
+            setSpan(a, from + s, spans[s]);
+        }
+    } else if(!replaceSpans(a, from, to, spans.data(), added, shift)) {
+        return ATTEMPT_FAILED;
+    }
+    int before = first.first - tokenOf(rp, target)->token - tokenOf(rp, target)->shift;
+    int run = 0;
+    for(TreeNode* t = target; t != after; t = t->sibling) {
+        run += tokenOf(rp, t)->shift;
+    }
+    /* the nodes after the run were made at tokens that
+       have moved: shift the first node after it in its
+       list, and in each list or condition of the
+       statements holding it that follows it, which
+       starts past the run's first token. The spans of
+       those statements end as much later */
+    if(shift != 0) {
+        for(int p = spanParent(a, from); p >= 0; p = spanParent(a, p)) {
+            StmtSpan holder = spanAt(a, p);
+            TreeNode* s = holder.stmt;
+            int base = holder.first - tokenOf(rp, s)->token;
+            for(int i = 0; i < MAXCHILDREN; i++) {
+                TreeNode* list = s->child[i];
+                if(list != NULL) {
+                    NodeToken* n = tokenOf(rp, list);
+                    if(n->token + base + n->shift > first.first) {
+                        n->shift += shift;
+                    }
+                }
+            }
+            if(s->sibling != NULL) {
+                tokenOf(rp, s->sibling)->shift += shift;
+            }
+            holder.end += shift;
+            setSpan(a, p, holder);
+        }
+    }
+    /* link the new statements in place of spans i to e,
+       reusing the node of span i so its parent need not
+       be known; they were made at their true tokens, so
+       the first cancels what comes before it */
+    *target = *head;
+    if(tail == head) {
+        target->sibling = after;
+    } else {
+        tail->sibling = after;
+    }
+    tokenOf(rp, target)->shift = -before;
+    if(after != NULL) {
+        tokenOf(rp, after)->shift += before + run + shift;
+    }
+    rp->garbage += to - from;
+    rp->reparsed = added;
+    return ATTEMPT_DONE;
+}
+
+TreeNode* reparseEdit(Reparser* rp, size_t offset, size_t removed,
+                      const char* inserted, size_t length)
+{
+    ParseContext* ctx = &rp->ctx;
+    if(offset > rp->text.size) {
+        offset = rp->text.size;
+    }
+    if(removed > rp->text.size - offset) {
+        removed = rp->text.size - offset;
+    }
+    ropeReplace(&rp->text, offset, removed, inserted, length);
+    /* a tree with errors has no reliable spans, and the
+       nodes of replaced statements are only reclaimed
+       by a full parse */
+    if(!rp->parsed || ctx->Error || rp->tree == NULL || rp->garbage > rp->spans.count) {
+        return fullParse(rp, NULL, 0);
+    }
+    int r, k, n;
+    if(!relexEdit(ctx, offset, removed, length, &r, &k, &n)) {
+        return fullParse(rp, NULL, 0);
+    }
+    rp->full = FALSE;
+    rp->reparsed = 0;
+    if(r == k && r == n) {
+        return rp->tree; /* only blanks or comments changed */
+    }
+    vector<Candidate> found;
+    findCandidates(&rp->spans, r, k, found);
+    int outcome = ATTEMPT_WIDER;
+    int quiet = ctx->quiet;
+    ctx->quiet = TRUE;
+    for(size_t c = 0; c < found.size() && outcome == ATTEMPT_WIDER; c++) {
+        outcome = attempt(rp, &found[c], k, n);
+    }
+    ctx->quiet = quiet;
+    if(outcome != ATTEMPT_DONE) {
+        return fullParse(rp, NULL, 0);
+    }
+    return rp->tree;
+}
+
+TreeNode* reparseText(Reparser* rp, const char* text, size_t size)
+{
+    if(!rp->parsed) {
+        return reparseAll(rp, text, size);
+    }
+    /* the text is compared with the rope a block at a
+       time, from the front and then from the back */
+    const TextRope* old = &rp->text;
+    size_t oldSize = old->size;
+    size_t common = (oldSize < size) ? oldSize : size;
+    size_t prefix = 0;
+    while(prefix < common) {
+        size_t from, length;
+        const char* p = ropeBlock(old, prefix, &from, &length) + (prefix - from);
+        size_t n = from + length - prefix;
+        if(n > common - prefix) {
+            n = common - prefix;
+        }
+        if(memcmp(p, text + prefix, n) != 0) {
+            while(*p == text[prefix]) {
+                p++;
+                prefix++;
+            }
+            break;
+        }
+        prefix += n;
+    }
+    size_t suffix = 0;
+    size_t most = common - prefix;
+    while(suffix < most) {
+        size_t end = oldSize - suffix;
+        size_t from, length;
+        const char* p = ropeBlock(old, end - 1, &from, &length) + (end - from);
+        size_t n = end - from;
+        if(n > most - suffix) {
+            n = most - suffix;
+        }
+        if(memcmp(p - n, text + size - suffix - n, n) != 0) {
+            while(p[-1] == text[size - suffix - 1]) {
+                p--;
+                suffix++;
+            }
+            break;
+        }
+        suffix += n;
+    }
+    if(prefix == oldSize && prefix == size && !rp->ctx.cancelled) {
+        rp->full = FALSE;
+        rp->reparsed = 0;
+        return rp->tree;
+    }
+    return reparseEdit(rp, prefix, oldSize - prefix - suffix, text + prefix,
+                       size - prefix - suffix);
+}
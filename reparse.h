@@ -0,0 +1,65 @@
+/****************************************************/
+/* File: reparse.h                                  */
+/* Incremental reparsing: a Reparser keeps the      */
+/* source, tokens and tree of one document and      */
+/* redoes only the statements an edit touched       */
+/****************************************************/
+#include "globals.h"
+#include "srcbuf.h"
+
+#ifndef _REPARSE_H_
+#define _REPARSE_H_
+
+/* A Reparser must not be copied or moved once
+ * initReparser has been called; its tree stays valid
+ * until the next update
+ */
+typedef struct reparser {
+    ParseContext ctx;
+    TextRope text;     /* the source ctx->tokens refer to */
+    SpanArray spans;   /* spans of all statements of tree */
+    SpanArray fresh;   /* spans of the statements reparsed */
+    TreeNode* tree;
+    int parsed;        /* TRUE once text has been parsed */
+    int garbage;       /* spans replaced since the last full parse */
+    int full;          /* TRUE if the last update parsed everything */
+    int reparsed;      /* statements parsed by the last update */
+} Reparser;
+
+/* Procedure initReparser makes a reparser with no
+ * document, listing syntax errors to stdout
+ */
+void initReparser(Reparser* rp);
+
+/* Procedure freeReparser returns its memory */
+void freeReparser(Reparser* rp);
+
+/* Function reparseAll replaces the document with the
+ * size bytes at text and parses all of it
+ */
+TreeNode* reparseAll(Reparser* rp, const char* text, size_t size);
+
+/* Function reparseEdit replaces removed bytes at offset
+ * of the document with the length bytes at inserted,
+ * relexes the tokens around the edit and reparses the
+ * smallest statement sequence holding them; the tree
+ * is the same as a full parse of the edited document
+ * would give, down to the token of each node once
+ * the shift of the NodeToken of it, its ancestors
+ * and the earlier siblings of all of them is added.
+ * Besides the statements reparsed, an edit costs time
+ * in proportion to the depth of the statements holding
+ * it, to a block of tokens and one of spans, and to
+ * the number of blocks of tokens, spans and text,
+ * wherever it lands
+ */
+TreeNode* reparseEdit(Reparser* rp, size_t offset, size_t removed,
+                      const char* inserted, size_t length);
+
+/* Function reparseText makes the size bytes at text
+ * the document, reparsing only the range in which it
+ * differs from the previous one
+ */
+TreeNode* reparseText(Reparser* rp, const char* text, size_t size);
+
+#endif
@@ -5,59 +5,59 @@
 /* Kenneth C. Louden                                */
 /****************************************************/
 
+#include <algorithm>
+#include <string>
 #include "globals.h"
 #include "util.h"
 #include "scan.h"
+#include "scankern.h"
+#include "srcbuf.h"
+#include "stats.h"
 
 /* states in scanner DFA */
 typedef enum
 { START, INASSIGN, INCOMMENT, INNUM, INID, INMINUS, INLT, INGT, DONE }
 StateType;
 
-/* lexeme of identifier or reserved word */
-char tokenString[MAXTOKENLEN + 1];
-
-/* BUFLEN = length of the input buffer for
-   source code lines */
-#define BUFLEN 256
-
-static char lineBuf[BUFLEN]; /* holds the current line */
-int linepos = 0; /* current position in LineBuf */
-int bufsize = 0; /* current size of buffer string */
-int EOF_flag = FALSE; /* corrects ungetNextChar behavior on EOF */
+void scanBuffer(ParseContext* ctx, const char* data, size_t size)
+{
+    ctx->bufStart = data;
+    ctx->bufPos = data;
+    ctx->bufEnd = data + size;
+    ctx->EOF_flag = FALSE;
+    ctx->lineno = 1;
+}
 
-/* getNextChar fetches the next non-blank character
-   from lineBuf, reading in a new line if lineBuf is
-   exhausted */
-static int getNextChar(void)
+/* getNextChar fetches the next character of the
+   buffer, counting lines as newlines go by */
+static int getNextChar(ParseContext* ctx)
 {
-    if(!(linepos < bufsize)) {
-        lineno++;
-        if(fgets(lineBuf, BUFLEN - 1, source)) {
-            bufsize = strlen(lineBuf);
-            linepos = 0;
-            return lineBuf[linepos++];
-        } else {
-            EOF_flag = TRUE;
-            return EOF;
+    if(ctx->bufPos < ctx->bufEnd) {
+        int c = (unsigned char) * ctx->bufPos++;
+        if(c == '\n') {
+            ctx->lineno++;
         }
+        return c;
     } else {
-        return lineBuf[linepos++];
+        ctx->EOF_flag = TRUE;
+        return EOF;
     }
 }
 
 /* ungetNextChar backtracks one character
-   in lineBuf */
-static void ungetNextChar(void)
+   in the buffer */
+static void ungetNextChar(ParseContext* ctx)
 {
-    if(!EOF_flag) {
-        linepos-- ;
+    if(!ctx->EOF_flag) {
+        if(*--ctx->bufPos == '\n') {
+            ctx->lineno--;
+        }
     }
 }
 
 /* lookup table of reserved words */
 static struct {
-    string str;
+    const char* str;
     TokenType tok;
 } reservedWords[MAXRESERVED]
 = {{"if", IF}, {"then", THEN}, {"else", ELSE}, {"end", END},
@@ -67,25 +67,72 @@ static struct {
     {"and", AND}, {"or", OR}, {"not", NOT}
 };
 
+/* reservedIndex maps a lexeme to the only entry of
+ * reservedWords it could match, or -1; the length and
+ * first letter (second letter for write/while) pick
+ * the entry, so no reserved word shares a case
+ */
+static int reservedIndex(const char* s, int len)
+{
+    switch(len) {
+        case 2:
+            switch(s[0]) {
+                case 'i': return 0;   /* if */
+                case 'd': return 8;   /* do */
+                case 't': return 11;  /* to */
+                case 'o': return 15;  /* or */
+            }
+            break;
+        case 3:
+            switch(s[0]) {
+                case 'e': return 3;   /* end */
+                case 'f': return 10;  /* for */
+                case 'a': return 14;  /* and */
+                case 'n': return 16;  /* not */
+            }
+            break;
+        case 4:
+            switch(s[0]) {
+                case 't': return 1;   /* then */
+                case 'e': return 2;   /* else */
+                case 'r': return 6;   /* read */
+            }
+            break;
+        case 5:
+            switch(s[0]) {
+                case 'u': return 5;   /* until */
+                case 'w': return (s[1] == 'r') ? 7 : 9;  /* write, while */
+                case 'e': return 13;  /* enddo */
+            }
+            break;
+        case 6:
+            switch(s[0]) {
+                case 'r': return 4;   /* repeat */
+                case 'd': return 12;  /* downto */
+            }
+            break;
+    }
+    return -1;
+}
+
 /* lookup an identifier to see if it is a reserved word */
-/* uses linear search */
-static TokenType reservedLookup(string s)
+/* uses a length and first letter switch and one compare */
+TokenType reservedLookup(const char* s, int len)
 {
-    for(int i = 0; i < MAXRESERVED; i++)
-        //        if(!strcmp(s, reservedWords[i].str)) {
-        if(s == reservedWords[i].str) {
-            return reservedWords[i].tok;
-        }
+    int i = reservedIndex(s, len);
+    if(i >= 0 && memcmp(s, reservedWords[i].str, len) == 0) {
+        return reservedWords[i].tok;
+    }
     return ID;
 }
 
 /****************************************/
-/* the primary function of the scanner  */
+/* the hand-written scanner             */
 /****************************************/
-/* function getToken returns the
+/* function getTokenSwitch returns the
  * next token in source file
  */
-TokenType getToken(void)
+TokenType getTokenSwitch(ParseContext* ctx)
 {
     /* index for storing into tokenString */
     int tokenStringIndex = 0;
@@ -96,7 +143,7 @@ TokenType getToken(void)
     /* flag to indicate save to tokenString */
     int save;
     while(state != DONE) {
-        int c = getNextChar();
+        int c = getNextChar(ctx);
         save = TRUE;
         switch(state) {
             case START:
@@ -106,13 +153,7 @@ TokenType getToken(void)
                     state = INID;
                 } else if(c == '=') {
                     state = INASSIGN;
-                } else if(c == ':') {
-                    /* backup in the input */
-                    state = DONE;
-                    ungetNextChar();
-                    save = FALSE;
-                    currentToken = ERROR;
-                } else if((c == ' ') || (c == '\t') || (c == '\n')) {
+                } else if((c == ' ') || (c == '\t') || (c == '\n') || (c == '\r')) {
                     save = FALSE;
                 } else if(c == '{') {
                     save = FALSE;
@@ -175,7 +216,7 @@ TokenType getToken(void)
                     currentToken = MINUSEQ;
                 } else {
                     tokenStringIndex--;
-                    linepos--;
+                    ungetNextChar(ctx);
                     currentToken = MINUS;
                 }
                 break;
@@ -187,7 +228,7 @@ TokenType getToken(void)
                     currentToken = NE;
                 } else {
                     tokenStringIndex--;
-                    linepos--;
+                    ungetNextChar(ctx);
                     currentToken = LT;
                 }
                 break;
@@ -197,7 +238,7 @@ TokenType getToken(void)
                     currentToken = GTE;
                 } else {
                     tokenStringIndex--;
-                    linepos--;
+                    ungetNextChar(ctx);
                     currentToken = GT;
                 }
                 break;
@@ -216,14 +257,14 @@ TokenType getToken(void)
                     currentToken = EQ;
                 } else {
                     tokenStringIndex--;
-                    linepos--;
+                    ungetNextChar(ctx);
                     currentToken = ASSIGN;
                 }
                 break;
             case INNUM:
                 if(!isdigit(c)) {
                     /* backup in the input */
-                    ungetNextChar();
+                    ungetNextChar(ctx);
                     save = FALSE;
                     state = DONE;
                     currentToken = NUM;
@@ -232,7 +273,7 @@ TokenType getToken(void)
             case INID:
                 if(!isalpha(c)) {
                     /* backup in the input */
-                    ungetNextChar();
+                    ungetNextChar(ctx);
                     save = FALSE;
                     state = DONE;
                     currentToken = ID;
@@ -240,20 +281,672 @@ TokenType getToken(void)
                 break;
             case DONE:
             default: /* should never happen */
-                fprintf(listing, "Scanner Bug: state= %d\n", state);
+                fprintf(ctx->listing, "Scanner Bug: state= %d\n", state);
                 state = DONE;
                 currentToken = ERROR;
                 break;
         }
-        if((save) && (tokenStringIndex <= MAXTOKENLEN)) {
-            tokenString[tokenStringIndex++] = (char) c;
+        if((save) && (tokenStringIndex < MAXTOKENLEN)) {
+            ctx->tokenString[tokenStringIndex++] = (char) c;
         }
         if(state == DONE) {
-            tokenString[tokenStringIndex] = '\0';
+            ctx->tokenString[tokenStringIndex] = '\0';
             if(currentToken == ID) {
-                currentToken = reservedLookup(tokenString);
+                currentToken = reservedLookup(ctx->tokenString, tokenStringIndex);
             }
         }
     }
     return currentToken;
-} /* end getToken */
+} /* end getTokenSwitch */
+
+/****************************************/
+/* the table-driven scanner             */
+/****************************************/
+
+/* character classes of the scanner DFA; every
+   special symbol has a class of its own */
+typedef enum {
+    CC_OTHER, CC_DIGIT, CC_LETTER, CC_SPACE, CC_LBRACE, CC_RBRACE,
+    CC_EQ, CC_MINUS, CC_LT, CC_GT, CC_PLUS, CC_TIMES, CC_OVER, CC_MOD,
+    CC_POWER, CC_LPAREN, CC_RPAREN, CC_SEMI, CC_CLOSURE, CC_LOR, CC_LINK,
+    CC_EOF, NCLASSES
+} CharClass;
+
+/* SCANEOF stands for end of input in the class table */
+#define SCANEOF 256
+
+constexpr int classOf(int c)
+{
+    return (c >= '0' && c <= '9') ? CC_DIGIT
+           : ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) ? CC_LETTER
+           : (c == ' ' || c == '\t' || c == '\n' || c == '\r') ? CC_SPACE
+           : (c == '{') ? CC_LBRACE : (c == '}') ? CC_RBRACE
+           : (c == '=') ? CC_EQ : (c == '-') ? CC_MINUS
+           : (c == '<') ? CC_LT : (c == '>') ? CC_GT
+           : (c == '+') ? CC_PLUS : (c == '*') ? CC_TIMES
+           : (c == '/') ? CC_OVER : (c == '%') ? CC_MOD
+           : (c == '^') ? CC_POWER : (c == '(') ? CC_LPAREN
+           : (c == ')') ? CC_RPAREN : (c == ';') ? CC_SEMI
+           : (c == '#') ? CC_CLOSURE : (c == '|') ? CC_LOR
+           : (c == '&') ? CC_LINK : (c == SCANEOF) ? CC_EOF
+           : CC_OTHER;
+}
+
+/* an action says what to do with the current
+   character: the low byte is the next state, or
+   the finished token when ACT_DONE is set; the
+   lexeme is the text from the last entry into
+   START up to the last character consumed */
+#define ACT_BACK 0x200  /* leave it for the next token */
+#define ACT_DONE 0x400  /* the token is complete */
+
+#define SHIFT(s) (s)                        /* take it, go to s */
+#define SKIP(s) (s)                         /* pass it, go to s */
+#define ACCEPT(t) (ACT_DONE | (t))          /* it ends token t */
+#define FINISH(t) (ACT_DONE | ACT_BACK | (t)) /* t ended before it */
+
+/* the token specification: one rule per state and
+   character class that does not take the default */
+typedef struct {
+    StateType state;
+    CharClass cls;
+    unsigned action;
+} ScanRule;
+
+constexpr ScanRule scanRules[] = {
+    { START, CC_DIGIT, SHIFT(INNUM) },
+    { START, CC_LETTER, SHIFT(INID) },
+    { START, CC_SPACE, SKIP(START) },
+    { START, CC_LBRACE, SKIP(INCOMMENT) },
+    { START, CC_EQ, SHIFT(INASSIGN) },     // =、==
+    { START, CC_MINUS, SHIFT(INMINUS) },   // -、-=
+    { START, CC_LT, SHIFT(INLT) },         // 小于、小于等于、不等于
+    { START, CC_GT, SHIFT(INGT) },         // 大于、大于等于
+    { START, CC_PLUS, ACCEPT(PLUS) },
+    { START, CC_TIMES, ACCEPT(TIMES) },
+    { START, CC_OVER, ACCEPT(OVER) },
+    { START, CC_MOD, ACCEPT(MOD) },
+    { START, CC_POWER, ACCEPT(POWER) },
+    { START, CC_LPAREN, ACCEPT(LPAREN) },
+    { START, CC_RPAREN, ACCEPT(RPAREN) },
+    { START, CC_SEMI, ACCEPT(SEMI) },
+    { START, CC_CLOSURE, ACCEPT(CLOSURE) },
+    { START, CC_LOR, ACCEPT(LOR) },
+    { START, CC_LINK, ACCEPT(LINK) },
+    { START, CC_EOF, FINISH(ENDFILE) },
+    { INCOMMENT, CC_RBRACE, SKIP(START) },
+    { INCOMMENT, CC_EOF, FINISH(ENDFILE) },
+    { INNUM, CC_DIGIT, SHIFT(INNUM) },
+    { INID, CC_LETTER, SHIFT(INID) },
+    { INASSIGN, CC_EQ, ACCEPT(EQ) },
+    { INMINUS, CC_EQ, ACCEPT(MINUSEQ) },
+    { INLT, CC_EQ, ACCEPT(LTE) },
+    { INLT, CC_GT, ACCEPT(NE) },
+    { INGT, CC_EQ, ACCEPT(GTE) }
+};
+
+#define NRULES ((int) (sizeof(scanRules) / sizeof(scanRules[0])))
+
+/* what each state does with a character no rule names */
+constexpr unsigned scanDefaults[DONE] = {
+    ACCEPT(ERROR),     /* START */
+    FINISH(ASSIGN),    /* INASSIGN */
+    SKIP(INCOMMENT),   /* INCOMMENT */
+    FINISH(NUM),       /* INNUM */
+    FINISH(ID),        /* INID */
+    FINISH(MINUS),     /* INMINUS */
+    FINISH(LT),        /* INLT */
+    FINISH(GT)         /* INGT */
+};
+
+constexpr unsigned ruleFor(int state, int cls, int i)
+{
+    return (i == NRULES) ? scanDefaults[state]
+           : (scanRules[i].state == state && scanRules[i].cls == cls) ? scanRules[i].action
+           : ruleFor(state, cls, i + 1);
+}
+
+/* the class and transition tables are filled in by the
+   compiler, one classOf or ruleFor call per entry */
+template<int... I> struct IndexList {};
+template<int N, int... I> struct MakeIndex : MakeIndex < N - 1, N - 1, I... > {};
+template<int... I> struct MakeIndex<0, I...> {
+    typedef IndexList<I...> type;
+};
+
+template<typename L> struct ClassTable;
+template<int... C> struct ClassTable<IndexList<C...>> {
+    static const unsigned char map[sizeof...(C)];
+};
+template<int... C>
+const unsigned char ClassTable<IndexList<C...>>::map[sizeof...(C)] = { classOf(C)... };
+
+template<typename L> struct TransitionTable;
+template<int... I> struct TransitionTable<IndexList<I...>> {
+    static const unsigned short map[sizeof...(I)];
+};
+template<int... I>
+const unsigned short TransitionTable<IndexList<I...>>::map[sizeof...(I)]
+    = { ruleFor(I / NCLASSES, I % NCLASSES, 0)... };
+
+typedef ClassTable<MakeIndex<SCANEOF + 1>::type> CharClasses;
+typedef TransitionTable<MakeIndex<DONE * NCLASSES>::type> Transitions;
+
+/* scanTable returns the next token by walking the
+   transition table over the buffer, and sets *start
+   to its lexeme, which ends at ctx->bufPos; runs of
+   blanks, comment text, letters and digits are passed
+   over by the bulk kernels of scankern */
+static inline TokenType scanTable(ParseContext* ctx, const char** start)
+{
+    const unsigned char* classes = CharClasses::map;
+    const unsigned short* trans = Transitions::map;
+    const ScanKernels* kern = scanKernels;
+    const char* p = ctx->bufPos;
+    const char* end = ctx->bufEnd;
+    const char* lexeme = p;
+    unsigned state = START;
+    unsigned act;
+    for(;;) {
+        switch(state) {
+            case START:
+                p = kern->skipSpace(p, end, &ctx->lineno);
+                lexeme = p;
+                break;
+            case INCOMMENT:
+                p = kern->skipComment(p, end, &ctx->lineno);
+                break;
+            case INID:
+                p = kern->skipLetters(p, end);
+                break;
+            case INNUM:
+                p = kern->skipDigits(p, end);
+                break;
+            default:
+                break;
+        }
+        int c = (p < end) ? (unsigned char) * p : SCANEOF;
+        act = trans[state * NCLASSES + classes[c]];
+        if(!(act & ACT_BACK)) {
+            ctx->lineno += (c == '\n');
+            p++;
+        }
+        if(act & ACT_DONE) {
+            break;
+        }
+        state = act & 0xff;
+    }
+    ctx->bufPos = p;
+    *start = lexeme;
+    TokenType currentToken = (TokenType)(act & 0xff);
+    if(currentToken == ID) {
+        currentToken = reservedLookup(lexeme, (int)(p - lexeme));
+    }
+    return currentToken;
+}
+
+/* function getTokenTable returns the next token
+   from the table-driven scanner, copying its lexeme
+   into tokenString */
+TokenType getTokenTable(ParseContext* ctx)
+{
+    const char* start;
+    TokenType currentToken = scanTable(ctx, &start);
+    size_t len = ctx->bufPos - start;
+    if(len > MAXTOKENLEN) {
+        len = MAXTOKENLEN;
+    }
+    memcpy(ctx->tokenString, start, len);
+    ctx->tokenString[len] = '\0';
+    return currentToken;
+} /* end getTokenTable */
+
+/****************************************/
+/* the primary function of the scanner  */
+/****************************************/
+/* function getToken returns the
+ * next token in source file
+ */
+TokenType getToken(ParseContext* ctx)
+{
+    TokenType t = getTokenTable(ctx);
+    STATS(ctx->stats.tokens[t]++);
+    return t;
+}
+
+/****************************************/
+/* the token array                      */
+/****************************************/
+
+int findTokenBlock(const TokenArray* a, int i)
+{
+    int lo = 0, hi = a->blocks - 1;
+    while(lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if(a->first[mid] <= i) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    a->hint = lo;
+    return lo;
+}
+
+/* reserveBlocks makes a keep at least n spare blocks,
+   with room in its arrays for all of them to be used;
+   returns FALSE if out of memory */
+static int reserveBlocks(TokenArray* a, int n)
+{
+    int need = a->blocks + ((a->spare > n) ? a->spare : n) + 1;
+    if(need > a->capacity) {
+        int capacity = (a->capacity * 2 > need) ? a->capacity * 2 : need;
+        if(capacity < 64) {
+            capacity = 64;
+        }
+        TokenBlock** block = (TokenBlock**) realloc(a->block, capacity * sizeof(TokenBlock*));
+        if(block != NULL) {
+            a->block = block;
+        }
+        int* first = (int*) realloc(a->first, capacity * sizeof(int));
+        if(first != NULL) {
+            a->first = first;
+        }
+        unsigned* start = (unsigned*) realloc(a->start, capacity * sizeof(unsigned));
+        if(start != NULL) {
+            a->start = start;
+        }
+        int* line = (int*) realloc(a->line, capacity * sizeof(int));
+        if(line != NULL) {
+            a->line = line;
+        }
+        if(block == NULL || first == NULL || start == NULL || line == NULL) {
+            return FALSE;
+        }
+        a->capacity = capacity;
+    }
+    while(a->spare < n) {
+        TokenBlock* k = (TokenBlock*) malloc(sizeof(TokenBlock));
+        if(k == NULL) {
+            return FALSE;
+        }
+        a->block[a->blocks + a->spare++] = k;
+    }
+    return TRUE;
+}
+
+/* moveBlocks moves the blocks of a from at on by n:
+   up, putting n spare blocks before them, which must
+   have been reserved; or down, making the n before
+   them spare. Only the first tokens, offsets and lines
+   of the blocks moved are kept */
+static void moveBlocks(TokenArray* a, int at, int n)
+{
+    TokenBlock** end = a->block + a->blocks + a->spare;
+    if(n > 0) {
+        std::rotate(a->block + at, end - n, end);
+    } else if(n < 0) {
+        std::rotate(a->block + at + n, a->block + at, end);
+    } else {
+        return;
+    }
+    memmove(a->first + at + n, a->first + at, (a->blocks + 1 - at) * sizeof(int));
+    memmove(a->start + at + n, a->start + at, (a->blocks - at) * sizeof(unsigned));
+    memmove(a->line + at + n, a->line + at, (a->blocks - at) * sizeof(int));
+    a->blocks += n;
+    a->spare -= n;
+}
+
+/* appendToken adds one token at the end of a; returns
+   FALSE if out of memory */
+static inline int appendToken(TokenArray* a, TokenType t, unsigned start, unsigned length,
+                              int line)
+{
+    int b = a->blocks - 1;
+    if(b < 0 || a->count - a->first[b] == TOKENBLOCK) {
+        if(!reserveBlocks(a, 1)) {
+            return FALSE;
+        }
+        b = a->blocks++;
+        a->spare--;
+        a->first[b] = a->count;
+        a->start[b] = start;
+        a->line[b] = line;
+    }
+    TokenBlock* k = a->block[b];
+    int j = a->count - a->first[b];
+    k->kind[j] = (unsigned char) t;
+    k->start[j] = start - a->start[b];
+    k->length[j] = length;
+    k->line[j] = line - a->line[b];
+    a->first[b + 1] = ++a->count;
+    return TRUE;
+}
+
+/* CANCELPOLL + 1 = tokens lexed between checks for
+   a cancelled parse */
+#define CANCELPOLL 0xfff
+
+void lexBuffer(ParseContext* ctx)
+{
+    TokenArray* a = &ctx->tokens;
+    const char* base = ctx->bufStart;
+    TokenType t;
+    STATS(double started = statsClock());
+    a->spare += a->blocks;
+    a->blocks = 0;
+    a->count = 0;
+    a->hint = 0;
+    do {
+        const char* start;
+        t = scanTable(ctx, &start);
+        if((a->count & CANCELPOLL) == 0 && parseCancelled(ctx)) {
+            t = ENDFILE; /* the tokens will not be parsed */
+        }
+        STATS(int held = a->blocks + a->spare);
+        if(!appendToken(a, t, (unsigned)(start - base), (unsigned)(ctx->bufPos - start),
+                        ctx->lineno)) {
+            fprintf(ctx->listing, "Out of memory error at line %d\n", ctx->lineno);
+            ctx->Error = TRUE;
+            if(a->count == 0) {
+                return;
+            }
+            int b = a->blocks - 1;
+            a->block[b]->kind[a->count - 1 - a->first[b]] = (unsigned char) ENDFILE;
+            t = ENDFILE;
+        }
+        STATS(ctx->stats.allocBytes += (a->blocks + a->spare - held) * TOKENBYTES);
+        STATS(ctx->stats.tokens[t]++);
+    } while(t != ENDFILE);
+    STATS(ctx->stats.seconds[LexPhase] += statsClock() - started);
+}
+
+void freeTokens(TokenArray* a)
+{
+    for(int b = 0; b < a->blocks + a->spare; b++) {
+        free(a->block[b]);
+    }
+    free(a->block);
+    free(a->first);
+    free(a->start);
+    free(a->line);
+    a->block = NULL;
+    a->first = NULL;
+    a->start = NULL;
+    a->line = NULL;
+    a->blocks = 0;
+    a->spare = 0;
+    a->capacity = 0;
+    a->count = 0;
+    a->hint = 0;
+}
+
+/* A TokenRun is a few tokens gathered by relexEdit,
+   with their offsets and lines as they are */
+typedef struct {
+    unsigned char* kind;
+    unsigned* start;
+    unsigned* length;
+    int* line;
+    int count;
+    int capacity;
+} TokenRun;
+
+/* appendRun adds one token to r; returns FALSE if out
+   of memory */
+static int appendRun(TokenRun* r, TokenType t, unsigned start, unsigned length, int line)
+{
+    if(r->count == r->capacity) {
+        int capacity = (r->capacity == 0) ? 256 : r->capacity * 2;
+        unsigned char* kind = (unsigned char*) realloc(r->kind, capacity);
+        if(kind != NULL) {
+            r->kind = kind;
+        }
+        unsigned* starts = (unsigned*) realloc(r->start, capacity * sizeof(unsigned));
+        if(starts != NULL) {
+            r->start = starts;
+        }
+        unsigned* lengths = (unsigned*) realloc(r->length, capacity * sizeof(unsigned));
+        if(lengths != NULL) {
+            r->length = lengths;
+        }
+        int* lines = (int*) realloc(r->line, capacity * sizeof(int));
+        if(lines != NULL) {
+            r->line = lines;
+        }
+        if(kind == NULL || starts == NULL || lengths == NULL || lines == NULL) {
+            return FALSE;
+        }
+        r->capacity = capacity;
+    }
+    int i = r->count++;
+    r->kind[i] = (unsigned char) t;
+    r->start[i] = start;
+    r->length[i] = length;
+    r->line[i] = line;
+    return TRUE;
+}
+
+/* appendTokens adds tokens [i, end) of a to r, moving
+   their offsets by delta and their lines by lineDelta;
+   returns FALSE if out of memory */
+static int appendTokens(TokenRun* r, const TokenArray* a, int i, int end, long delta,
+                        int lineDelta)
+{
+    for(; i < end; i++) {
+        if(!appendRun(r, tokenKind(a, i), (unsigned)(tokenStart(a, i) + delta),
+                      tokenLength(a, i), tokenLine(a, i) + lineDelta)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* freeRun returns the memory of r */
+static void freeRun(TokenRun* r)
+{
+    free(r->kind);
+    free(r->start);
+    free(r->length);
+    free(r->line);
+}
+
+/* findToken returns the index of the token of a
+   starting at offset, searching from index lo, or -1 */
+static int findToken(const TokenArray* a, int lo, size_t offset)
+{
+    int hi = a->count;
+    while(lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if(tokenStart(a, mid) < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (lo < a->count && tokenStart(a, lo) == offset) ? lo : -1;
+}
+
+/* widenWindow appends to window, which holds the text
+   of ctx->rope from base on, the text up to the end of
+   the block holding through, or at least as much again
+   as it holds, and makes it the scanner's buffer */
+static void widenWindow(ParseContext* ctx, string& window, size_t base, size_t through)
+{
+    const TextRope* rope = ctx->rope;
+    size_t end = base + window.size();
+    if(through < end + window.size()) {
+        through = end + window.size();
+    }
+    if(through < rope->size) {
+        size_t from, length;
+        ropeBlock(rope, through, &from, &length);
+        through = from + length;
+    } else {
+        through = rope->size;
+    }
+    ropeCopy(rope, end, through - end, window);
+    ctx->bufStart = window.data();
+    ctx->bufEnd = window.data() + window.size();
+}
+
+int relexEdit(ParseContext* ctx, size_t offset, size_t removed, size_t inserted,
+              int* first, int* oldEnd, int* newEnd)
+{
+    TokenArray* a = &ctx->tokens;
+    long delta = (long) inserted - (long) removed;
+    size_t editEnd = offset + inserted;
+    /* r is the first token that ends at or after the edit;
+       the scanner is in START just after token r - 1 */
+    int lo = 0, hi = a->count - 1;
+    while(lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if(tokenStart(a, mid) + tokenLength(a, mid) < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    int r = lo;
+    size_t pos = (r > 0) ? tokenStart(a, r - 1) + tokenLength(a, r - 1) : 0;
+    /* with a rope, the text from pos through the block of
+       the edit's end is scanned from a window, which a
+       token or comment running to its end widens */
+    const char* bufStart = ctx->bufStart;
+    const char* bufEnd = ctx->bufEnd;
+    string window;
+    size_t base = 0;
+    if(ctx->rope != NULL) {
+        base = pos;
+        widenWindow(ctx, window, base, editEnd);
+    }
+    ctx->bufPos = ctx->bufStart + (pos - base);
+    ctx->lineno = (r > 0) ? tokenLine(a, r - 1) : 1;
+    /* scan until a token starts past the edit where an
+       old token started: from there on nothing changed */
+    TokenRun fresh = { NULL, NULL, NULL, NULL, 0, 0 };
+    int k = a->count;
+    int lineDelta = 0;
+    for(;;) {
+        const char* start;
+        size_t at = ctx->bufPos - ctx->bufStart;
+        int line = ctx->lineno;
+        TokenType t = scanTable(ctx, &start);
+        if(ctx->rope != NULL && ctx->bufPos == ctx->bufEnd
+           && base + window.size() < ctx->rope->size) {
+            widenWindow(ctx, window, base, 0);
+            ctx->bufPos = ctx->bufStart + at;
+            ctx->lineno = line;
+            continue;
+        }
+        STATS(ctx->stats.tokens[t]++);
+        size_t p = base + (start - ctx->bufStart);
+        if(p >= editEnd) {
+            int m = findToken(a, r, p - delta);
+            if(m >= 0 && tokenKind(a, m) == t) {
+                k = m;
+                lineDelta = ctx->lineno - tokenLine(a, m);
+                break;
+            }
+        }
+        if(!appendRun(&fresh, t, (unsigned) p, (unsigned)(ctx->bufPos - start), ctx->lineno)) {
+            k = -1; /* out of memory */
+            break;
+        }
+        if(t == ENDFILE) {
+            break;
+        }
+    }
+    if(ctx->rope != NULL) {
+        ctx->bufStart = bufStart;
+        ctx->bufPos = bufStart;
+        ctx->bufEnd = bufEnd;
+    }
+    if(k < 0) {
+        freeRun(&fresh);
+        return FALSE;
+    }
+    *first = r;
+    *oldEnd = k;
+    *newEnd = r + fresh.count;
+    if(fresh.count == k - r && delta == 0 && lineDelta == 0) {
+        /* nothing after them moved: overwrite them where
+           they are */
+        for(int i = 0; i < fresh.count; i++) {
+            int b = tokenBlock(a, r + i);
+            TokenBlock* block = a->block[b];
+            int j = r + i - a->first[b];
+            block->kind[j] = fresh.kind[i];
+            block->start[j] = fresh.start[i] - a->start[b];
+            block->length[j] = fresh.length[i];
+            block->line[j] = fresh.line[i] - a->line[b];
+        }
+        freeRun(&fresh);
+        return TRUE;
+    }
+    /* rewrite the blocks from that of token r to that of
+       the last token replaced, with the next one if they
+       would be less than half full, spreading the tokens
+       over them evenly; the blocks after them only move */
+    int from = tokenBlock(a, r);
+    int to = (k > r) ? tokenBlock(a, k - 1) : from;
+    int total = (r - a->first[from]) + fresh.count + (a->first[to + 1] - k);
+    while(total < TOKENBLOCK / 2 && to + 1 < a->blocks) {
+        to++;
+        total += a->first[to + 1] - a->first[to];
+    }
+    TokenRun run = { NULL, NULL, NULL, NULL, 0, 0 };
+    int blocks = (total + TOKENBLOCK - 1) / TOKENBLOCK;
+    int had = to + 1 - from;
+    int ok = appendTokens(&run, a, a->first[from], r, 0, 0)
+             && appendTokens(&run, a, k, a->first[to + 1], delta, lineDelta)
+             && (blocks <= had || reserveBlocks(a, blocks - had));
+    if(!ok) {
+        freeRun(&fresh);
+        freeRun(&run);
+        return FALSE;
+    }
+    int head = r - a->first[from];
+    int at = a->first[from];
+    int growth = fresh.count - (k - r);
+    moveBlocks(a, to + 1, blocks - had);
+    for(int q = 0; q < blocks; q++) {
+        int b = from + q;
+        TokenBlock* block = a->block[b];
+        int begin = (int)((long long) total * q / blocks);
+        int end = (int)((long long) total * (q + 1) / blocks);
+        for(int i = begin; i < end; i++) {
+            /* the run holds the head, then the tail; the
+               fresh tokens go between them */
+            const TokenRun* src = &run;
+            int s = i;
+            if(i >= head && i < head + fresh.count) {
+                src = &fresh;
+                s = i - head;
+            } else if(i >= head) {
+                s = i - fresh.count;
+            }
+            if(i == begin) {
+                a->first[b] = at + begin;
+                a->start[b] = src->start[s];
+                a->line[b] = src->line[s];
+            }
+            int j = i - begin;
+            block->kind[j] = src->kind[s];
+            block->start[j] = src->start[s] - a->start[b];
+            block->length[j] = src->length[s];
+            block->line[j] = src->line[s] - a->line[b];
+        }
+    }
+    for(int b = from + blocks; b < a->blocks; b++) {
+        a->first[b] += growth;
+        a->start[b] += (unsigned) delta;
+        a->line[b] += lineDelta;
+    }
+    a->count += growth;
+    a->first[a->blocks] = a->count;
+    a->hint = from;
+    freeRun(&fresh);
+    freeRun(&run);
+    return TRUE;
+}
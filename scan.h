@@ -9,15 +9,54 @@
 #ifndef _SCAN_H_
 #define _SCAN_H_
 
-/* MAXTOKENLEN is the maximum size of a token */
-#define MAXTOKENLEN 40
+/* procedure scanBuffer makes the size bytes at data
+ * the scanner input of ctx; the bytes must stay valid
+ * and unchanged until scanning is finished
+ */
+void scanBuffer(ParseContext* ctx, const char* data, size_t size);
+
+/* procedure lexBuffer scans the whole input of ctx
+ * into ctx->tokens, ending with one ENDFILE; the
+ * lexemes are left in place in the source text
+ */
+void lexBuffer(ParseContext* ctx);
+
+/* function relexEdit brings ctx->tokens up to date
+ * after removed bytes at offset of the source were
+ * replaced by inserted bytes; ctx must already scan
+ * the edited source, or hold it in ctx->rope, from
+ * which only the text rescanned is copied out. The
+ * old tokens [*first, *oldEnd)
+ * became [*first, *newEnd), and all others were kept,
+ * shifted; the time taken grows with the tokens
+ * relexed, the blocks rewritten to hold them and the
+ * number of blocks, but not with where the edit is.
+ * Returns FALSE if out of memory
+ */
+int relexEdit(ParseContext* ctx, size_t offset, size_t removed, size_t inserted,
+              int* first, int* oldEnd, int* newEnd);
 
-/* tokenString array stores the lexeme of each token */
-extern char tokenString[MAXTOKENLEN + 1];
+/* procedure freeTokens returns a token array's
+ * memory to the system
+ */
+void freeTokens(TokenArray* a);
+
+/* function reservedLookup returns the reserved word
+ * spelled by the len characters at s, or ID
+ */
+TokenType reservedLookup(const char* s, int len);
 
 /* function getToken returns the
- * next token in source file
+ * next token in the source of ctx; its lexeme
+ * is left in ctx->tokenString
+ */
+TokenType getToken(ParseContext* ctx);
+
+/* getToken, lexBuffer and relexEdit use the
+ * table-driven scanner; the hand-written one is kept
+ * only for the scanner benchmark to compare against
  */
-TokenType getToken(void);
+TokenType getTokenTable(ParseContext* ctx);
+TokenType getTokenSwitch(ParseContext* ctx);
 
 #endif
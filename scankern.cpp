@@ -0,0 +1,313 @@
+/****************************************************/
+/* File: scankern.cpp                               */
+/* Scalar, SSE2 and AVX2 scanner kernels            */
+/****************************************************/
+
+#include "globals.h"
+#include "scankern.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KERN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+/**************************************************/
+/***********   Scalar kernels          ************/
+/**************************************************/
+
+static const char* skipSpaceScalar(const char* p, const char* end, int* lineno)
+{
+    while(p < end) {
+        char c = *p;
+        if(c == '\n') {
+            (*lineno)++;
+        } else if(c != ' ' && c != '\t' && c != '\r') {
+            break;
+        }
+        p++;
+    }
+    return p;
+}
+
+static const char* skipCommentScalar(const char* p, const char* end, int* lineno)
+{
+    while(p < end && *p != '}') {
+        *lineno += (*p == '\n');
+        p++;
+    }
+    return p;
+}
+
+static const char* skipLettersScalar(const char* p, const char* end)
+{
+    while(p < end && (unsigned)((*p | 0x20) - 'a') < 26) {
+        p++;
+    }
+    return p;
+}
+
+static const char* skipDigitsScalar(const char* p, const char* end)
+{
+    while(p < end && (unsigned)(*p - '0') < 10) {
+        p++;
+    }
+    return p;
+}
+
+static const ScanKernels scalarKernels = {
+    "scalar", skipSpaceScalar, skipCommentScalar, skipLettersScalar, skipDigitsScalar
+};
+
+#ifdef KERN_X86
+
+/* bit helpers over the byte masks of movemask */
+static inline int lowestBit(unsigned m)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, m);
+    return (int) i;
+#else
+    return __builtin_ctz(m);
+#endif
+}
+
+static inline int countBits(unsigned m)
+{
+#ifdef _MSC_VER
+    m = m - ((m >> 1) & 0x55555555u);
+    m = (m & 0x33333333u) + ((m >> 2) & 0x33333333u);
+    return (int)((((m + (m >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24);
+#else
+    return __builtin_popcount(m);
+#endif
+}
+
+/* bits below the first n of a mask */
+#define BELOW(n) ((n) >= 32 ? 0xffffffffu : (1u << (n)) - 1)
+
+/**************************************************/
+/***********   SSE2 kernels, 16 bytes  ************/
+/**************************************************/
+
+/* letters: (c | 0x20) - 'a' < 26, done as a signed
+   compare after biasing the range down to -128 */
+static inline unsigned letterMask16(__m128i x)
+{
+    __m128i t = _mm_add_epi8(_mm_or_si128(x, _mm_set1_epi8(0x20)),
+                             _mm_set1_epi8((char)(0x80 - 'a')));
+    return _mm_movemask_epi8(_mm_cmplt_epi8(t, _mm_set1_epi8((char)(0x80 + 26))));
+}
+
+static inline unsigned digitMask16(__m128i x)
+{
+    __m128i t = _mm_add_epi8(x, _mm_set1_epi8((char)(0x80 - '0')));
+    return _mm_movemask_epi8(_mm_cmplt_epi8(t, _mm_set1_epi8((char)(0x80 + 10))));
+}
+
+static const char* skipSpaceSse2(const char* p, const char* end, int* lineno)
+{
+    while(end - p >= 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*) p);
+        __m128i nl = _mm_cmpeq_epi8(x, _mm_set1_epi8('\n'));
+        __m128i sp = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')),
+                                               _mm_cmpeq_epi8(x, _mm_set1_epi8('\t'))),
+                                  _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\r')), nl));
+        unsigned lines = _mm_movemask_epi8(nl);
+        unsigned other = ~_mm_movemask_epi8(sp) & 0xffff;
+        if(other != 0) {
+            int n = lowestBit(other);
+            *lineno += countBits(lines & BELOW(n));
+            return p + n;
+        }
+        *lineno += countBits(lines);
+        p += 16;
+    }
+    return skipSpaceScalar(p, end, lineno);
+}
+
+static const char* skipCommentSse2(const char* p, const char* end, int* lineno)
+{
+    while(end - p >= 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*) p);
+        unsigned lines = _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')));
+        unsigned close = _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('}')));
+        if(close != 0) {
+            int n = lowestBit(close);
+            *lineno += countBits(lines & BELOW(n));
+            return p + n;
+        }
+        *lineno += countBits(lines);
+        p += 16;
+    }
+    return skipCommentScalar(p, end, lineno);
+}
+
+static const char* skipLettersSse2(const char* p, const char* end)
+{
+    while(end - p >= 16) {
+        unsigned other = ~letterMask16(_mm_loadu_si128((const __m128i*) p)) & 0xffff;
+        if(other != 0) {
+            return p + lowestBit(other);
+        }
+        p += 16;
+    }
+    return skipLettersScalar(p, end);
+}
+
+static const char* skipDigitsSse2(const char* p, const char* end)
+{
+    while(end - p >= 16) {
+        unsigned other = ~digitMask16(_mm_loadu_si128((const __m128i*) p)) & 0xffff;
+        if(other != 0) {
+            return p + lowestBit(other);
+        }
+        p += 16;
+    }
+    return skipDigitsScalar(p, end);
+}
+
+static const ScanKernels sse2Kernels = {
+    "sse2", skipSpaceSse2, skipCommentSse2, skipLettersSse2, skipDigitsSse2
+};
+
+/**************************************************/
+/***********   AVX2 kernels, 32 bytes  ************/
+/**************************************************/
+
+#ifdef _MSC_VER
+#define AVX2_FN
+#else
+#define AVX2_FN __attribute__((target("avx2")))
+#endif
+
+AVX2_FN static const char* skipSpaceAvx2(const char* p, const char* end, int* lineno)
+{
+    while(end - p >= 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) p);
+        __m256i nl = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n'));
+        __m256i sp = _mm256_or_si256(
+                         _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')),
+                                         _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\t'))),
+                         _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r')), nl));
+        unsigned lines = (unsigned) _mm256_movemask_epi8(nl);
+        unsigned other = ~(unsigned) _mm256_movemask_epi8(sp);
+        if(other != 0) {
+            int n = lowestBit(other);
+            *lineno += countBits(lines & BELOW(n));
+            return p + n;
+        }
+        *lineno += countBits(lines);
+        p += 32;
+    }
+    return skipSpaceSse2(p, end, lineno);
+}
+
+AVX2_FN static const char* skipCommentAvx2(const char* p, const char* end, int* lineno)
+{
+    while(end - p >= 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) p);
+        unsigned lines = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')));
+        unsigned close = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('}')));
+        if(close != 0) {
+            int n = lowestBit(close);
+            *lineno += countBits(lines & BELOW(n));
+            return p + n;
+        }
+        *lineno += countBits(lines);
+        p += 32;
+    }
+    return skipCommentSse2(p, end, lineno);
+}
+
+AVX2_FN static const char* skipLettersAvx2(const char* p, const char* end)
+{
+    while(end - p >= 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) p);
+        __m256i t = _mm256_add_epi8(_mm256_or_si256(x, _mm256_set1_epi8(0x20)),
+                                    _mm256_set1_epi8((char)(0x80 - 'a')));
+        unsigned other = ~(unsigned) _mm256_movemask_epi8(
+                             _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + 26)), t));
+        if(other != 0) {
+            return p + lowestBit(other);
+        }
+        p += 32;
+    }
+    return skipLettersSse2(p, end);
+}
+
+AVX2_FN static const char* skipDigitsAvx2(const char* p, const char* end)
+{
+    while(end - p >= 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) p);
+        __m256i t = _mm256_add_epi8(x, _mm256_set1_epi8((char)(0x80 - '0')));
+        unsigned other = ~(unsigned) _mm256_movemask_epi8(
+                             _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + 10)), t));
+        if(other != 0) {
+            return p + lowestBit(other);
+        }
+        p += 32;
+    }
+    return skipDigitsSse2(p, end);
+}
+
+static const ScanKernels avx2Kernels = {
+    "avx2", skipSpaceAvx2, skipCommentAvx2, skipLettersAvx2, skipDigitsAvx2
+};
+
+/* hasAvx2 asks the CPU, and the OS for saved YMM state */
+static int hasAvx2(void)
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    if(!(info[2] & (1 << 27)) || !(info[2] & (1 << 28))) {
+        return FALSE;
+    }
+    if((_xgetbv(0) & 6) != 6) {
+        return FALSE;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif /* KERN_X86 */
+
+/* SSE2 is the default on x86-64: TINY runs are mostly
+   shorter than 32 bytes, and on them the AVX2 kernels
+   measured slower in bench/scanbench */
+static const ScanKernels* bestKernels(void)
+{
+#ifdef KERN_X86
+    return &sse2Kernels;
+#else
+    return &scalarKernels;
+#endif
+}
+
+const ScanKernels* scanKernels = bestKernels();
+
+int selectScanKernels(const char* name)
+{
+    if(strcmp(name, "scalar") == 0) {
+        scanKernels = &scalarKernels;
+        return TRUE;
+    }
+#ifdef KERN_X86
+    if(strcmp(name, "sse2") == 0) {
+        scanKernels = &sse2Kernels;
+        return TRUE;
+    }
+    if(strcmp(name, "avx2") == 0 && hasAvx2()) {
+        scanKernels = &avx2Kernels;
+        return TRUE;
+    }
+#endif
+    return FALSE;
+}
@@ -0,0 +1,37 @@
+/****************************************************/
+/* File: scankern.h                                 */
+/* Bulk kernels for the scanner: skip runs of white */
+/* space, comment text, letters and digits many     */
+/* bytes at a time, chosen at run time by CPU       */
+/****************************************************/
+
+#ifndef _SCANKERN_H_
+#define _SCANKERN_H_
+
+typedef struct {
+    const char* name;
+    /* skipSpace returns the first byte at or after p that
+       is not blank, tab, CR or newline, adding the
+       newlines passed over to *lineno */
+    const char* (*skipSpace)(const char* p, const char* end, int* lineno);
+    /* skipComment returns the first '}' at or after p, or
+       end, adding the newlines passed over to *lineno */
+    const char* (*skipComment)(const char* p, const char* end, int* lineno);
+    /* skipLetters and skipDigits return the end of the run
+       of ASCII letters or digits starting at p */
+    const char* (*skipLetters)(const char* p, const char* end);
+    const char* (*skipDigits)(const char* p, const char* end);
+} ScanKernels;
+
+/* scanKernels is the set the scanner uses: SSE2 on
+ * x86-64, scalar elsewhere */
+extern const ScanKernels* scanKernels;
+
+/* Function selectScanKernels switches to the named set
+ * ("scalar", "sse2" or "avx2"); returns FALSE if this
+ * build or CPU cannot run it, which for AVX2 is asked
+ * of the CPU at run time
+ */
+int selectScanKernels(const char* name);
+
+#endif
@@ -0,0 +1,297 @@
+/****************************************************/
+/* File: spans.cpp                                  */
+/* Arrays of statement spans kept in blocks         */
+/****************************************************/
+
+#include <algorithm>
+#include "globals.h"
+#include "spans.h"
+
+/* Procedure initSpans makes an empty span array */
+void initSpans(SpanArray* a)
+{
+    a->block = NULL;
+    a->first = NULL;
+    a->token = NULL;
+    a->depth = NULL;
+    a->blocks = 0;
+    a->spare = 0;
+    a->capacity = 0;
+    a->count = 0;
+    a->open = 0;
+    a->hint = 0;
+}
+
+/* Procedure clearSpans removes every span of a, keeping
+ * its blocks for the next parse
+ */
+void clearSpans(SpanArray* a)
+{
+    a->spare += a->blocks;
+    a->blocks = 0;
+    a->count = 0;
+    a->open = 0;
+    a->hint = 0;
+}
+
+/* Procedure freeSpans returns the memory of a */
+void freeSpans(SpanArray* a)
+{
+    for(int b = 0; b < a->blocks + a->spare; b++) {
+        free(a->block[b]);
+    }
+    free(a->block);
+    free(a->first);
+    free(a->token);
+    free(a->depth);
+    initSpans(a);
+}
+
+/* spanBlock returns the block of a holding span i,
+ * 0 <= i < count, trying the one last looked up first */
+static int spanBlock(const SpanArray* a, int i)
+{
+    int b = a->hint;
+    if(i >= a->first[b] && i < a->first[b + 1]) {
+        return b;
+    }
+    int lo = 0, hi = a->blocks - 1;
+    while(lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if(a->first[mid] <= i) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    a->hint = lo;
+    return lo;
+}
+
+/* Function spanAt returns span i of a */
+StmtSpan spanAt(const SpanArray* a, int i)
+{
+    int b = spanBlock(a, i);
+    StmtSpan s = a->block[b]->span[i - a->first[b]];
+    s.first += a->token[b];
+    s.end += a->token[b];
+    return s;
+}
+
+/* Procedure setSpan makes s span i of a, which must
+ * already have one
+ */
+void setSpan(SpanArray* a, int i, StmtSpan s)
+{
+    int b = spanBlock(a, i);
+    if(s.depth < a->depth[b]) {
+        a->depth[b] = s.depth;
+    }
+    s.first -= a->token[b];
+    s.end -= a->token[b];
+    a->block[b]->span[i - a->first[b]] = s;
+}
+
+/* reserveSpanBlocks makes a keep at least n spare
+ * blocks, with room in its arrays for all of them to
+ * be used; returns FALSE if out of memory */
+static int reserveSpanBlocks(SpanArray* a, int n)
+{
+    int need = a->blocks + ((a->spare > n) ? a->spare : n) + 1;
+    if(need > a->capacity) {
+        int capacity = (a->capacity * 2 > need) ? a->capacity * 2 : need;
+        if(capacity < 64) {
+            capacity = 64;
+        }
+        SpanBlock** block = (SpanBlock**) realloc(a->block, capacity * sizeof(SpanBlock*));
+        if(block != NULL) {
+            a->block = block;
+        }
+        int* first = (int*) realloc(a->first, capacity * sizeof(int));
+        if(first != NULL) {
+            a->first = first;
+        }
+        int* token = (int*) realloc(a->token, capacity * sizeof(int));
+        if(token != NULL) {
+            a->token = token;
+        }
+        int* depth = (int*) realloc(a->depth, capacity * sizeof(int));
+        if(depth != NULL) {
+            a->depth = depth;
+        }
+        if(block == NULL || first == NULL || token == NULL || depth == NULL) {
+            return FALSE;
+        }
+        a->capacity = capacity;
+    }
+    while(a->spare < n) {
+        SpanBlock* k = (SpanBlock*) malloc(sizeof(SpanBlock));
+        if(k == NULL) {
+            return FALSE;
+        }
+        a->block[a->blocks + a->spare++] = k;
+    }
+    return TRUE;
+}
+
+/* moveSpanBlocks moves the blocks of a from at on by
+ * n: up, putting n spare blocks before them, which must
+ * have been reserved; or down, making the n before them
+ * spare */
+static void moveSpanBlocks(SpanArray* a, int at, int n)
+{
+    SpanBlock** end = a->block + a->blocks + a->spare;
+    if(n > 0) {
+        std::rotate(a->block + at, end - n, end);
+    } else if(n < 0) {
+        std::rotate(a->block + at + n, a->block + at, end);
+    } else {
+        return;
+    }
+    memmove(a->first + at + n, a->first + at, (a->blocks + 1 - at) * sizeof(int));
+    memmove(a->token + at + n, a->token + at, (a->blocks - at) * sizeof(int));
+    memmove(a->depth + at + n, a->depth + at, (a->blocks - at) * sizeof(int));
+    a->blocks += n;
+    a->spare -= n;
+}
+
+/* Function appendSpan adds s after the spans of a;
+ * returns FALSE if out of memory
+ */
+int appendSpan(SpanArray* a, StmtSpan s)
+{
+    int b = a->blocks - 1;
+    if(b < 0 || a->count - a->first[b] == SPANBLOCK) {
+        if(!reserveSpanBlocks(a, 1)) {
+            return FALSE;
+        }
+        b = a->blocks++;
+        a->spare--;
+        a->first[b] = a->count;
+        a->token[b] = s.first;
+        a->depth[b] = s.depth;
+    }
+    if(s.depth < a->depth[b]) {
+        a->depth[b] = s.depth;
+    }
+    s.first -= a->token[b];
+    s.end -= a->token[b];
+    a->block[b]->span[a->count - a->first[b]] = s;
+    a->first[b + 1] = ++a->count;
+    return TRUE;
+}
+
+/* Function replaceSpans puts the n spans at s in place
+ * of spans [from, to) of a, from < to, and moves the
+ * tokens of the spans after them by shift. The blocks
+ * holding the spans replaced are rewritten, with the
+ * next one if they would be less than half full; the
+ * later ones only move. Returns FALSE, leaving a as it
+ * was, if out of memory
+ */
+int replaceSpans(SpanArray* a, int from, int to, const StmtSpan* s, int n, int shift)
+{
+    int lo = spanBlock(a, from);
+    int hi = spanBlock(a, to - 1);
+    int total = (from - a->first[lo]) + n + (a->first[hi + 1] - to);
+    while(total < SPANBLOCK / 2 && hi + 1 < a->blocks) {
+        hi++;
+        total += a->first[hi + 1] - a->first[hi];
+    }
+    int blocks = (total + SPANBLOCK - 1) / SPANBLOCK;
+    int had = hi + 1 - lo;
+    StmtSpan* run = (StmtSpan*) malloc((total > 0 ? total : 1) * sizeof(StmtSpan));
+    if(run == NULL || (blocks > had && !reserveSpanBlocks(a, blocks - had))) {
+        free(run);
+        return FALSE;
+    }
+    int at = a->first[lo];
+    int head = from - at;
+    for(int i = 0; i < head; i++) {
+        run[i] = spanAt(a, at + i);
+    }
+    memcpy(run + head, s, n * sizeof(StmtSpan));
+    for(int i = to; i < a->first[hi + 1]; i++) {
+        StmtSpan t = spanAt(a, i);
+        t.first += shift;
+        t.end += shift;
+        run[head + n + i - to] = t;
+    }
+    int growth = n - (to - from);
+    moveSpanBlocks(a, hi + 1, blocks - had);
+    for(int q = 0; q < blocks; q++) {
+        int b = lo + q;
+        int begin = (int)((long long) total * q / blocks);
+        int end = (int)((long long) total * (q + 1) / blocks);
+        a->first[b] = at + begin;
+        a->token[b] = run[begin].first;
+        a->depth[b] = run[begin].depth;
+        for(int i = begin; i < end; i++) {
+            StmtSpan t = run[i];
+            if(t.depth < a->depth[b]) {
+                a->depth[b] = t.depth;
+            }
+            t.first -= a->token[b];
+            t.end -= a->token[b];
+            a->block[b]->span[i - begin] = t;
+        }
+    }
+    for(int b = lo + blocks; b < a->blocks; b++) {
+        a->first[b] += growth;
+        a->token[b] += shift;
+    }
+    a->count += growth;
+    a->first[a->blocks] = a->count;
+    a->hint = 0;
+    free(run);
+    return TRUE;
+}
+
+/* Function spanParent returns the span of the statement
+ * holding span i of a, or -1; the blocks between them
+ * are passed over by their least depth
+ */
+int spanParent(const SpanArray* a, int i)
+{
+    int b = spanBlock(a, i);
+    int depth = a->block[b]->span[i - a->first[b]].depth;
+    for(int j = i - 1;;) {
+        const StmtSpan* span = a->block[b]->span;
+        for(; j >= a->first[b]; j--) {
+            if(span[j - a->first[b]].depth < depth) {
+                return j;
+            }
+        }
+        do {
+            b--;
+        } while(b >= 0 && a->depth[b] >= depth);
+        if(b < 0) {
+            return -1;
+        }
+        j = a->first[b + 1] - 1;
+    }
+}
+
+/* Function spanAfter returns the first span of a after
+ * span i and the spans nested in it, or count
+ */
+int spanAfter(const SpanArray* a, int i)
+{
+    int b = spanBlock(a, i);
+    int depth = a->block[b]->span[i - a->first[b]].depth;
+    for(int j = i + 1;;) {
+        const StmtSpan* span = a->block[b]->span;
+        for(; j < a->first[b + 1]; j++) {
+            if(span[j - a->first[b]].depth <= depth) {
+                return j;
+            }
+        }
+        do {
+            b++;
+        } while(b < a->blocks && a->depth[b] > depth);
+        if(b == a->blocks) {
+            return a->count;
+        }
+        j = a->first[b];
+    }
+}
@@ -0,0 +1,54 @@
+/****************************************************/
+/* File: spans.h                                    */
+/* Statement spans: the tokens and depth of every   */
+/* statement parsed, kept in blocks so an edit      */
+/* rewrites only the spans it touched               */
+/****************************************************/
+#include "globals.h"
+
+#ifndef _SPANS_H_
+#define _SPANS_H_
+
+/* Procedure initSpans makes an empty span array */
+void initSpans(SpanArray* a);
+
+/* Procedure clearSpans removes every span of a, keeping
+ * its blocks for the next parse
+ */
+void clearSpans(SpanArray* a);
+
+/* Procedure freeSpans returns the memory of a */
+void freeSpans(SpanArray* a);
+
+/* Function spanAt returns span i of a */
+StmtSpan spanAt(const SpanArray* a, int i);
+
+/* Procedure setSpan makes s span i of a, which must
+ * already have one
+ */
+void setSpan(SpanArray* a, int i, StmtSpan s);
+
+/* Function appendSpan adds s after the spans of a;
+ * returns FALSE if out of memory
+ */
+int appendSpan(SpanArray* a, StmtSpan s);
+
+/* Function replaceSpans puts the n spans at s in place
+ * of spans [from, to) of a, from < to, and moves the
+ * tokens of the spans after them by shift; only the
+ * blocks of the spans replaced are rewritten. Returns
+ * FALSE, leaving a as it was, if out of memory
+ */
+int replaceSpans(SpanArray* a, int from, int to, const StmtSpan* s, int n, int shift);
+
+/* Function spanParent returns the span of the statement
+ * holding span i of a, or -1
+ */
+int spanParent(const SpanArray* a, int i);
+
+/* Function spanAfter returns the first span of a after
+ * span i and the spans nested in it, or count
+ */
+int spanAfter(const SpanArray* a, int i);
+
+#endif
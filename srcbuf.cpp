@@ -0,0 +1,248 @@
+/****************************************************/
+/* File: srcbuf.cpp                                 */
+/* Memory-mapped source buffers and text ropes      */
+/****************************************************/
+
+#include "globals.h"
+#include "srcbuf.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* an empty file cannot be mapped, so it scans this */
+static const char emptySource[1] = "";
+
+static void clearSource(SourceBuffer* b)
+{
+    b->data = emptySource;
+    b->size = 0;
+    b->map = NULL;
+    b->handle = NULL;
+}
+
+#ifdef _WIN32
+
+int mapSource(SourceBuffer* b, const char* path)
+{
+    clearSource(b);
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(file == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return FALSE;
+    }
+    if(size.QuadPart == 0) {
+        CloseHandle(file);
+        return TRUE;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if(mapping == NULL) {
+        return FALSE;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(view == NULL) {
+        CloseHandle(mapping);
+        return FALSE;
+    }
+    b->data = (const char*) view;
+    b->size = (size_t) size.QuadPart;
+    b->map = view;
+    b->handle = mapping;
+    return TRUE;
+}
+
+void unmapSource(SourceBuffer* b)
+{
+    if(b->map != NULL) {
+        UnmapViewOfFile(b->map);
+        CloseHandle((HANDLE) b->handle);
+    }
+    clearSource(b);
+}
+
+#else
+
+int mapSource(SourceBuffer* b, const char* path)
+{
+    clearSource(b);
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return FALSE;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return FALSE;
+    }
+    if(st.st_size == 0) {
+        close(fd);
+        return TRUE;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        return FALSE;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    b->data = (const char*) map;
+    b->size = (size_t) st.st_size;
+    b->map = map;
+    return TRUE;
+}
+
+void unmapSource(SourceBuffer* b)
+{
+    if(b->map != NULL) {
+        munmap(b->map, b->size);
+    }
+    clearSource(b);
+}
+
+#endif
+
+/* isBlank tells whether a block may be cut after c */
+static bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/* cutBlocks appends the n bytes at text to blocks in
+   pieces of at least ROPEBLOCK bytes, each ending with
+   a blank, but for the last; that takes the rest once
+   less than half a block would follow it */
+static void cutBlocks(const char* text, size_t n, std::vector<std::string>& blocks)
+{
+    size_t p = 0;
+    while(p < n) {
+        size_t q = p + ROPEBLOCK;
+        while(q < n && !isBlank(text[q - 1])) {
+            q++;
+        }
+        if(q >= n || n - q < ROPEBLOCK / 2) {
+            q = n;
+        }
+        blocks.push_back(std::string(text + p, q - p));
+        p = q;
+    }
+}
+
+void ropeAssign(TextRope* r, const char* text, size_t size)
+{
+    r->block.clear();
+    r->start.clear();
+    cutBlocks(text, size, r->block);
+    if(r->block.empty()) {
+        r->block.push_back(std::string());
+    }
+    size_t at = 0;
+    for(size_t b = 0; b < r->block.size(); b++) {
+        r->start.push_back(at);
+        at += r->block[b].size();
+    }
+    r->size = size;
+    r->hint = 0;
+}
+
+/* ropeFind returns the block of r holding the byte at
+   offset, or the last one if offset is size */
+static int ropeFind(const TextRope* r, size_t offset)
+{
+    int b = r->hint;
+    if(b < (int) r->block.size() && offset >= r->start[b]
+       && offset < r->start[b] + r->block[b].size()) {
+        return b;
+    }
+    int lo = 0, hi = (int) r->block.size() - 1;
+    while(lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if(r->start[mid] <= offset) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    r->hint = lo;
+    return lo;
+}
+
+void ropeReplace(TextRope* r, size_t offset, size_t removed, const char* inserted,
+                 size_t length)
+{
+    if(offset > r->size) {
+        offset = r->size;
+    }
+    if(removed > r->size - offset) {
+        removed = r->size - offset;
+    }
+    /* the blocks from that of offset to that of the last
+       byte removed are cut anew, with the next ones while
+       they would be less than half a block or not end
+       with a blank */
+    int lo = ropeFind(r, offset);
+    int hi = (removed > 0) ? ropeFind(r, offset + removed - 1) : lo;
+    size_t from = r->start[lo];
+    std::string text(r->block[lo], 0, offset - from);
+    text.append(inserted, length);
+    text.append(r->block[hi], offset + removed - r->start[hi], std::string::npos);
+    int last = (int) r->block.size() - 1;
+    while(hi < last && (text.size() < ROPEBLOCK / 2 || !isBlank(text.back()))) {
+        hi++;
+        text += r->block[hi];
+    }
+    std::vector<std::string> pieces;
+    cutBlocks(text.data(), text.size(), pieces);
+    if(pieces.empty() && lo == 0 && hi == last) {
+        pieces.push_back(std::string());
+    }
+    r->block.erase(r->block.begin() + lo, r->block.begin() + hi + 1);
+    r->start.erase(r->start.begin() + lo, r->start.begin() + hi + 1);
+    r->block.insert(r->block.begin() + lo, pieces.size(), std::string());
+    r->start.insert(r->start.begin() + lo, pieces.size(), 0);
+    for(size_t i = 0; i < pieces.size(); i++) {
+        r->block[lo + i].swap(pieces[i]);
+        r->start[lo + i] = from;
+        from += r->block[lo + i].size();
+    }
+    for(size_t b = lo + pieces.size(); b < r->block.size(); b++) {
+        r->start[b] += length - removed;
+    }
+    r->size += length - removed;
+    r->hint = 0;
+}
+
+const char* ropeBlock(const TextRope* r, size_t offset, size_t* from, size_t* length)
+{
+    int b = ropeFind(r, offset);
+    *from = r->start[b];
+    *length = r->block[b].size();
+    return r->block[b].data();
+}
+
+void ropeCopy(const TextRope* r, size_t offset, size_t n, std::string& s)
+{
+    while(n > 0) {
+        size_t from, length;
+        const char* block = ropeBlock(r, offset, &from, &length);
+        size_t k = from + length - offset;
+        if(k == 0) {
+            return; /* past the end */
+        }
+        if(k > n) {
+            k = n;
+        }
+        s.append(block + (offset - from), k);
+        offset += k;
+        n -= k;
+    }
+}
@@ -0,0 +1,68 @@
+/****************************************************/
+/* File: srcbuf.h                                   */
+/* Whole-file source buffers for the scanner: the   */
+/* file is memory-mapped and scanned in place; an   */
+/* edited source is kept in a rope of blocks        */
+/****************************************************/
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#ifndef _SRCBUF_H_
+#define _SRCBUF_H_
+
+typedef struct {
+    const char* data; /* first byte of the source text */
+    size_t size;      /* number of bytes at data */
+    void* map;        /* start of the mapping, NULL if none */
+    void* handle;     /* mapping object (Windows only) */
+} SourceBuffer;
+
+/* Function mapSource maps the file at path read-only;
+ * returns FALSE if it cannot be opened or mapped
+ */
+int mapSource(SourceBuffer*, const char* path);
+
+/* Procedure unmapSource releases a mapped source */
+void unmapSource(SourceBuffer*);
+
+/* ROPEBLOCK = bytes a block of a TextRope is cut to */
+#define ROPEBLOCK 4096
+
+/* A TextRope holds a source that is edited in blocks
+ * of about ROPEBLOCK bytes, each cut after a blank so
+ * that no lexeme runs from one into the next. An edit
+ * rewrites only the blocks it falls in, and changes
+ * the offset of each later one
+ */
+typedef struct textRope {
+    std::vector<std::string> block; /* one, empty, for no text */
+    std::vector<size_t> start; /* offset of each block */
+    size_t size;
+    mutable int hint; /* the block last looked up */
+} TextRope;
+
+/* Procedure ropeAssign makes the size bytes at text
+ * the text of r
+ */
+void ropeAssign(TextRope* r, const char* text, size_t size);
+
+/* Procedure ropeReplace replaces removed bytes at
+ * offset of r with the length bytes at inserted
+ */
+void ropeReplace(TextRope* r, size_t offset, size_t removed, const char* inserted,
+                 size_t length);
+
+/* Function ropeBlock returns the block of r holding the
+ * byte at offset, or the last one if offset is size,
+ * setting *from to the offset of the block and *length
+ * to its size
+ */
+const char* ropeBlock(const TextRope* r, size_t offset, size_t* from, size_t* length);
+
+/* Procedure ropeCopy appends n bytes of r from offset
+ * to s
+ */
+void ropeCopy(const TextRope* r, size_t offset, size_t n, std::string& s);
+
+#endif
@@ -0,0 +1,122 @@
+/****************************************************/
+/* File: stats.cpp                                  */
+/* Performance counters of the scanner, parser and  */
+/* tree printer                                     */
+/****************************************************/
+
+#include <chrono>
+#include "stats.h"
+
+static const char* tokenNames[NTOKENTYPES] = {
+    "ENDFILE", "ERROR",
+    "IF", "THEN", "ELSE", "END", "REPEAT", "UNTIL", "READ", "WRITE", "WHILE",
+    "DO", "FOR", "ENDDO", "TO", "DOWNTO", "AND", "OR", "NOT",
+    "ID", "NUM",
+    "ASSIGN", "EQ", "LT", "PLUS", "MINUS", "TIMES", "OVER", "LPAREN",
+    "RPAREN", "SEMI", "MINUSEQ", "MOD", "POWER", "LTE", "GT", "GTE", "NE",
+    "LINK", "LOR", "CLOSURE"
+};
+
+static const char* stmtNames[NSTMTKINDS] = {
+    "If", "Repeat", "Assign", "Read", "Write", "DoWhile", "For", "To",
+    "Downto", "And", "Or"
+};
+
+static const char* expNames[NEXPKINDS] = { "Op", "Const", "Id", "Lop" };
+
+static const char* phaseNames[NPHASES] = { "lex", "parse", "print" };
+
+double statsClock(void)
+{
+    return std::chrono::duration<double>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void resetStats(ParseContext* ctx)
+{
+#ifdef TINY_STATS
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+#else
+    (void) ctx;
+#endif
+}
+
+const ParseStats* parseStats(const ParseContext* ctx)
+{
+#ifdef TINY_STATS
+    return &ctx->stats;
+#else
+    (void) ctx;
+    return NULL;
+#endif
+}
+
+void addStats(ParseStats* total, const ParseStats* s)
+{
+    for(int i = 0; i < NPHASES; i++) {
+        total->seconds[i] += s->seconds[i];
+    }
+    for(int i = 0; i < NTOKENTYPES; i++) {
+        total->tokens[i] += s->tokens[i];
+    }
+    for(int i = 0; i < NSTMTKINDS; i++) {
+        total->stmts[i] += s->stmts[i];
+    }
+    for(int i = 0; i < NEXPKINDS; i++) {
+        total->exps[i] += s->exps[i];
+    }
+    total->allocBytes += s->allocBytes;
+    if(s->maxDepth > total->maxDepth) {
+        total->maxDepth = s->maxDepth;
+    }
+    total->outBytes += s->outBytes;
+}
+
+/* printCounts writes the nonzero counters of a table,
+ * four to a line, after their total */
+static void printCounts(FILE* fp, const char* title, const char** names,
+                        const unsigned long* counts, int n)
+{
+    unsigned long total = 0;
+    for(int i = 0; i < n; i++) {
+        total += counts[i];
+    }
+    fprintf(fp, "%-10s %lu\n", title, total);
+    int column = 0;
+    int width = 0; /* of the last count on the line */
+    for(int i = 0; i < n; i++) {
+        if(counts[i] != 0) {
+            char count[24];
+            if(column > 0) {
+                fprintf(fp, "%*s", 12 - width, "");
+            }
+            width = snprintf(count, sizeof(count), "%lu", counts[i]);
+            fprintf(fp, "%10s %s", names[i], count);
+            if(++column == 4) {
+                fputc('\n', fp);
+                column = 0;
+            }
+        }
+    }
+    if(column != 0) {
+        fputc('\n', fp);
+    }
+}
+
+void printStats(FILE* fp, const ParseStats* s)
+{
+    if(s == NULL) {
+        fprintf(fp, "no statistics: the counters were not compiled in "
+                "(define TINY_STATS)\n");
+        return;
+    }
+    for(int i = 0; i < NPHASES; i++) {
+        fprintf(fp, "%-10s %.3f ms\n", phaseNames[i], s->seconds[i] * 1e3);
+    }
+    printCounts(fp, "tokens", tokenNames, s->tokens, NTOKENTYPES);
+    printCounts(fp, "stmt nodes", stmtNames, s->stmts, NSTMTKINDS);
+    printCounts(fp, "exp nodes", expNames, s->exps, NEXPKINDS);
+    fprintf(fp, "%-10s %zu bytes\n", "allocated", s->allocBytes);
+    fprintf(fp, "%-10s %d\n", "max depth", s->maxDepth);
+    fprintf(fp, "%-10s %zu bytes\n", "output", s->outBytes);
+}
@@ -0,0 +1,47 @@
+/****************************************************/
+/* File: stats.h                                    */
+/* Performance counters of the scanner, parser and  */
+/* tree printer, compiled in with TINY_STATS        */
+/****************************************************/
+#include "globals.h"
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+/* STATS(code) runs code only when TINY_STATS is
+ * defined; otherwise the counting is compiled out and
+ * a ParseContext has no counters at all
+ */
+#ifdef TINY_STATS
+    #define STATS(...) __VA_ARGS__
+#else
+    #define STATS(...)
+#endif
+
+/* TOKENBYTES = bytes of one block of a TokenArray */
+#define TOKENBYTES sizeof(TokenBlock)
+
+/* function statsClock returns a reading in seconds of
+ * the clock the phases are timed with
+ */
+double statsClock(void);
+
+/* procedure resetStats sets the counters of ctx to 0 */
+void resetStats(ParseContext* ctx);
+
+/* function parseStats returns the counters of ctx,
+ * or NULL if they are compiled out
+ */
+const ParseStats* parseStats(const ParseContext* ctx);
+
+/* procedure addStats adds the counters of s to those
+ * of total; the depths are combined by maximum
+ */
+void addStats(ParseStats* total, const ParseStats* s);
+
+/* procedure printStats writes a report of the
+ * counters to fp, or a note if s is NULL
+ */
+void printStats(FILE* fp, const ParseStats* s);
+
+#endif
@@ -0,0 +1,132 @@
+/****************************************************/
+/* File: symtab.cpp                                 */
+/* Symbol table implementation for the TINY         */
+/* compiler: an open-addressing hash table keyed    */
+/* by the interned names                            */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdint.h>
+#include <algorithm>
+#include "symtab.h"
+
+using namespace std;
+
+/* INITSLOTS = slots allocated on first use */
+#define INITSLOTS 256
+
+void symtabInit(SymTab* st)
+{
+    st->slots.clear();
+    st->symbols.clear();
+    st->lines.clear();
+}
+
+void symtabReset(SymTab* st)
+{
+    if(!st->symbols.empty()) {
+        fill(st->slots.begin(), st->slots.end(), 0);
+    }
+    st->symbols.clear();
+    st->lines.clear();
+}
+
+/* hashName spreads the address of an interned name
+ * over the slots; equal names have equal addresses, so
+ * the characters need not be read. A name starts 12
+ * bytes into an 8-byte aligned block, so its low three
+ * bits are always 100; taking the high half of the
+ * product lets the varying bits above them choose the
+ * slot
+ */
+static unsigned hashName(const char* name, unsigned mask)
+{
+    unsigned long long h = (unsigned long long) (uintptr_t) name * 0x9e3779b97f4a7c15ULL;
+    return (unsigned) (h >> 32) & mask;
+}
+
+/* growSlots doubles the slot array and enters the
+ * symbols again */
+static void growSlots(SymTab* st)
+{
+    size_t capacity = st->slots.empty() ? INITSLOTS : 2 * st->slots.size();
+    st->slots.assign(capacity, 0);
+    unsigned mask = (unsigned) capacity - 1;
+    for(size_t k = 0; k < st->symbols.size(); k++) {
+        unsigned i = hashName(st->symbols[k].name, mask);
+        while(st->slots[i] != 0) {
+            i = (i + 1) & mask;
+        }
+        st->slots[i] = (int) k + 1;
+    }
+}
+
+Symbol* symtabInsert(SymTab* st, const char* name, int line)
+{
+    if(2 * (st->symbols.size() + 1) > st->slots.size()) {
+        growSlots(st);
+    }
+    unsigned mask = (unsigned) st->slots.size() - 1;
+    unsigned i = hashName(name, mask);
+    Symbol* s = NULL;
+    while(st->slots[i] != 0) {
+        Symbol* known = &st->symbols[st->slots[i] - 1];
+        if(known->name == name) {
+            s = known;
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    if(s == NULL) {
+        Symbol fresh = { name, (int) st->symbols.size(), -1, -1, 0, 0 };
+        st->symbols.push_back(fresh);
+        st->slots[i] = (int) st->symbols.size();
+        s = &st->symbols.back();
+    }
+    if(s->lastLine < 0 || st->lines[s->lastLine].line != line) {
+        LineRef ref = { line, -1 };
+        int k = (int) st->lines.size();
+        if(s->lastLine < 0) {
+            s->firstLine = k;
+        } else {
+            st->lines[s->lastLine].next = k;
+        }
+        s->lastLine = k;
+        st->lines.push_back(ref);
+    }
+    return s;
+}
+
+Symbol* symtabLookup(SymTab* st, const char* name)
+{
+    if(st->slots.empty()) {
+        return NULL;
+    }
+    unsigned mask = (unsigned) st->slots.size() - 1;
+    for(unsigned i = hashName(name, mask); st->slots[i] != 0; i = (i + 1) & mask) {
+        Symbol* s = &st->symbols[st->slots[i] - 1];
+        if(s->name == name) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+void printSymtab(const SymTab* st, string& s)
+{
+    char buf[32];
+    s += "Variable Name  Location   Line Numbers\n";
+    s += "-------------  --------   ------------\n";
+    for(size_t k = 0; k < st->symbols.size(); k++) {
+        const Symbol* sym = &st->symbols[k];
+        s += sym->name;
+        size_t len = strlen(sym->name);
+        s.append((len < 14) ? 15 - len : 1, ' ');
+        s.append(buf, snprintf(buf, sizeof(buf), "%-8d  ", sym->location));
+        for(int i = sym->firstLine; i >= 0; i = st->lines[i].next) {
+            s.append(buf, snprintf(buf, sizeof(buf), "%4d ", st->lines[i].line));
+        }
+        s += '\n';
+    }
+}
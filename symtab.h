@@ -0,0 +1,67 @@
+/****************************************************/
+/* File: symtab.h                                   */
+/* Symbol table interface for the TINY compiler:    */
+/* an open-addressing hash table of the variables   */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+#include "globals.h"
+#include <string>
+#include <vector>
+
+#ifndef _SYMTAB_H_
+#define _SYMTAB_H_
+
+/* A LineRef is one entry of the line list of a
+ * symbol; the lists of all symbols share one array
+ */
+typedef struct {
+    int line;
+    int next; /* index of the next entry of the list, or -1 */
+} LineRef;
+
+/* A Symbol is one variable of a program */
+typedef struct {
+    const char* name; /* interned, so compared with == */
+    int location;     /* memory location, in order of first occurrence */
+    int firstLine;    /* its first LineRef */
+    int lastLine;     /* and its last */
+    int defs;         /* occurrences that give it a value */
+    int uses;         /* occurrences that read its value */
+} Symbol;
+
+/* A SymTab keeps its memory from one program to the
+ * next, so building it again costs no allocation
+ */
+typedef struct {
+    std::vector<int> slots;      /* symbol index + 1, or 0 if empty;
+                                    linear probing, power of two */
+    std::vector<Symbol> symbols; /* by location */
+    std::vector<LineRef> lines;
+} SymTab;
+
+/* Procedure symtabInit makes an empty table */
+void symtabInit(SymTab*);
+
+/* Procedure symtabReset forgets every symbol */
+void symtabReset(SymTab*);
+
+/* Function symtabInsert adds line to the list of the
+ * interned name, unless it ends there already, first
+ * entering the name with the next memory location if
+ * it is new; the symbol returned is valid until the
+ * next insertion
+ */
+Symbol* symtabInsert(SymTab*, const char* name, int line);
+
+/* Function symtabLookup returns the symbol of an
+ * interned name, or NULL if it is not in the table
+ */
+Symbol* symtabLookup(SymTab*, const char* name);
+
+/* Procedure printSymtab appends a formatted listing
+ * of the symbol table contents
+ */
+void printSymtab(const SymTab*, std::string&);
+
+#endif
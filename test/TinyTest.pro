@@ -0,0 +1,35 @@
+TEMPLATE = app
+TARGET = TinyTest
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+INCLUDEPATH += ..
+
+HEADERS += \
+    test.h
+
+SOURCES += \
+    analyzetest.cpp \
+    exptest.cpp \
+    reparsetest.cpp \
+    runtest.cpp \
+    stmttest.cpp \
+    test.cpp \
+    ../analyze.cpp \
+    ../arena.cpp \
+    ../flat.cpp \
+    ../fold.cpp \
+    ../intern.cpp \
+    ../jit.cpp \
+    ../parse.cpp \
+    ../reparse.cpp \
+    ../scan.cpp \
+    ../scankern.cpp \
+    ../spans.cpp \
+    ../srcbuf.cpp \
+    ../stats.cpp \
+    ../symtab.cpp \
+    ../tm.cpp \
+    ../util.cpp \
+    ../vm.cpp
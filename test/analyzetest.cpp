@@ -0,0 +1,160 @@
+/****************************************************/
+/* File: analyzetest.cpp                            */
+/* Tests of type checking: programs analyze accepts */
+/* and programs it rejects                          */
+/****************************************************/
+
+#include "test.h"
+
+/* every variable is read and given a value, so only
+ * type errors are listed; the code generators must
+ * take these programs too */
+static const TestCase accepted[] = {
+    {
+        "integer and Boolean operands where each belongs",
+        "read a; read b;\n"
+        "if (a < b and not a == 0) write a else write b end;\n"
+        "x = (a + b) % 7;;\n"
+        "repeat x = x - 1 until x <= 0 or a == b;\n"
+        "write x\n",
+        ""
+    },
+    {
+        "and/or and not over comparisons in tests",
+        "read a; read b;\n"
+        "do a = a - 1 while (a > 0 or not b < a)\n",
+        ""
+    },
+    {
+        "for with integer bounds",
+        "read n;\n"
+        "for i = n downto 1 do write i * i enddo\n",
+        ""
+    }
+};
+
+/* each breaks one rule; an operand already in error
+ * is not reported again by the operators over it */
+static const TestCase rejected[] = {
+    {
+        "if over an integer",
+        "read a;\n"
+        "if (a) write 1 end\n",
+        "Type error at line 2: if test is not Boolean\n"
+    },
+    {
+        "repeat until an integer",
+        "read a;\n"
+        "repeat a = a - 1 until a\n",
+        "Type error at line 2: repeat test is not Boolean\n"
+    },
+    {
+        "do-while over an integer",
+        "read a;\n"
+        "do a = a - 1 while (a)\n",
+        "Type error at line 2: while test is not Boolean\n"
+    },
+    {
+        "assignment of a comparison",
+        "read a; read b;\n"
+        "x = a < b;;\n"
+        "write x\n",
+        "Type error at line 2: assignment of non-integer value\n"
+    },
+    {
+        "write of a comparison",
+        "read a;\n"
+        "write a == 1\n",
+        "Type error at line 2: write of non-integer value\n"
+    },
+    {
+        "sum of a comparison",
+        "read a; read b;\n"
+        "write (a < b) + 1\n",
+        "Type error at line 2: operator + applied to a non-integer\n"
+    },
+    {
+        "comparison of a comparison",
+        "read a; read b;\n"
+        "if ((a < b) < 1) write a end\n",
+        "Type error at line 2: operator < applied to a non-integer\n"
+    },
+    {
+        "and over an integer",
+        "read a; read b;\n"
+        "if (a and b < 1) write a end\n",
+        "Type error at line 2: operator and applied to a non-Boolean\n"
+    },
+    {
+        "& over an integer and a comparison",
+        "read a; read b;\n"
+        "if (a & (a < b)) write a end\n",
+        "Type error at line 2: operands of & differ in type\n"
+    },
+    {
+        "| over integers",
+        "read a; read b;\n"
+        "x = (a | b) % 7;;\n"
+        "write x\n",
+        "Type error at line 2: operator | cannot be compiled\n"
+    },
+    {
+        "| over comparisons in a test",
+        "read a; read b;\n"
+        "if ((a < b) | (b < a)) write a end\n",
+        "Type error at line 2: operator | cannot be compiled\n"
+    },
+    {
+        "| over comparisons as a value",
+        "read a; read b;\n"
+        "x = (a < b) | (b < a);;\n"
+        "write x\n",
+        "Type error at line 2: operator | cannot be compiled\n"
+        "Type error at line 2: assignment of non-integer value\n"
+    },
+    {
+        "# over an integer",
+        "read a;\n"
+        "x = a #;;\n"
+        "write x\n",
+        "Type error at line 2: operator # cannot be compiled\n"
+    },
+    {
+        "for up to a comparison",
+        "read a; read b;\n"
+        "for i = 1 to (a < b) do write i enddo\n",
+        "Type error at line 2: for bound is not an integer\n"
+    },
+    {
+        "an error listed once",
+        "read a; read b;\n"
+        "write (a & (a < b)) + 1\n",
+        "Type error at line 2: operands of & differ in type\n"
+    }
+};
+
+/* the code generators refuse & | and #, which analyze
+ * reports as errors */
+static const TestCase refused[] = {
+    {
+        "& refused",
+        "x = 3 & 1;;\n"
+        "write x\n",
+        "\n"
+        ">>> Cannot run the program: & | and # have no integer meaning\n"
+        "\n"
+        ">>> Cannot generate TM code: & | and # have no integer meaning\n"
+        "vm:\n"
+        "jit:\n"
+        "tm:\n"
+    }
+};
+
+int testAnalysis(void)
+{
+    return checkCases("accepted programs", accepted, NCASES(accepted), analyzeListing)
+           + checkCases("rejected programs", rejected, NCASES(rejected), analyzeListing)
+           + checkCases("accepted flat trees", accepted, NCASES(accepted), flatAnalyzeListing)
+           + checkCases("rejected flat trees", rejected, NCASES(rejected), flatAnalyzeListing)
+           + checkCases("refused operators", refused, NCASES(refused), runListing);
+}
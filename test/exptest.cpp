@@ -0,0 +1,115 @@
+/****************************************************/
+/* File: exptest.cpp                                */
+/* Tests of not over comparisons, as parsed and as  */
+/* folded                                           */
+/****************************************************/
+
+#include "test.h"
+
+/* a not flips the comparison under it, in parentheses
+ * or not, as the recursive descent parser did; the
+ * trees here are those that parser gave */
+static const TestCase parsed[] = {
+    {
+        "not over a comparison in parentheses",
+        "if (not (a < b)) write 1 end\n",
+        "If\n"
+        "  Op: >=\n"
+        "    Id: a\n"
+        "    Id: b\n"
+        "  Write\n"
+        "    Const: 1\n"
+    },
+    {
+        "not over both operands of and",
+        "if (not (a < b) and not (c == d)) write 1 end\n",
+        "If\n"
+        "  And\n"
+        "    Op: >=\n"
+        "      Id: a\n"
+        "      Id: b\n"
+        "    Op: <>\n"
+        "      Id: c\n"
+        "      Id: d\n"
+        "  Write\n"
+        "    Const: 1\n"
+    },
+    {
+        "not over a comparison in two parentheses",
+        "if (not ((a < b))) write 1 end\n",
+        "If\n"
+        "  Op: >=\n"
+        "    Id: a\n"
+        "    Id: b\n"
+        "  Write\n"
+        "    Const: 1\n"
+    },
+    {
+        "not over a comparison without parentheses",
+        "if (not a < b) write 1 end\n",
+        "If\n"
+        "  Op: >=\n"
+        "    Id: a\n"
+        "    Id: b\n"
+        "  Write\n"
+        "    Const: 1\n"
+    },
+    {
+        "not over a sum in parentheses",
+        "if (not (a + 1)) write 1 end\n",
+        "If\n"
+        "  Op: +\n"
+        "    Id: a\n"
+        "    Const: 1\n"
+        "  Write\n"
+        "    Const: 1\n"
+    },
+    {
+        "not over not in parentheses",
+        "if (not (not (a < b))) write 1 end\n",
+        "If\n"
+        "  Op: <\n"
+        "    Id: a\n"
+        "    Id: b\n"
+        "  Write\n"
+        "    Const: 1\n"
+    },
+    {
+        "not over a sum of a comparison",
+        "x = not (a < b) + 1;;\n"
+        "write x\n",
+        "Assign to: x\n"
+        "  Op: +\n"
+        "    Op: <\n"
+        "      Id: a\n"
+        "      Id: b\n"
+        "    Const: 1\n"
+        "Write\n"
+        "  Id: x\n"
+    }
+};
+
+/* folding sees the comparison already flipped */
+static const TestCase folded[] = {
+    {
+        "not over a constant comparison",
+        "x = not (3 < 5);;\n"
+        "write x\n",
+        "Assign to: x\n"
+        "  Const: 0\n"
+        "Write\n"
+        "  Id: x\n"
+    },
+    {
+        "if over not of a constant comparison",
+        "if (not (3 < 5)) write 1 else write 2 end\n",
+        "Write\n"
+        "  Const: 2\n"
+    }
+};
+
+int testExpressions(void)
+{
+    return checkCases("expressions", parsed, NCASES(parsed), parseListing)
+           + checkCases("folded expressions", folded, NCASES(folded), foldListing);
+}
@@ -0,0 +1,129 @@
+/****************************************************/
+/* File: reparsetest.cpp                            */
+/* Tests of incremental reparsing: each edit must   */
+/* give the listing and tree of a parse             */
+/****************************************************/
+
+#include "test.h"
+
+/* TEN and SIX_HUNDRED repeat a statement, to make
+ * documents longer than a block of tokens or spans */
+#define TEN(s) s s s s s s s s s s
+#define SIX_HUNDRED(s) TEN(TEN(s s s s s s))
+
+/* the edits between {}, applied in turn; the expected
+ * text names the edits after which the reparser fell
+ * back to parsing everything: those that make or leave
+ * a syntax error, and the first after one */
+static const TestCase cases[] = {
+    {
+        "a statement inserted after a ';' and removed",
+        "read a;\n"
+        "b = a;;\n"
+        "{|write b;\n|}"
+        "write a\n",
+        ""
+    },
+    {
+        "the end of one statement and the start of the next removed",
+        "x = 1;;\n"
+        "y = {2;;\nz = |}3;;\n"
+        "write x + y\n",
+        ""
+    },
+    {
+        "a statement split in two across a ';'",
+        "read a;\n"
+        "write a{|;\nwrite 2}\n",
+        ""
+    },
+    {
+        "an until line edited",
+        "read a;\n"
+        "repeat\n"
+        "  a = a - 1\n"
+        "until a {<|<=|==} 0;\n"
+        "write a\n",
+        ""
+    },
+    {
+        "an enddo line edited",
+        "for i = 1 to 3 do\n"
+        "  write i\n"
+        "{enddo|enddo;\nwrite i}\n",
+        ""
+    },
+    {
+        "an end line edited",
+        "read a;\n"
+        "if (a < 1)\n"
+        "  write a\n"
+        "else\n"
+        "  write 0\n"
+        "end{|;\nwrite a}\n",
+        ""
+    },
+    {
+        "a nested statement edited",
+        "read a;\n"
+        "repeat\n"
+        "  if (a < 1) a = a + {1|1 * 2|20};; write a end;\n"
+        "  write a\n"
+        "until a > 3;\n"
+        "write a\n",
+        ""
+    },
+    {
+        "a parenthesis removed and put back",
+        "read a;\n"
+        "if (a > 0{)||)} write a end;\n"
+        "write 1\n",
+        "step 1: parsed in full\n"
+        "step 2: parsed in full\n"
+    },
+    {
+        "an operator doubled and undone",
+        "read x;\n"
+        "y = x {+|+ +|+} 2;;\n"
+        "write y\n",
+        "step 1: parsed in full\n"
+        "step 2: parsed in full\n"
+    },
+    {
+        "an enddo broken and mended",
+        "for i = 1 to 3 do\n"
+        "  write i\n"
+        "end{do||do}\n",
+        "step 1: parsed in full\n"
+        "step 2: parsed in full\n"
+    },
+    {
+        "blocks of tokens inserted and removed",
+        "read a;\n"
+        "{|" SIX_HUNDRED("a = a + 1;;\n") "|}"
+        "write a\n",
+        ""
+    },
+    {
+        "an edit among blocks of tokens",
+        "read a;\n"
+        SIX_HUNDRED("a = a + 1;;\n")
+        "a = a {-|*} 2;;\n"
+        SIX_HUNDRED("a = a + 1;;\n")
+        "write a\n",
+        ""
+    },
+    {
+        "blocks of tokens removed from the front",
+        "read a;\n"
+        "{" SIX_HUNDRED("a = a + 1;;\n") "|}"
+        "write a\n",
+        ""
+    }
+};
+
+int testReparse(void)
+{
+    return checkCases("reparsed edits", cases, NCASES(cases), reparseListing)
+           + checkCases("reparsed documents", cases, NCASES(cases), reparseTextListing);
+}
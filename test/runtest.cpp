@@ -0,0 +1,123 @@
+/****************************************************/
+/* File: runtest.cpp                                */
+/* Tests of running programs on the VM and on TM    */
+/****************************************************/
+
+#include "test.h"
+
+/* loops whose instructions the interpreter runs in
+ * pairs, code whose registers the TM allocator or the
+ * JIT spills, and the errors that stop a run, each of
+ * which must write the same on every machine */
+static const TestCase runs[] = {
+    {
+        "for up and down",
+        "t = 0;;\n"
+        "for i = 1 to 4 do t = t + i enddo;\n"
+        "for j = 3 downto 1 do write t * j enddo\n",
+        "vm: 30 20 10\n"
+        "jit: 30 20 10\n"
+        "tm: 30 20 10\n"
+    },
+    {
+        "a product modulo in a loop",
+        "s = 0;;\n"
+        "for i = 1 to 6 do s = s + i * i % 5 enddo;\n"
+        "write s\n",
+        "vm: 11\n"
+        "jit: 11\n"
+        "tm: 11\n"
+    },
+    {
+        "a jump to the test after a sum",
+        "s = 0;;\n"
+        "s = s + 9;;\n"
+        "repeat\n"
+        "  if (s > 5) s = s - 2 end;\n"
+        "  write s;\n"
+        "  s = s - 1\n"
+        "until s < 3\n",
+        "vm: 7 4 3\n"
+        "jit: 7 4 3\n"
+        "tm: 7 4 3\n"
+    },
+    {
+        "a value spilled across a nested power",
+        "q = 2;;\n"
+        "write (q ^ 3) ^ 2\n",
+        "vm: 64\n"
+        "jit: 64\n"
+        "tm: 64\n"
+    },
+    {
+        "division and modulo by minus one",
+        "read a;\n"
+        "m = 0 - 2147483647 - 1;;\n"
+        "d = a - 8;;\n"
+        "write m / d; write m % d;\n"
+        "write a / d; write a % d;\n"
+        "write m / (0 - 1); write a % (0 - 1)\n",
+        "vm: -2147483648 0 -7 0 -2147483648 0\n"
+        "jit: -2147483648 0 -7 0 -2147483648 0\n"
+        "tm: -2147483648 0 -7 0 -2147483648 0\n"
+    },
+    {
+        "division by zero",
+        "read a;\n"
+        "z = a - 7;;\n"
+        "write a / 2;\n"
+        "write a / z;\n"
+        "write 1\n",
+        "vm: 3 (division by zero)\n"
+        "jit: 3 (division by zero)\n"
+        "tm: 3 (division by zero)\n"
+    },
+    {
+        "modulo by zero",
+        "read a;\n"
+        "z = a - 7;;\n"
+        "write a % 4;\n"
+        "write a % z\n",
+        "vm: 3 (division by zero)\n"
+        "jit: 3 (division by zero)\n"
+        "tm: 3 (division by zero)\n"
+    },
+    {
+        "powers inside and outside the inlined range",
+        "read a; read b;\n"
+        "write a ^ 0; write a ^ 1; write b ^ 5;\n"
+        "write 3 ^ 16; write b ^ 16;\n"
+        "write 2 ^ 17; write (0 - 1) ^ 21; write b ^ 19;\n"
+        "write a ^ (a - 9); write 2 ^ (a + 10)\n",
+        "vm: 1 7 -243 43046721 43046721 131072 -1 -1162261467 0 131072\n"
+        "jit: 1 7 -243 43046721 43046721 131072 -1 -1162261467 0 131072\n"
+        "tm: 1 7 -243 43046721 43046721 131072 -1 -1162261467 0 131072\n"
+    },
+    {
+        "a read past the end of the input",
+        "read a; write a;\n"
+        "read b; write b;\n"
+        "read c; write c\n",
+        "vm: 7 -3 (no input)\n"
+        "jit: 7 -3 (no input)\n"
+        "tm: 7 -3 (no input)\n"
+    },
+    {
+        "more live variables than registers",
+        "read a; read b;\n"
+        "c = a + b;; d = a - b;; e = a * b;;\n"
+        "f = c * d;; g = e + 1;; h = 0;;\n"
+        "for i = 1 to 3 do\n"
+        "  h = h + a + b + c + d + e + f + g + i\n"
+        "enddo;\n"
+        "write h; write a; write b; write c; write d; write e; write f; write g\n",
+        "vm: 57 7 -3 4 10 -21 40 -20\n"
+        "jit: 57 7 -3 4 10 -21 40 -20\n"
+        "tm: 57 7 -3 4 10 -21 40 -20\n"
+    }
+};
+
+int testRuns(void)
+{
+    return checkCases("runs", runs, NCASES(runs), runListing);
+}
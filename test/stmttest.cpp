@@ -0,0 +1,181 @@
+/****************************************************/
+/* File: stmttest.cpp                               */
+/* Tests of statement sequences and of the ';'      */
+/* that may end the body of a do-while              */
+/****************************************************/
+
+#include <stdio.h>
+#include "globals.h"
+#include "test.h"
+
+using namespace std;
+
+/* a do-while is do stmt-sequence [;] while (exp): the
+ * sequence stops at a while after a ';', which then
+ * ends the body, and a while needs a do to close; a
+ * closer that closes nothing is skipped, and the
+ * statements on both sides of it are kept */
+static const TestCase cases[] = {
+    {
+        "do-while with ';' before while",
+        "do x = x + 1;; write x; while (x < 3)\n",
+        "Do\n"
+        "  Assign to: x\n"
+        "    Op: +\n"
+        "      Id: x\n"
+        "      Const: 1\n"
+        "  Write\n"
+        "    Id: x\n"
+        "  Op: <\n"
+        "    Id: x\n"
+        "    Const: 3\n"
+    },
+    {
+        "do-while without ';' before while",
+        "do write x while (x < 3)\n",
+        "Do\n"
+        "  Write\n"
+        "    Id: x\n"
+        "  Op: <\n"
+        "    Id: x\n"
+        "    Const: 3\n"
+    },
+    {
+        "do-while whose body ends in an assignment",
+        "do x = x + 1;; while (x < 3)\n",
+        "Do\n"
+        "  Assign to: x\n"
+        "    Op: +\n"
+        "      Id: x\n"
+        "      Const: 1\n"
+        "  Op: <\n"
+        "    Id: x\n"
+        "    Const: 3\n"
+    },
+    {
+        "do-while followed by statements",
+        "do write x; while (x < 3); write 1\n",
+        "Do\n"
+        "  Write\n"
+        "    Id: x\n"
+        "  Op: <\n"
+        "    Id: x\n"
+        "    Const: 3\n"
+        "Write\n"
+        "  Const: 1\n"
+    },
+    {
+        "do-while nested in repeat",
+        "repeat do read x; while (x > 0) until x == 0\n",
+        "Repeat\n"
+        "  Do\n"
+        "    Read: x\n"
+        "    Op: >\n"
+        "      Id: x\n"
+        "      Const: 0\n"
+        "  Op: ==\n"
+        "    Id: x\n"
+        "    Const: 0\n"
+    },
+    {
+        "two ';' before while",
+        "do write x;; while (x < 3)\n",
+        "\n"
+        ">>> Syntax error at line 1: unexpected token -> ;\n"
+        "Do\n"
+        "  Write\n"
+        "    Id: x\n"
+        "  Op: <\n"
+        "    Id: x\n"
+        "    Const: 3\n"
+    },
+    {
+        "while without do",
+        "write 1; while (x < 3)\n",
+        "\n"
+        ">>> Syntax error at line 1: unexpected token -> reserved word: while\n"
+        "Write\n"
+        "  Const: 1\n"
+    },
+    {
+        "statements after a stray end are all kept",
+        "x = 1;; y = 2;; end z = 3;;\n"
+        "write z\n",
+        "\n"
+        ">>> Syntax error at line 1: unexpected token -> reserved word: end\n"
+        "Assign to: x\n"
+        "  Const: 1\n"
+        "Assign to: y\n"
+        "  Const: 2\n"
+        "Assign to: z\n"
+        "  Const: 3\n"
+        "Write\n"
+        "  Id: z\n"
+    },
+    {
+        "statements after two stray closers are all kept",
+        "x = 1;; y = 2;; end z = 3;; w = 4;; else write z\n",
+        "\n"
+        ">>> Syntax error at line 1: unexpected token -> reserved word: end\n"
+        "\n"
+        ">>> Syntax error at line 1: unexpected token -> reserved word: else\n"
+        "Assign to: x\n"
+        "  Const: 1\n"
+        "Assign to: y\n"
+        "  Const: 2\n"
+        "Assign to: z\n"
+        "  Const: 3\n"
+        "Assign to: w\n"
+        "  Const: 4\n"
+        "Write\n"
+        "  Id: z\n"
+    }
+};
+
+/* nestedIfs is depth if statements, each in the last */
+static string nestedIfs(int depth)
+{
+    string s;
+    for(int i = 0; i < depth; i++) {
+        s += "if (1 < 2) ";
+    }
+    s += "write 1";
+    for(int i = 0; i < depth; i++) {
+        s += " end";
+    }
+    return s + "\n";
+}
+
+/* checkNesting parses ifs nested one deeper than
+   MAXNESTING with limits of 0 and far above it, which
+   must both stop at MAXNESTING rather than recurse on,
+   and ifs that reach MAXNESTING with the test and the
+   write of the innermost one, which must parse */
+static int checkNesting(void)
+{
+    string deep = nestedIfs(MAXNESTING + 1);
+    char expected[64];
+    snprintf(expected, sizeof(expected),
+             "\n>>> Syntax error at line 1: nested deeper than %d\n", MAXNESTING);
+    const int limits[] = {0, 1 << 20};
+    int failed = 0;
+    for(int i = 0; i < 2; i++) {
+        string got = errorListing(deep.c_str(), limits[i]);
+        if(got != expected) {
+            fprintf(stderr, "nesting: limit %d failed\n--- expected\n%s--- got\n%s---\n",
+                    limits[i], expected, got.c_str());
+            failed++;
+        }
+    }
+    if(errorListing(nestedIfs(MAXNESTING - 2).c_str(), 0) != "") {
+        fprintf(stderr, "nesting: %d deep failed\n", MAXNESTING - 2);
+        failed++;
+    }
+    printf("nesting: %d of 3 passed\n", 3 - failed);
+    return failed;
+}
+
+int testStatements(void)
+{
+    return checkCases("statements", cases, NCASES(cases), parseListing) + checkNesting();
+}
@@ -0,0 +1,422 @@
+/****************************************************/
+/* File: test.cpp                                   */
+/* Main program of the TinyTest target: runs the    */
+/* suites named on the command line, or all         */
+/****************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "globals.h"
+#include "util.h"
+#include "parse.h"
+#include "fold.h"
+#include "flat.h"
+#include "analyze.h"
+#include "vm.h"
+#include "tm.h"
+#include "jit.h"
+#include "reparse.h"
+#include "test.h"
+
+using namespace std;
+
+/* readListing returns what was written to fp */
+static string readListing(FILE* fp)
+{
+    string s;
+    char buf[4096];
+    size_t n;
+    rewind(fp);
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        s.append(buf, n);
+    }
+    return s;
+}
+
+/* listing parses source, folds the tree if asked, and
+   returns the syntax errors listed, then the tree */
+static string listing(const char* source, bool fold)
+{
+    ParseContext ctx;
+    initContext(&ctx);
+    ctx.listing = tmpfile();
+    if(ctx.listing == NULL) {
+        freeContext(&ctx);
+        return "no temporary file for the listing\n";
+    }
+    TreeNode* tree = parseBuffer(&ctx, source, strlen(source));
+    if(fold) {
+        tree = foldTree(tree, NULL);
+    }
+    string s = readListing(ctx.listing);
+    printTree(tree, s, 0);
+    fclose(ctx.listing);
+    freeContext(&ctx);
+    return s;
+}
+
+string parseListing(const char* source)
+{
+    return listing(source, false);
+}
+
+string errorListing(const char* source, int maxNesting)
+{
+    ParseContext ctx;
+    initContext(&ctx);
+    ctx.maxNesting = maxNesting;
+    ctx.listing = tmpfile();
+    if(ctx.listing == NULL) {
+        freeContext(&ctx);
+        return "no temporary file for the listing\n";
+    }
+    parseBuffer(&ctx, source, strlen(source));
+    string s = readListing(ctx.listing);
+    fclose(ctx.listing);
+    freeContext(&ctx);
+    return s;
+}
+
+string foldListing(const char* source)
+{
+    return listing(source, true);
+}
+
+string analyzeListing(const char* source)
+{
+    ParseContext ctx;
+    initContext(&ctx);
+    ctx.listing = tmpfile();
+    if(ctx.listing == NULL) {
+        freeContext(&ctx);
+        return "no temporary file for the listing\n";
+    }
+    TreeNode* tree = parseBuffer(&ctx, source, strlen(source));
+    string s = readListing(ctx.listing);
+    SymTab st;
+    symtabInit(&st);
+    if(analyze(&ctx, tree, &st, s) == 0 && !ctx.Error) {
+        /* what analyze accepts the code generators must */
+        FILE* refusals = tmpfile();
+        if(refusals != NULL) {
+            Bytecode bc;
+            TmProgram prog;
+            compileTree(&bc, tree, refusals);
+            genTm(&prog, tree, TM_ALLOCATE | TM_PEEPHOLE, refusals);
+            s += readListing(refusals);
+            fclose(refusals);
+        }
+    }
+    fclose(ctx.listing);
+    freeContext(&ctx);
+    return s;
+}
+
+string flatAnalyzeListing(const char* source)
+{
+    ParseContext ctx;
+    initContext(&ctx);
+    ctx.listing = tmpfile();
+    if(ctx.listing == NULL) {
+        freeContext(&ctx);
+        return "no temporary file for the listing\n";
+    }
+    TreeNode* tree = parseBuffer(&ctx, source, strlen(source));
+    string s = readListing(ctx.listing);
+    FlatTree flat;
+    initFlatTree(&flat);
+    SymTab st;
+    symtabInit(&st);
+    if(flattenTree(&flat, tree, &ctx)) {
+        analyzeFlat(&flat, &st, s);
+    } else {
+        s += "out of memory\n";
+    }
+    freeFlatTree(&flat);
+    fclose(ctx.listing);
+    freeContext(&ctx);
+    return s;
+}
+
+/* A Marker is an edit of a reparse case: the texts
+ * that take turns at one place of the document */
+typedef struct {
+    size_t at; /* in the text around the markers */
+    vector<string> turns;
+} Marker;
+
+/* splitEdits takes the markers out of source, leaving
+ * the text around them in plain */
+static vector<Marker> splitEdits(const char* source, string& plain)
+{
+    vector<Marker> markers;
+    for(const char* p = source; *p != '\0'; p++) {
+        if(*p != '{') {
+            plain += *p;
+            continue;
+        }
+        Marker m;
+        m.at = plain.size();
+        m.turns.push_back("");
+        for(p++; *p != '}' && *p != '\0'; p++) {
+            if(*p == '|') {
+                m.turns.push_back("");
+            } else {
+                m.turns.back() += *p;
+            }
+        }
+        markers.push_back(m);
+        if(*p == '\0') {
+            break;
+        }
+    }
+    return markers;
+}
+
+/* document returns plain with the text of each marker
+ * at its turn */
+static string document(const string& plain, const vector<Marker>& markers,
+                       const vector<size_t>& turn)
+{
+    string s;
+    size_t from = 0;
+    for(size_t m = 0; m < markers.size(); m++) {
+        s.append(plain, from, markers[m].at - from);
+        s += markers[m].turns[turn[m]];
+        from = markers[m].at;
+    }
+    s.append(plain, from, string::npos);
+    return s;
+}
+
+/* treeListing returns the syntax errors listed by the
+ * parse that made tree, then the tree and, if it has
+ * no errors, what analyze finds in it and the symbol
+ * table, whose line lists come from the tokens of the
+ * nodes */
+static string treeListing(FILE* fp, const ParseContext* ctx, TreeNode* tree)
+{
+    string s = readListing(fp);
+    printTree(tree, s, 0);
+    if(!ctx->Error) {
+        SymTab st;
+        symtabInit(&st);
+        analyze(ctx, tree, &st, s);
+        printSymtab(&st, s);
+    }
+    return s;
+}
+
+/* reparse runs a reparse case, by reparseText if whole
+ * or else by reparseEdit */
+static string reparse(const char* source, bool whole)
+{
+    string plain;
+    vector<Marker> markers = splitEdits(source, plain);
+    vector<size_t> turn(markers.size(), 0);
+    string text = document(plain, markers, turn);
+    Reparser rp;
+    initReparser(&rp);
+    rp.ctx.listing = tmpfile();
+    if(rp.ctx.listing == NULL) {
+        freeReparser(&rp);
+        return "no temporary file for the listing\n";
+    }
+    reparseAll(&rp, text.data(), text.size());
+    fclose(rp.ctx.listing);
+    string s;
+    int step = 0;
+    for(size_t m = 0; m < markers.size(); m++) {
+        size_t offset = markers[m].at;
+        for(size_t k = 0; k < m; k++) {
+            offset += markers[k].turns[turn[k]].size();
+        }
+        while(turn[m] + 1 < markers[m].turns.size()) {
+            const string& removed = markers[m].turns[turn[m]];
+            const string& inserted = markers[m].turns[++turn[m]];
+            text = document(plain, markers, turn);
+            step++;
+            rp.ctx.listing = tmpfile();
+            ParseContext ctx;
+            initContext(&ctx);
+            ctx.listing = tmpfile();
+            if(rp.ctx.listing == NULL || ctx.listing == NULL) {
+                s += "no temporary file for the listing\n";
+                break;
+            }
+            if(whole) {
+                reparseText(&rp, text.data(), text.size());
+            } else {
+                reparseEdit(&rp, offset, removed.size(), inserted.data(), inserted.size());
+            }
+            string got = treeListing(rp.ctx.listing, &rp.ctx, rp.tree);
+            string expected = treeListing(ctx.listing, &ctx, parseBuffer(&ctx, text.data(),
+                                          text.size()));
+            char buf[64];
+            if(rp.full) {
+                s.append(buf, snprintf(buf, sizeof(buf), "step %d: parsed in full\n", step));
+            }
+            if(got != expected || rp.ctx.Error != ctx.Error) {
+                s.append(buf, snprintf(buf, sizeof(buf), "step %d: differs from a parse\n", step));
+                s += "--- reparsed\n" + got + "--- parsed\n" + expected;
+            }
+            fclose(rp.ctx.listing);
+            fclose(ctx.listing);
+            freeContext(&ctx);
+        }
+    }
+    rp.ctx.listing = stdout;
+    freeReparser(&rp);
+    return s;
+}
+
+string reparseListing(const char* source)
+{
+    return reparse(source, false);
+}
+
+string reparseTextListing(const char* source)
+{
+    return reparse(source, true);
+}
+
+/* A Run is the input and output of one machine */
+typedef struct {
+    int read;   /* numbers of runInput read so far */
+    string out; /* the machine's name, then what it wrote */
+} Run;
+
+/* the input of every run */
+static const int runInput[] = { 7, -3 };
+
+static int readInput(VmIO* io, int* value)
+{
+    Run* r = (Run*) io->data;
+    if(r->read == (int) (sizeof(runInput) / sizeof(runInput[0]))) {
+        return FALSE;
+    }
+    *value = runInput[r->read++];
+    return TRUE;
+}
+
+/* writeOutput appends a written value to the output
+   of the run io->data points to */
+static void writeOutput(VmIO* io, int value)
+{
+    Run* r = (Run*) io->data;
+    r->out += ' ';
+    r->out += to_string(value);
+}
+
+/* startRun readies io for a machine of the given name */
+static void startRun(VmIO* io, Run* r, const char* name)
+{
+    r->read = 0;
+    r->out = name;
+    io->read = readInput;
+    io->write = writeOutput;
+    io->data = r;
+}
+
+/* endRun returns the output of a run that ended with
+   outcome */
+static string endRun(const Run* r, int outcome)
+{
+    switch(outcome) {
+        case VM_OK:
+            return r->out + "\n";
+        case VM_DIVZERO:
+            return r->out + " (division by zero)\n";
+        case VM_NOINPUT:
+            return r->out + " (no input)\n";
+        default:
+            return r->out + " (bad address)\n";
+    }
+}
+
+string runListing(const char* source)
+{
+    ParseContext ctx;
+    initContext(&ctx);
+    ctx.listing = tmpfile();
+    if(ctx.listing == NULL) {
+        freeContext(&ctx);
+        return "no temporary file for the listing\n";
+    }
+    TreeNode* tree = parseBuffer(&ctx, source, strlen(source));
+    Bytecode bc;
+    JitCode jit;
+    initJit(&jit);
+    TmProgram prog;
+    Run vm, native, tm;
+    VmIO io;
+    int vmOutcome = VM_OK, jitOutcome = VM_OK, tmOutcome = VM_OK;
+    startRun(&io, &vm, "vm:");
+    startRun(&io, &native, "jit:");
+    startRun(&io, &tm, "tm:");
+    if(!ctx.Error && compileTree(&bc, tree, ctx.listing)) {
+        startRun(&io, &vm, "vm:");
+        vmOutcome = runBytecode(&bc, &io);
+        jitCompile(&jit, &bc);
+        startRun(&io, &native, "jit:");
+        jitOutcome = runJit(&jit, &bc, &io);
+    }
+    if(!ctx.Error && genTm(&prog, tree, TM_ALLOCATE | TM_PEEPHOLE, ctx.listing)) {
+        long long steps = 0;
+        startRun(&io, &tm, "tm:");
+        tmOutcome = runTm(&prog, &io, &steps);
+    }
+    string s = readListing(ctx.listing);
+    s += endRun(&vm, vmOutcome) + endRun(&native, jitOutcome) + endRun(&tm, tmOutcome);
+    freeJit(&jit);
+    fclose(ctx.listing);
+    freeContext(&ctx);
+    return s;
+}
+
+int checkCases(const char* suite, const TestCase* cases, int count,
+               string (*run)(const char*))
+{
+    int failed = 0;
+    for(int i = 0; i < count; i++) {
+        string got = run(cases[i].source);
+        if(got != cases[i].expected) {
+            fprintf(stderr, "%s: %s failed\n--- source\n%s--- expected\n%s--- got\n%s---\n",
+                    suite, cases[i].name, cases[i].source, cases[i].expected, got.c_str());
+            failed++;
+        }
+    }
+    printf("%s: %d of %d passed\n", suite, count - failed, count);
+    return failed;
+}
+
+static struct {
+    const char* name;
+    int (*run)(void);
+} suites[] = {
+    {"statements", testStatements},
+    {"expressions", testExpressions},
+    {"analysis", testAnalysis},
+    {"reparse", testReparse},
+    {"runs", testRuns}
+};
+
+#define NSUITES ((int) (sizeof(suites) / sizeof(suites[0])))
+
+int main(int argc, char* argv[])
+{
+    int status = 0;
+    for(int i = 0; i < NSUITES; i++) {
+        bool wanted = (argc == 1);
+        for(int j = 1; j < argc; j++) {
+            if(strcmp(argv[j], suites[i].name) == 0) {
+                wanted = true;
+            }
+        }
+        if(wanted && suites[i].run() != 0) {
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,95 @@
+/****************************************************/
+/* File: test.h                                     */
+/* Regression tests of the TinyTest target; each    */
+/* suite lists its failures on stderr               */
+/****************************************************/
+#include <string>
+
+#ifndef _TEST_H_
+#define _TEST_H_
+
+/* A TestCase is a program and the text it must give */
+typedef struct {
+    const char* name;
+    const char* source;
+    const char* expected;
+} TestCase;
+
+/* function parseListing parses source and returns the
+ * syntax errors listed, then the printed tree
+ */
+std::string parseListing(const char* source);
+
+/* function errorListing parses source with the
+ * nesting limit maxNesting and returns the syntax
+ * errors listed, without the tree
+ */
+std::string errorListing(const char* source, int maxNesting);
+
+/* function foldListing is parseListing with the tree
+ * folded by foldTree before it is printed
+ */
+std::string foldListing(const char* source);
+
+/* function analyzeListing parses source and returns
+ * the syntax errors listed, then the type errors and
+ * warnings of analyze; for a program without type
+ * errors, then what compileTree and genTm refuse
+ */
+std::string analyzeListing(const char* source);
+
+/* function flatAnalyzeListing is analyzeListing with
+ * the tree flattened, its lines kept, and analyzed by
+ * analyzeFlat, without the code generators
+ */
+std::string flatAnalyzeListing(const char* source);
+
+/* function reparseListing parses a document with
+ * edits marked in it as {a|b|c}: the text a, then b
+ * and then c. The document is parsed with the first
+ * text of each marker, and then reparsed by
+ * reparseEdit after each edit, marker by marker. It
+ * returns, for each edit, whether the reparser parsed
+ * the whole document, and any difference of its
+ * listing, tree or type errors from a parse
+ */
+std::string reparseListing(const char* source);
+
+/* function reparseTextListing is reparseListing with
+ * each edited document given whole to reparseText
+ */
+std::string reparseTextListing(const char* source);
+
+/* function runListing compiles source for the VM, as
+ * native code and for TM, runs each with the input 7
+ * and -3 and returns the messages listed, then the
+ * values each wrote and the error that stopped it,
+ * if any
+ */
+std::string runListing(const char* source);
+
+/* function checkCases runs every case through run,
+ * lists each whose text differs from the expected one
+ * and returns how many did
+ */
+int checkCases(const char* suite, const TestCase* cases, int count,
+               std::string (*run)(const char*));
+
+#define NCASES(cases) ((int) (sizeof(cases) / sizeof(cases[0])))
+
+/* statement sequences and the do-while statement */
+int testStatements(void);
+
+/* not over comparisons, and what folding makes of it */
+int testExpressions(void);
+
+/* programs that type check, and programs that do not */
+int testAnalysis(void);
+
+/* edits reparsed incrementally */
+int testReparse(void);
+
+/* programs run on the VM and on TM */
+int testRuns(void);
+
+#endif
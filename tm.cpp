@@ -0,0 +1,1004 @@
+/****************************************************/
+/* File: tm.cpp                                     */
+/* TM code generation: code for virtual registers,  */
+/* linear-scan allocation, a peephole pass, and the */
+/* simulator                                        */
+/****************************************************/
+
+#include <algorithm>
+#include "globals.h"
+#include "util.h"
+#include "vm.h"
+#include "tm.h"
+
+using namespace std;
+
+static const char* opNames[TMOPS] = {
+    "HALT", "IN", "OUT", "ADD", "SUB", "MUL", "DIV",
+    "LD", "ST", "LDA", "LDC", "JLT", "JLE", "JGT", "JGE", "JEQ", "JNE"
+};
+
+/* isRO tells whether op takes three registers */
+static int isRO(int op)
+{
+    return op <= TmDiv;
+}
+
+/* code is first generated for as many virtual
+ * registers as it needs, numbered from VREG, with
+ * labels as pseudo-instructions; allocation then maps
+ * them to the registers of TM
+ */
+#define VREG TM_REGS
+#define LABEL TMOPS   /* pseudo-opcode: iarg1 is the label */
+#define DELETED (-1)  /* opcode of a removed instruction */
+
+/* An Ir is an instruction that may jump to a label */
+typedef struct {
+    TmInstr in;
+    int label;  /* target of the jump, or -1 */
+} Ir;
+
+/* registers for temporaries when none is spilled, and
+ * when some are, which leaves 0 and 1 to reload them */
+static const int allRegs[] = { 0, 1, 2, 3, 4 };
+static const int spillRegs[] = { 2, 3, 4 };
+
+#define SCRATCH0 0
+#define SCRATCH1 1
+
+/****************************************/
+/* code for virtual registers           */
+/****************************************/
+
+/* A Gen is the state of one genTm */
+typedef struct {
+    vector<Ir> ir;
+    vector<int> locOf; /* location of each name id, or -1 */
+    TmProgram* prog;
+    int vregs;
+    int labels;
+    FILE* listing;
+    int error;
+} Gen;
+
+static void genError(Gen* g, const char* message)
+{
+    if(!g->error) {
+        fprintf(g->listing, "\n>>> Cannot generate TM code: %s\n", message);
+    }
+    g->error = TRUE;
+}
+
+static void emit(Gen* g, int op, int a, int b, int c)
+{
+    Ir x = { { op, a, b, c }, -1 };
+    g->ir.push_back(x);
+}
+
+/* emitJump emits op r to label; op TmLda with r the
+ * pc jumps always */
+static void emitJump(Gen* g, int op, int r, int label)
+{
+    Ir x = { { op, r, 0, TM_PC }, label };
+    g->ir.push_back(x);
+}
+
+static int newLabel(Gen* g)
+{
+    return g->labels++;
+}
+
+static void place(Gen* g, int label)
+{
+    emit(g, LABEL, label, 0, 0);
+}
+
+static int newReg(Gen* g)
+{
+    return VREG + g->vregs++;
+}
+
+/* location returns the data address of a variable */
+static int location(Gen* g, const char* name)
+{
+    int id = internId(name);
+    if(id >= (int) g->locOf.size()) {
+        g->locOf.resize(id + 1, -1);
+    }
+    if(g->locOf[id] < 0) {
+        g->locOf[id] = (int) g->prog->names.size();
+        g->prog->names.push_back(name);
+    }
+    return g->locOf[id];
+}
+
+static int isRelop(TokenType op)
+{
+    return op == LT || op == LTE || op == GT || op == GTE || op == EQ || op == NE;
+}
+
+/* relJump returns the jump, on a - b, taken when
+ * a op b is when, TRUE or FALSE */
+static int relJump(TokenType op, int when)
+{
+    switch(op) {
+        case LT:
+            return when ? TmJlt : TmJge;
+        case LTE:
+            return when ? TmJle : TmJgt;
+        case GT:
+            return when ? TmJgt : TmJle;
+        case GTE:
+            return when ? TmJge : TmJlt;
+        case EQ:
+            return when ? TmJeq : TmJne;
+        default:
+            return when ? TmJne : TmJeq;
+    }
+}
+
+static int expr(Gen* g, TreeNode* t);
+static void branch(Gen* g, TreeNode* t, int when, int label);
+
+/* isOdd emits o = n % 2 for the loops of power */
+static int isOdd(Gen* g, int n, int two, int* half)
+{
+    int h = newReg(g);
+    int o = newReg(g);
+    emit(g, TmDiv, h, n, two);
+    emit(g, TmMul, o, h, two);
+    emit(g, TmSub, o, n, o);
+    *half = h;
+    return o;
+}
+
+/* power emits a ^ b as the VM computes it: by
+ * squaring, and for a negative b 0 unless a is 1 or -1
+ */
+static int power(Gen* g, int a, int b)
+{
+    int r = newReg(g);
+    int x = newReg(g);
+    int n = newReg(g);
+    int two = newReg(g);
+    int one = newReg(g);
+    int h;
+    int loop = newLabel(g);
+    int minusOne = newLabel(g);
+    int skip = newLabel(g);
+    int end = newLabel(g);
+    emit(g, TmLdc, r, 1, 0);
+    emit(g, TmLda, x, 0, a);
+    emit(g, TmLda, n, 0, b);
+    emit(g, TmLdc, two, 2, 0);
+    emitJump(g, TmJge, n, loop);
+    emit(g, TmLda, one, -1, x);
+    emitJump(g, TmJeq, one, end);
+    emit(g, TmLda, one, 1, x);
+    emitJump(g, TmJeq, one, minusOne);
+    emit(g, TmLdc, r, 0, 0);
+    emitJump(g, TmLda, TM_PC, end);
+    place(g, minusOne);
+    emitJump(g, TmJeq, isOdd(g, n, two, &h), end);
+    emit(g, TmLdc, r, -1, 0);
+    emitJump(g, TmLda, TM_PC, end);
+    place(g, loop);
+    emitJump(g, TmJeq, n, end);
+    emitJump(g, TmJeq, isOdd(g, n, two, &h), skip);
+    emit(g, TmMul, r, r, x);
+    place(g, skip);
+    emit(g, TmMul, x, x, x);
+    emit(g, TmLda, n, 0, h);
+    emitJump(g, TmLda, TM_PC, loop);
+    place(g, end);
+    return r;
+}
+
+/* expr generates code for the value of t and returns
+ * the virtual register that holds it */
+static int expr(Gen* g, TreeNode* t)
+{
+    int r = newReg(g);
+    if(t == NULL) {
+        genError(g, "the tree is incomplete");
+    } else if(t->nodekind == StmtK) { /* And or Or */
+        int no = newLabel(g);
+        int done = newLabel(g);
+        branch(g, t, FALSE, no);
+        emit(g, TmLdc, r, 1, 0);
+        emitJump(g, TmLda, TM_PC, done);
+        place(g, no);
+        emit(g, TmLdc, r, 0, 0);
+        place(g, done);
+    } else if(t->kind.exp == IdK) {
+        emit(g, TmLd, r, location(g, t->attr.name), TM_GP);
+    } else if(t->kind.exp == ConstK) {
+        emit(g, TmLdc, r, t->attr.val, 0);
+    } else if(t->kind.exp == OpK) {
+        int a = expr(g, t->child[0]);
+        int b = expr(g, t->child[1]);
+        switch(t->attr.op) {
+            case PLUS:
+                emit(g, TmAdd, r, a, b);
+                break;
+            case MINUS:
+                emit(g, TmSub, r, a, b);
+                break;
+            case TIMES:
+                emit(g, TmMul, r, a, b);
+                break;
+            case OVER:
+                emit(g, TmDiv, r, a, b);
+                break;
+            case MOD: { /* a - a / b * b */
+                int q = newReg(g);
+                emit(g, TmDiv, q, a, b);
+                emit(g, TmMul, q, q, b);
+                emit(g, TmSub, r, a, q);
+                break;
+            }
+            case POWER:
+                r = power(g, a, b);
+                break;
+            default: { /* a comparison as 0 or 1 */
+                int d = newReg(g);
+                int skip = newLabel(g);
+                emit(g, TmSub, d, a, b);
+                emit(g, TmLdc, r, 1, 0);
+                emitJump(g, relJump(t->attr.op, TRUE), d, skip);
+                emit(g, TmLdc, r, 0, 0);
+                place(g, skip);
+                break;
+            }
+        }
+    } else {
+        genError(g, "& | and # have no integer meaning");
+    }
+    return r;
+}
+
+/* branch generates code that goes to label when the
+ * truth of t is when, and falls through otherwise */
+static void branch(Gen* g, TreeNode* t, int when, int label)
+{
+    if(t != NULL && t->nodekind == StmtK && (t->kind.stmt == AndK || t->kind.stmt == OrK)) {
+        /* and jumps at once when false, or when true */
+        int early = (t->kind.stmt == OrK);
+        if(when == early) {
+            branch(g, t->child[0], when, label);
+            branch(g, t->child[1], when, label);
+        } else {
+            int fall = newLabel(g);
+            branch(g, t->child[0], early, fall);
+            branch(g, t->child[1], when, label);
+            place(g, fall);
+        }
+    } else if(t != NULL && t->nodekind == ExpK && t->kind.exp == OpK && isRelop(t->attr.op)) {
+        int a = expr(g, t->child[0]);
+        int b = expr(g, t->child[1]);
+        int d = newReg(g);
+        emit(g, TmSub, d, a, b);
+        emitJump(g, relJump(t->attr.op, when), d, label);
+    } else {
+        emitJump(g, when ? TmJne : TmJeq, expr(g, t), label);
+    }
+}
+
+static void statements(Gen* g, TreeNode* t);
+
+/* forLoop evaluates the limit, then the start value,
+ * and runs the body while the variable has not passed
+ * the limit, stepping by 1 or -1 */
+static void forLoop(Gen* g, TreeNode* t)
+{
+    TreeNode* start = t->child[0];
+    TreeNode* limit = t->child[1];
+    if(start == NULL || limit == NULL) {
+        genError(g, "the tree is incomplete");
+        return;
+    }
+    int up = (limit->kind.stmt == ToK);
+    int bound = expr(g, limit->child[0]);
+    int v = expr(g, start->child[0]);
+    int loc = location(g, start->attr.name);
+    int d = newReg(g);
+    int top = newLabel(g);
+    int exit = newLabel(g);
+    emit(g, TmSt, v, loc, TM_GP);
+    emit(g, TmSub, d, v, bound);
+    emitJump(g, up ? TmJgt : TmJlt, d, exit);
+    place(g, top);
+    statements(g, t->child[2]);
+    v = newReg(g);
+    d = newReg(g);
+    emit(g, TmLd, v, loc, TM_GP);
+    emit(g, TmLda, v, up ? 1 : -1, v);
+    emit(g, TmSt, v, loc, TM_GP);
+    emit(g, TmSub, d, v, bound);
+    emitJump(g, up ? TmJle : TmJge, d, top);
+    place(g, exit);
+}
+
+static void statements(Gen* g, TreeNode* t)
+{
+    for(; t != NULL && !g->error; t = t->sibling) {
+        switch(t->kind.stmt) {
+            case AssignK: {
+                int v = expr(g, t->child[0]);
+                emit(g, TmSt, v, location(g, t->attr.name), TM_GP);
+                break;
+            }
+            case ReadK: {
+                int v = newReg(g);
+                emit(g, TmIn, v, 0, 0);
+                emit(g, TmSt, v, location(g, t->attr.name), TM_GP);
+                break;
+            }
+            case WriteK:
+                emit(g, TmOut, expr(g, t->child[0]), 0, 0);
+                break;
+            case IfK: {
+                int no = newLabel(g);
+                branch(g, t->child[0], FALSE, no);
+                statements(g, t->child[1]);
+                if(t->child[2] != NULL) {
+                    int end = newLabel(g);
+                    emitJump(g, TmLda, TM_PC, end);
+                    place(g, no);
+                    statements(g, t->child[2]);
+                    place(g, end);
+                } else {
+                    place(g, no);
+                }
+                break;
+            }
+            case RepeatK:
+            case DoWhileK: {
+                int top = newLabel(g);
+                place(g, top);
+                statements(g, t->child[0]);
+                branch(g, t->child[1], t->kind.stmt == DoWhileK, top);
+                break;
+            }
+            case ForK:
+                forLoop(g, t);
+                break;
+            default:
+                genError(g, "the tree is incomplete");
+                break;
+        }
+    }
+}
+
+/****************************************/
+/* linear-scan allocation               */
+/****************************************/
+
+/* regFields tells which fields of x hold registers,
+ * as bits 1 << field */
+static int regFields(const Ir* x)
+{
+    int op = x->in.iop;
+    if(op == LABEL || op == DELETED) {
+        return 0;
+    }
+    return isRO(op) ? 14 : 10;
+}
+
+static int* field(Ir* x, int k)
+{
+    return (k == 1) ? &x->in.iarg1 : (k == 2) ? &x->in.iarg2 : &x->in.iarg3;
+}
+
+/* defines tells whether x writes its first register */
+static int defines(const Ir* x)
+{
+    int op = x->in.iop;
+    return op != TmHalt && op != TmOut && op != TmSt && op < TmJlt;
+}
+
+/* A Lifetime is the interval from the first to the last
+ * instruction that names a virtual register */
+typedef struct {
+    int start;
+    int end;
+} Lifetime;
+
+/* lifetimes finds the interval of every virtual
+ * register; a register live where a loop starts is
+ * kept to the jump back, as it is needed there again */
+static void lifetimes(vector<Ir>& ir, int vregs, int labels, vector<Lifetime>& life)
+{
+    life.assign(vregs, Lifetime());
+    for(int v = 0; v < vregs; v++) {
+        life[v].start = -1;
+        life[v].end = -1;
+    }
+    vector<int> labelAt(labels, 0);
+    for(int k = 0; k < (int) ir.size(); k++) {
+        if(ir[k].in.iop == LABEL) {
+            labelAt[ir[k].in.iarg1] = k;
+        }
+    }
+    for(int k = 0; k < (int) ir.size(); k++) {
+        int fields = regFields(&ir[k]);
+        for(int f = 1; f <= 3; f++) {
+            int r = *field(&ir[k], f);
+            if((fields & (1 << f)) && r >= VREG) {
+                if(life[r - VREG].start < 0) {
+                    life[r - VREG].start = k;
+                }
+                life[r - VREG].end = k;
+            }
+        }
+    }
+    vector<pair<int, int> > loops; /* head, jump back */
+    for(int k = 0; k < (int) ir.size(); k++) {
+        if(ir[k].label >= 0 && labelAt[ir[k].label] < k) {
+            loops.push_back(make_pair(labelAt[ir[k].label], k));
+        }
+    }
+    sort(loops.begin(), loops.end());
+    vector<int> order;
+    for(int v = 0; v < vregs; v++) {
+        if(life[v].start >= 0) {
+            order.push_back(v);
+        }
+    }
+    sort(order.begin(), order.end(), [&](int a, int b) {
+        return life[a].start < life[b].start;
+    });
+    /* a sweep over the heads in order keeps the
+     * registers that start before the head and have
+     * not ended; ends only grow, so one pass does */
+    vector<int> live;
+    size_t next = 0;
+    for(size_t i = 0; i < loops.size(); i++) {
+        int head = loops[i].first;
+        while(next < order.size() && life[order[next]].start < head) {
+            live.push_back(order[next++]);
+        }
+        size_t kept = 0;
+        for(size_t j = 0; j < live.size(); j++) {
+            if(life[live[j]].end >= head) {
+                life[live[j]].end = max(life[live[j]].end, loops[i].second);
+                live[kept++] = live[j];
+            }
+        }
+        live.resize(kept);
+    }
+}
+
+/* linearScan gives each virtual register one of the n
+ * registers regs, or else a spill slot, in home: a
+ * register, or -1 - slot. Returns the slots used */
+static int linearScan(const vector<Lifetime>& life, const int* regs, int n, vector<int>& home)
+{
+    vector<int> order;
+    for(int v = 0; v < (int) life.size(); v++) {
+        if(life[v].start >= 0) {
+            order.push_back(v);
+        }
+    }
+    sort(order.begin(), order.end(), [&](int a, int b) {
+        return life[a].start < life[b].start;
+    });
+    home.assign(life.size(), 0);
+    vector<int> freeRegs(regs, regs + n);
+    vector<int> freeSlots;
+    vector<int> freeEnds; /* where the last owner of each free slot ended */
+    int slots = 0;
+    vector<int> active;  /* in registers, by increasing end */
+    vector<int> spilled; /* in slots */
+    for(size_t i = 0; i < order.size(); i++) {
+        int v = order[i];
+        /* a register whose last use is where v starts
+           can be reused: sources are read first */
+        size_t gone = 0;
+        while(gone < active.size() && life[active[gone]].end <= life[v].start) {
+            freeRegs.push_back(home[active[gone]]);
+            gone++;
+        }
+        active.erase(active.begin(), active.begin() + gone);
+        size_t kept = 0;
+        for(size_t j = 0; j < spilled.size(); j++) {
+            if(life[spilled[j]].end < life[v].start) {
+                freeSlots.push_back(-1 - home[spilled[j]]);
+                freeEnds.push_back(life[spilled[j]].end);
+            } else {
+                spilled[kept++] = spilled[j];
+            }
+        }
+        spilled.resize(kept);
+
+        int victim = v;
+        if(!freeRegs.empty()) {
+            home[v] = freeRegs.back();
+            freeRegs.pop_back();
+            victim = -1;
+        } else if(!active.empty() && life[active.back()].end > life[v].end) {
+            /* the register goes to v, and the register
+               needed longest is spilled instead */
+            victim = active.back();
+            active.pop_back();
+            home[v] = home[victim];
+        }
+        if(victim >= 0) {
+            /* a victim started before v, and its whole
+               lifetime moves to the slot, so the slot must
+               have been free since before the victim began */
+            size_t k = freeSlots.size();
+            while(k > 0 && freeEnds[k - 1] >= life[victim].start) {
+                k--;
+            }
+            int slot;
+            if(k > 0) {
+                slot = freeSlots[k - 1];
+                freeSlots.erase(freeSlots.begin() + (k - 1));
+                freeEnds.erase(freeEnds.begin() + (k - 1));
+            } else {
+                slot = slots++;
+            }
+            home[victim] = -1 - slot;
+            spilled.push_back(victim);
+        }
+        if(victim != v) {
+            size_t at = active.size();
+            while(at > 0 && life[active[at - 1]].end > life[v].end) {
+                at--;
+            }
+            active.insert(active.begin() + at, v);
+        }
+    }
+    return slots;
+}
+
+/* rewrite replaces the virtual registers of ir by
+ * their homes into out; a spilled register is loaded
+ * from its slot below mp into a scratch register
+ * before use, and stored there after definition */
+static void rewrite(const vector<Ir>& ir, const vector<int>& home, vector<Ir>& out)
+{
+    out.clear();
+    out.reserve(ir.size());
+    for(size_t k = 0; k < ir.size(); k++) {
+        Ir x = ir[k];
+        int fields = regFields(&x);
+        int def = defines(&x);
+        int loaded[2] = { 0, 0 }; /* homes, 0 for none */
+        int saveTo = 1;           /* offset below mp, 1 for none */
+        for(int f = 1; f <= 3; f++) {
+            int* r = field(&x, f);
+            if(!(fields & (1 << f)) || *r < VREG) {
+                continue;
+            }
+            int h = home[*r - VREG];
+            if(h >= 0) {
+                *r = h;
+                continue;
+            }
+            if(f == 1 && def) {
+                saveTo = h + 1;
+                *r = SCRATCH0;
+                continue;
+            }
+            int s = (loaded[0] == 0 || loaded[0] == h) ? 0 : 1;
+            if(loaded[s] != h) {
+                Ir load = { { TmLd, s ? SCRATCH1 : SCRATCH0, h + 1, TM_MP }, -1 };
+                out.push_back(load);
+                loaded[s] = h;
+            }
+            *r = s ? SCRATCH1 : SCRATCH0;
+        }
+        /* LDA v,d(v) defines and uses v: the load
+           above already went to scratch 0 */
+        out.push_back(x);
+        if(saveTo <= 0) {
+            Ir save = { { TmSt, SCRATCH0, saveTo, TM_MP }, -1 };
+            out.push_back(save);
+        }
+    }
+}
+
+/****************************************/
+/* the peephole pass                    */
+/****************************************/
+
+/* A Known is a data word whose value is also in a
+ * register, or a store not yet read */
+typedef struct {
+    int offset;
+    int base;
+    int reg;  /* or index of the store */
+} Known;
+
+static int findKnown(const vector<Known>& known, int offset, int base)
+{
+    for(size_t i = 0; i < known.size(); i++) {
+        if(known[i].offset == offset && known[i].base == base) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+static void forgetAddress(vector<Known>& known, int offset, int base)
+{
+    size_t kept = 0;
+    for(size_t i = 0; i < known.size(); i++) {
+        if(known[i].offset != offset || known[i].base != base) {
+            known[kept++] = known[i];
+        }
+    }
+    known.resize(kept);
+}
+
+static void forgetRegister(vector<Known>& known, int r)
+{
+    size_t kept = 0;
+    for(size_t i = 0; i < known.size(); i++) {
+        if(known[i].reg != r) {
+            known[kept++] = known[i];
+        }
+    }
+    known.resize(kept);
+}
+
+static int isJumpInstr(const Ir* x)
+{
+    return x->label >= 0 || (x->in.iop != TmSt && x->in.iop != TmOut
+                             && x->in.iop != TmHalt && x->in.iop < TmJlt
+                             && x->in.iarg1 == TM_PC);
+}
+
+/* forwardValues works through each straight-line run
+ * of code, where data addressed from gp and mp can
+ * only change by ST: a load of a word already in a
+ * register becomes a move or goes, a store of the
+ * value the word holds goes, and so does a store
+ * overwritten before anything could read it. Returns
+ * the instructions removed */
+static int forwardValues(vector<Ir>& code)
+{
+    int removed = 0;
+    vector<Known> inReg;   /* words also in registers */
+    vector<Known> pending; /* stores not read yet */
+    for(size_t k = 0; k < code.size(); k++) {
+        TmInstr& in = code[k].in;
+        int op = in.iop;
+        if(op == DELETED) {
+            continue;
+        }
+        if(op == LABEL) {
+            inReg.clear();
+            pending.clear();
+            continue;
+        }
+        int tracked = (op == TmLd || op == TmSt) && (in.iarg3 == TM_GP || in.iarg3 == TM_MP);
+        if(op == TmLd && tracked && in.iarg1 != TM_PC) {
+            int i = findKnown(inReg, in.iarg2, in.iarg3);
+            if(i >= 0 && inReg[i].reg == in.iarg1) {
+                in.iop = DELETED;
+                removed++;
+                continue;
+            }
+            forgetRegister(inReg, in.iarg1);
+            if(i >= 0) { /* a move from the register */
+                in.iop = TmLda;
+                in.iarg3 = inReg[findKnown(inReg, in.iarg2, in.iarg3)].reg;
+                in.iarg2 = 0;
+            } else {
+                forgetAddress(pending, in.iarg2, in.iarg3);
+                Known w = { in.iarg2, in.iarg3, in.iarg1 };
+                inReg.push_back(w);
+            }
+            continue;
+        }
+        if(op == TmSt && tracked) {
+            int i = findKnown(inReg, in.iarg2, in.iarg3);
+            if(i >= 0 && inReg[i].reg == in.iarg1) {
+                in.iop = DELETED;
+                removed++;
+                continue;
+            }
+            int p = findKnown(pending, in.iarg2, in.iarg3);
+            if(p >= 0) {
+                code[pending[p].reg].in.iop = DELETED;
+                removed++;
+                pending.erase(pending.begin() + p);
+            }
+            Known store = { in.iarg2, in.iarg3, (int) k };
+            pending.push_back(store);
+            forgetAddress(inReg, in.iarg2, in.iarg3);
+            Known w = { in.iarg2, in.iarg3, in.iarg1 };
+            inReg.push_back(w);
+            continue;
+        }
+        if(op == TmLda && in.iarg1 == in.iarg3 && in.iarg2 == 0 && code[k].label < 0) {
+            in.iop = DELETED;
+            removed++;
+            continue;
+        }
+        if(isJumpInstr(&code[k]) || op == TmSt || op == TmLd) {
+            /* data may be read where the jump goes or by
+               the load, or the store may write any word */
+            pending.clear();
+            if(op == TmSt) {
+                inReg.clear();
+            }
+        }
+        if(defines(&code[k])) {
+            if(in.iarg1 == TM_GP || in.iarg1 == TM_MP) {
+                inReg.clear();
+                pending.clear();
+            } else {
+                forgetRegister(inReg, in.iarg1);
+            }
+        }
+    }
+    return removed;
+}
+
+/* jumps removes jumps to the next instruction and code
+ * after an unconditional jump that no label reaches.
+ * Returns the instructions removed */
+static int jumps(vector<Ir>& code)
+{
+    int removed = 0;
+    for(size_t k = 0; k < code.size(); k++) {
+        Ir& x = code[k];
+        if(x.in.iop == DELETED || x.in.iop == LABEL) {
+            continue;
+        }
+        if(x.label >= 0) {
+            size_t j = k + 1;
+            while(j < code.size() && (code[j].in.iop == DELETED
+                                      || (code[j].in.iop == LABEL && code[j].in.iarg1 != x.label))) {
+                j++;
+            }
+            if(j < code.size() && code[j].in.iop == LABEL) {
+                x.in.iop = DELETED;
+                removed++;
+                continue;
+            }
+        }
+        if((x.label >= 0 && x.in.iop == TmLda) || x.in.iop == TmHalt) {
+            for(size_t j = k + 1; j < code.size() && code[j].in.iop != LABEL; j++) {
+                if(code[j].in.iop != DELETED) {
+                    code[j].in.iop = DELETED;
+                    removed++;
+                }
+            }
+        }
+    }
+    return removed;
+}
+
+static void peephole(vector<Ir>& code)
+{
+    while(forwardValues(code) + jumps(code) > 0) {
+        /* until nothing more goes */
+    }
+}
+
+/****************************************/
+/* the generator                        */
+/****************************************/
+
+/* layout gives the instructions their addresses and
+ * turns jumps to labels into jumps relative to pc */
+static void layout(const vector<Ir>& code, int labels, vector<TmInstr>& out)
+{
+    vector<int> labelAddr(labels, 0);
+    int addr = 0;
+    for(size_t k = 0; k < code.size(); k++) {
+        if(code[k].in.iop == LABEL) {
+            labelAddr[code[k].in.iarg1] = addr;
+        } else if(code[k].in.iop != DELETED) {
+            addr++;
+        }
+    }
+    out.clear();
+    out.reserve(addr);
+    for(size_t k = 0; k < code.size(); k++) {
+        if(code[k].in.iop == LABEL || code[k].in.iop == DELETED) {
+            continue;
+        }
+        TmInstr in = code[k].in;
+        if(code[k].label >= 0) {
+            in.iarg2 = labelAddr[code[k].label] - ((int) out.size() + 1);
+            in.iarg3 = TM_PC;
+        }
+        out.push_back(in);
+    }
+}
+
+int genTm(TmProgram* prog, TreeNode* tree, int options, FILE* listing)
+{
+    Gen g;
+    g.prog = prog;
+    g.vregs = 0;
+    g.labels = 0;
+    g.listing = listing;
+    g.error = FALSE;
+    prog->code.clear();
+    prog->names.clear();
+    prog->memory = 1;
+    prog->spills = 0;
+
+    /* the standard prelude: mp from location 0, which
+       is then cleared */
+    emit(&g, TmLd, TM_MP, 0, 0);
+    emit(&g, TmSt, 0, 0, 0);
+    statements(&g, tree);
+    emit(&g, TmHalt, 0, 0, 0);
+    if(g.error) {
+        prog->names.clear();
+        TmInstr halt = { TmHalt, 0, 0, 0 };
+        prog->code.assign(1, halt);
+        return FALSE;
+    }
+
+    vector<Lifetime> life;
+    lifetimes(g.ir, g.vregs, g.labels, life);
+    vector<int> home;
+    int slots;
+    if(options & TM_ALLOCATE) {
+        slots = linearScan(life, allRegs, (int) (sizeof(allRegs) / sizeof(allRegs[0])), home);
+        if(slots > 0) {
+            slots = linearScan(life, spillRegs, (int) (sizeof(spillRegs) / sizeof(spillRegs[0])), home);
+        }
+    } else {
+        slots = linearScan(life, NULL, 0, home);
+    }
+    vector<Ir> code;
+    rewrite(g.ir, home, code);
+    if(options & TM_PEEPHOLE) {
+        peephole(code);
+    }
+    layout(code, g.labels, prog->code);
+    prog->spills = slots;
+    prog->memory = max(1, (int) prog->names.size() + slots);
+    return TRUE;
+}
+
+void printTm(const TmProgram* prog, string& s)
+{
+    char buf[64];
+    s += "* TINY Compilation to TM Code\n";
+    for(size_t i = 0; i < prog->names.size(); i++) {
+        snprintf(buf, sizeof(buf), "* %s at %zu\n", prog->names[i].c_str(), i);
+        s += buf;
+    }
+    for(size_t k = 0; k < prog->code.size(); k++) {
+        const TmInstr& in = prog->code[k];
+        if(isRO(in.iop)) {
+            snprintf(buf, sizeof(buf), "%3zu:  %5s  %d,%d,%d \n",
+                     k, opNames[in.iop], in.iarg1, in.iarg2, in.iarg3);
+        } else {
+            snprintf(buf, sizeof(buf), "%3zu:  %5s  %d,%d(%d) \n",
+                     k, opNames[in.iop], in.iarg1, in.iarg2, in.iarg3);
+        }
+        s += buf;
+    }
+}
+
+/****************************************/
+/* the simulator                        */
+/****************************************/
+
+static inline int wrap(long long v)
+{
+    return (int) (unsigned) (unsigned long long) v;
+}
+
+int runTm(const TmProgram* prog, VmIO* io, long long* steps)
+{
+    const TmInstr* iMem = prog->code.data();
+    int size = (int) prog->code.size();
+    int memory = prog->memory;
+    vector<int> dMem(memory, 0);
+    dMem[0] = memory - 1;
+    int reg[TM_REGS] = { 0 };
+    long long count = 0;
+    int outcome = VM_OK;
+    for(;;) {
+        int pc = reg[TM_PC];
+        if(pc < 0 || pc >= size) {
+            outcome = TM_BADADDR;
+            break;
+        }
+        const TmInstr* in = &iMem[pc];
+        reg[TM_PC] = pc + 1;
+        count++;
+        int r = in->iarg1;
+        if(isRO(in->iop)) {
+            int a = reg[in->iarg2];
+            int b = reg[in->iarg3];
+            switch(in->iop) {
+                case TmHalt:
+                    *steps = count;
+                    return VM_OK;
+                case TmIn:
+                    if(!io->read(io, &reg[r])) {
+                        *steps = count;
+                        return VM_NOINPUT;
+                    }
+                    break;
+                case TmOut:
+                    io->write(io, reg[r]);
+                    break;
+                case TmAdd:
+                    reg[r] = wrap((long long) a + b);
+                    break;
+                case TmSub:
+                    reg[r] = wrap((long long) a - b);
+                    break;
+                case TmMul:
+                    reg[r] = wrap((long long) a * b);
+                    break;
+                default:
+                    if(!evalOp(OVER, a, b, &reg[r])) {
+                        *steps = count;
+                        return VM_DIVZERO;
+                    }
+                    break;
+            }
+            continue;
+        }
+        int address = wrap((long long) in->iarg2 + reg[in->iarg3]);
+        switch(in->iop) {
+            case TmLd:
+            case TmSt:
+                if(address < 0 || address >= memory) {
+                    *steps = count;
+                    return TM_BADADDR;
+                }
+                if(in->iop == TmLd) {
+                    reg[r] = dMem[address];
+                } else {
+                    dMem[address] = reg[r];
+                }
+                break;
+            case TmLda:
+                reg[r] = address;
+                break;
+            case TmLdc:
+                reg[r] = in->iarg2;
+                break;
+            case TmJlt:
+                if(reg[r] < 0) {
+                    reg[TM_PC] = address;
+                }
+                break;
+            case TmJle:
+                if(reg[r] <= 0) {
+                    reg[TM_PC] = address;
+                }
+                break;
+            case TmJgt:
+                if(reg[r] > 0) {
+                    reg[TM_PC] = address;
+                }
+                break;
+            case TmJge:
+                if(reg[r] >= 0) {
+                    reg[TM_PC] = address;
+                }
+                break;
+            case TmJeq:
+                if(reg[r] == 0) {
+                    reg[TM_PC] = address;
+                }
+                break;
+            default:
+                if(reg[r] != 0) {
+                    reg[TM_PC] = address;
+                }
+                break;
+        }
+    }
+    *steps = count;
+    return outcome;
+}
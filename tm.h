@@ -0,0 +1,88 @@
+/****************************************************/
+/* File: tm.h                                       */
+/* Code generator for the TM machine of Louden's    */
+/* TINY compiler, and a simulator to run the code   */
+/****************************************************/
+#include "globals.h"
+#include "vm.h"
+#include <string>
+#include <vector>
+
+#ifndef _TM_H_
+#define _TM_H_
+
+/* The opcodes of TM. RO instructions take three
+ * registers r,s,t; RM instructions r,d(s), with the
+ * address d + reg[s]
+ */
+typedef enum {
+    TmHalt,                 /* RO: stop */
+    TmIn, TmOut,            /* RO: reg[r] = input, output reg[r] */
+    TmAdd, TmSub,           /* RO: reg[r] = reg[s] op reg[t] */
+    TmMul, TmDiv,
+    TmLd, TmSt,             /* RM: reg[r] = dMem[a], dMem[a] = reg[r] */
+    TmLda, TmLdc,           /* RM: reg[r] = a, reg[r] = d */
+    TmJlt, TmJle, TmJgt,    /* RM: reg[pc] = a if reg[r] op 0 */
+    TmJge, TmJeq, TmJne,
+    TMOPS
+} TmOp;
+
+/* registers with a fixed use; pc is also written to
+ * jump */
+#define TM_GP 5  /* always 0, the base of the variables */
+#define TM_MP 6  /* top of memory, the base of spills */
+#define TM_PC 7
+#define TM_REGS 8
+
+/* A TmInstr is one instruction; for RM ones iarg2 is
+ * the offset d and iarg3 the register s
+ */
+typedef struct {
+    int iop;
+    int iarg1;
+    int iarg2;
+    int iarg3;
+} TmInstr;
+
+/* A TmProgram is generated code */
+typedef struct {
+    std::vector<TmInstr> code;
+    std::vector<std::string> names; /* the variable at each
+                                       location from 0 */
+    int memory;  /* data words the program needs */
+    int spills;  /* temporaries kept in memory */
+} TmProgram;
+
+/* Options of genTm; without them every temporary is
+ * kept in memory, as Louden's code generator does
+ */
+#define TM_ALLOCATE 1 /* temporaries in registers, by linear scan */
+#define TM_PEEPHOLE 2 /* remove redundant loads, stores, moves
+                         and jumps */
+
+/* Outcome of runTm besides those of runBytecode */
+#define TM_BADADDR 3  /* instruction or data address out of range */
+
+/* Function genTm generates TM code for a syntax tree
+ * free of syntax errors; returns FALSE, after a
+ * message to listing, if the tree uses an operator
+ * that has no meaning for integers (& | #). The
+ * arithmetic is that of the VM, except that < <= > >=
+ * and the end of a for compare by the sign of the
+ * difference, as TM does, which differs only when the
+ * difference overflows
+ */
+int genTm(TmProgram* prog, TreeNode* tree, int options, FILE* listing);
+
+/* Procedure printTm appends prog in the text format
+ * read by Louden's TM simulator
+ */
+void printTm(const TmProgram* prog, std::string& s);
+
+/* Function runTm runs prog, counting in *steps the
+ * instructions executed, and returns VM_OK or the
+ * error that stopped it
+ */
+int runTm(const TmProgram* prog, VmIO* io, long long* steps);
+
+#endif
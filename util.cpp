@@ -6,14 +6,136 @@
 /* Kenneth C. Louden                                */
 /****************************************************/
 
+#include <vector>
 #include "util.h"
+#include "scan.h"
+#include "stats.h"
 
-/* Procedure printToken prints a token
- * and its lexeme to the listing file
+/* Procedure initContext prepares ctx for its first
+ * parse, with the listing sent to stdout
+ */
+void initContext(ParseContext* ctx)
+{
+    ctx->rope = NULL;
+    ctx->bufStart = NULL;
+    ctx->bufPos = NULL;
+    ctx->bufEnd = NULL;
+    ctx->EOF_flag = FALSE;
+    ctx->lineno = 0;
+    ctx->tokenString[0] = '\0';
+    ctx->tokens.block = NULL;
+    ctx->tokens.first = NULL;
+    ctx->tokens.start = NULL;
+    ctx->tokens.line = NULL;
+    ctx->tokens.blocks = 0;
+    ctx->tokens.spare = 0;
+    ctx->tokens.capacity = 0;
+    ctx->tokens.count = 0;
+    ctx->tokens.hint = 0;
+    ctx->cur = 0;
+    ctx->token = ENDFILE;
+    ctx->listing = stdout;
+    ctx->Error = FALSE;
+    ctx->quiet = FALSE;
+    ctx->errors = 0;
+    ctx->maxErrors = MAXERRORS;
+    ctx->recovering = FALSE;
+    ctx->nesting = 0;
+    ctx->maxNesting = MAXNESTING;
+    ctx->frames = NULL;
+    ctx->frameCapacity = 0;
+    ctx->spans = NULL;
+    ctx->latest = NULL;
+    ctx->ticket = 0;
+    ctx->cancelled = FALSE;
+    arenaInit(&ctx->arena);
+    internInit(&ctx->names, &ctx->arena);
+    ctx->nodeTokens = NULL;
+    ctx->nodeCount = 0;
+    ctx->nodeCapacity = 0;
+    resetStats(ctx);
+}
+
+/* Procedure freeContext returns the memory
+ * of ctx to the system
+ */
+void freeContext(ParseContext* ctx)
+{
+    freeTokens(&ctx->tokens);
+    free(ctx->frames);
+    ctx->frames = NULL;
+    ctx->frameCapacity = 0;
+    internFree(&ctx->names);
+    arenaFree(&ctx->arena);
+    free(ctx->nodeTokens);
+    ctx->nodeTokens = NULL;
+    ctx->nodeCount = 0;
+    ctx->nodeCapacity = 0;
+}
+
+/* Function tokenSymbol returns the spelling of a
+ * special symbol token, or NULL for any other token
+ */
+const char* tokenSymbol(TokenType token)
+{
+    switch(token) {
+        case ASSIGN:
+            return "=";
+        case EQ:
+            return "==";
+        case NE:
+            return "<>";
+        case LT:
+            return "<";
+        case LTE:
+            return "<=";
+        case GT:
+            return ">";
+        case GTE:
+            return ">=";
+        case LPAREN:
+            return "(";
+        case RPAREN:
+            return ")";
+        case SEMI:
+            return ";";
+        case PLUS:
+            return "+";
+        case MINUS:
+            return "-";
+        case MINUSEQ:
+            return "-=";
+        case TIMES:
+            return "*";
+        case OVER:
+            return "/";
+        case MOD:
+            return "%";
+        case POWER:
+            return "^";
+        case LINK:
+            return "&";
+        case LOR:
+            return "|";
+        case CLOSURE:
+            return "#";
+        default:
+            return NULL;
+    }
+}
+
+/* Function printToken returns a token and its
+ * lexeme as a line of the listing
  */
 string printToken(TokenType token, string tokenString)
 {
     string s = "";
+    const char* symbol = tokenSymbol(token);
+    if(symbol != NULL) {
+        s += symbol;
+        s += "\n";
+        return s;
+    }
     switch(token) {
         case IF:
         case THEN:
@@ -34,63 +156,6 @@ string printToken(TokenType token, string tokenString)
         case NOT:
             s += "reserved word: " + tokenString;
             break;
-        case ASSIGN:
-            s += '=';
-            break;
-        case LT:
-            s += '<';
-            break;
-        case LTE:
-            s += "<=";
-            break;
-        case GT:
-            s += '>';
-            break;
-        case GTE:
-            s += ">=";
-            break;
-        case EQ:
-            s += "==";
-            break;
-        case NE:
-            s += "<>";
-            break;
-        case LPAREN:
-            s += '(';
-            break;
-        case RPAREN:
-            s += ')';
-            break;
-        case SEMI:
-            s += ';';
-            break;
-        case PLUS:
-            s += '+';
-            break;
-        case MINUS:
-            s += '-';
-            break;
-        case TIMES:
-            s += '*';
-            break;
-        case MOD:
-            s += '%';
-            break;
-        case POWER:
-            s += '^';
-            break;
-        case LINK:
-            s += '&';
-            break;
-        case LOR:
-            s += '|';
-            break;
-        case CLOSURE:
-            s += '#';
-            break;
-        case OVER:
-            s += '/';
-            break;
         case ENDFILE:
             s += "EOF";
             break;
@@ -110,22 +175,51 @@ string printToken(TokenType token, string tokenString)
     return s;
 }
 
+/* newNode returns a node from the arena of ctx with
+ * a NodeToken for the current token, or NULL if out
+ * of memory */
+static TreeNode* newNode(ParseContext* ctx)
+{
+    if(ctx->nodeCount == ctx->nodeCapacity) {
+        int capacity = (ctx->nodeCapacity == 0) ? 1024 : ctx->nodeCapacity * 2;
+        NodeToken* nodeTokens = (NodeToken*) realloc(ctx->nodeTokens,
+                                                     capacity * sizeof(NodeToken));
+        if(nodeTokens == NULL) {
+            return NULL;
+        }
+        STATS(ctx->stats.allocBytes += (capacity - ctx->nodeCapacity) * sizeof(NodeToken));
+        ctx->nodeTokens = nodeTokens;
+        ctx->nodeCapacity = capacity;
+    }
+    TreeNode* t = (TreeNode*) arenaAlloc(&ctx->arena, sizeof(TreeNode));
+    if(t != NULL) {
+        t->id = ctx->nodeCount++;
+        ctx->nodeTokens[t->id].token = ctx->cur;
+        ctx->nodeTokens[t->id].shift = 0;
+    }
+    return t;
+}
+
 /* Function newStmtNode creates a new statement
  * node for syntax tree construction
  */
-TreeNode* newStmtNode(StmtKind kind)
+TreeNode* newStmtNode(ParseContext* ctx, StmtKind kind)
 {
-    TreeNode* t = (TreeNode*) malloc(sizeof(TreeNode));
+    TreeNode* t = newNode(ctx);
     int i;
     if(t == NULL) {
-        fprintf(listing, "Out of memory error at line %d\n", lineno);
+        fprintf(ctx->listing, "Out of memory error at line %d\n", ctx->lineno);
     } else {
         for(i = 0; i < MAXCHILDREN; i++) {
             t->child[i] = NULL;
         }
         t->sibling = NULL;
+        t->attr.name = NULL;
         t->nodekind = StmtK;
+        t->type = Void;
         t->kind.stmt = kind;
+        STATS(ctx->stats.stmts[kind]++);
+        STATS(ctx->stats.allocBytes += sizeof(TreeNode));
     }
     return t;
 }
@@ -133,125 +227,270 @@ TreeNode* newStmtNode(StmtKind kind)
 /* Function newExpNode creates a new expression
  * node for syntax tree construction
  */
-TreeNode* newExpNode(ExpKind kind)
+TreeNode* newExpNode(ParseContext* ctx, ExpKind kind)
 {
-    TreeNode* t = (TreeNode*) malloc(sizeof(TreeNode));
+    TreeNode* t = newNode(ctx);
     int i;
     if(t == NULL) {
-        fprintf(listing, "Out of memory error at line %d\n", lineno);
+        fprintf(ctx->listing, "Out of memory error at line %d\n", ctx->lineno);
     } else {
         for(i = 0; i < MAXCHILDREN; i++) {
             t->child[i] = NULL;
         }
         t->sibling = NULL;
+        t->attr.name = NULL;
         t->nodekind = ExpK;
+        t->type = Void;
         t->kind.exp = kind;
+        STATS(ctx->stats.exps[kind]++);
+        STATS(ctx->stats.allocBytes += sizeof(TreeNode));
+    }
+    return t;
+}
+
+/* Function internName returns the single shared copy
+ * of the len-character identifier at s for the
+ * current tree
+ */
+char* internName(ParseContext* ctx, const char* s, int len)
+{
+    STATS(int known = ctx->names.count);
+    char* t = internString(&ctx->names, s, len);
+    if(t == NULL) {
+        fprintf(ctx->listing, "Out of memory error at line %d\n", ctx->lineno);
     }
+    STATS(if(ctx->names.count != known) {
+        ctx->stats.allocBytes += sizeof(InternEntry) + len + 1;
+    })
     return t;
 }
 
-/* Function copyString allocates and makes a new
- * copy of an existing string
+/* Function parseCancelled tells whether the parse in
+ * ctx has been cancelled, latching the answer
+ */
+int parseCancelled(ParseContext* ctx)
+{
+    if(!ctx->cancelled && ctx->latest != NULL
+       && ctx->latest->load(std::memory_order_relaxed) != ctx->ticket) {
+        ctx->cancelled = TRUE;
+        ctx->Error = TRUE;
+    }
+    return ctx->cancelled;
+}
+
+/* Procedure releaseTree frees every node and name
+ * allocated since the last release in constant time
  */
-char* copyString(char* s)
+void releaseTree(ParseContext* ctx)
+{
+    internReset(&ctx->names);
+    arenaReset(&ctx->arena);
+    ctx->nodeCount = 0;
+}
+
+NodeToken* nodeToken(const ParseContext* ctx, const TreeNode* t)
 {
-    int n;
-    char* t;
-    if(s == NULL) {
+    if(t->id < 0 || t->id >= ctx->nodeCount) {
         return NULL;
     }
-    n = strlen(s) + 1;
-    t = new char[n];
-    if(t == NULL) {
-        fprintf(listing, "Out of memory error at line %d\n", lineno);
+    return &ctx->nodeTokens[t->id];
+}
+
+int nodeShift(const ParseContext* ctx, const TreeNode* t)
+{
+    const NodeToken* n = nodeToken(ctx, t);
+    return (n == NULL) ? 0 : n->shift;
+}
+
+int nodeLine(const ParseContext* ctx, const TreeNode* t, int shift)
+{
+    const NodeToken* n = nodeToken(ctx, t);
+    if(n == NULL || n->token < 0) {
+        return 0;
+    }
+    int k = n->token + shift + n->shift;
+    if(k < 0 || k >= ctx->tokens.count) {
+        return 0;
+    }
+    return tokenLine(&ctx->tokens, k);
+}
+
+/* A TreeSink receives printed tree text: it is
+ * appended to buf, which is flushed to fp whenever
+ * it grows past SINKFLUSH bytes if fp is set
+ */
+#define SINKFLUSH (64 * 1024)
+
+typedef struct {
+    string* buf;
+    FILE* fp;
+} TreeSink;
+
+static void flushSink(TreeSink* sink)
+{
+    if(sink->fp != NULL && !sink->buf->empty()) {
+        fwrite(sink->buf->data(), 1, sink->buf->size(), sink->fp);
+        sink->buf->clear();
+    }
+}
+
+/* putOp appends the spelling of an operator token
+ * and a newline, as printToken would
+ */
+static void putOp(string& s, TokenType op)
+{
+    const char* symbol = tokenSymbol(op);
+    if(symbol != NULL) {
+        s += symbol;
+        s += '\n';
     } else {
-        strcpy_s(t, n, s);
+        s += printToken(op, "");
     }
-    return t;
 }
 
-/* procedure printTree prints a syntax tree to the
- * listing file using indentation to indicate subtrees
+/* putName appends the name of a node, which a syntax
+ * error may have left out
  */
-string printTree(TreeNode* tree, string s, int indentCount)
+static void putName(string& s, const char* name)
 {
-    while(tree != NULL) {
-        for(int i = 0; i < indentCount; i++) {
-            s += "  ";
-        }
-        if(tree->nodekind == StmtK) {
-            switch(tree->kind.stmt) {
-                case IfK:
-                    s += "If";
-                    break;
-                case RepeatK:
-                    s += "Repeat";
-                    break;
-                case AssignK: {
-                    s += "Assign to: ";
-                    s += tree->attr.name;
-                    break;
-                }
-                case ReadK: {
-                    s += "Read: ";
-                    s += tree->attr.name;
-                    break;
-                }
-                case WriteK:
-                    s += "Write";
-                    break;
-                case DoWhileK:
-                    s += "Do";
-                    break;
-                case ForK:
-                    s += "For";
-                    break;
-                case DowntoK:
-                    s += "downto";
-                    break;
-                case ToK:
-                    s += "to";
-                    break;
-                case AndK:
-                    s += "And";
-                    break;
-                case OrK:
-                    s += "Or";
-                    break;
-                default:
-                    s += "Unknown ExpNode kind";
-                    break;
+    if(name != NULL) {
+        s += name;
+    }
+}
+
+/* procedure printNodeLine appends the label line of
+ * one node, without indentation or subtrees
+ */
+void printNodeLine(string& s, const TreeNode* tree)
+{
+    char num[16];
+    if(tree->nodekind == StmtK) {
+        switch(tree->kind.stmt) {
+            case IfK:
+                s += "If";
+                break;
+            case RepeatK:
+                s += "Repeat";
+                break;
+            case AssignK: {
+                s += "Assign to: ";
+                putName(s, tree->attr.name);
+                break;
             }
-            s += "\n";
-        } else if(tree->nodekind == ExpK) {
-            switch(tree->kind.exp) {
-                case OpK:
-                    s += "Op: ";
-                    s += printToken(tree->attr.op, "\0");
-                    break;
-                case ConstK:
-                    s += "Const: " + to_string(tree->attr.val) + "\n";
-                    break;
-                case IdK:
-                    s += "Id: ";
-                    s += tree->attr.name;
-                    s += "\n";
-                    break;
-                case LopK:
-                    s += "Lop: ";
-                    s += printToken(tree->attr.op, "\0");
-                    break;
-                default:
-                    s += "Unknown ExpNode kind\n";
-                    break;
+            case ReadK: {
+                s += "Read: ";
+                putName(s, tree->attr.name);
+                break;
             }
-        } else {
-            s += "Unknown node kind\n";
+            case WriteK:
+                s += "Write";
+                break;
+            case DoWhileK:
+                s += "Do";
+                break;
+            case ForK:
+                s += "For";
+                break;
+            case DowntoK:
+                s += "downto";
+                break;
+            case ToK:
+                s += "to";
+                break;
+            case AndK:
+                s += "And";
+                break;
+            case OrK:
+                s += "Or";
+                break;
+            default:
+                s += "Unknown ExpNode kind";
+                break;
         }
-        for(int i = 0; i < MAXCHILDREN; i++) {
-            s = printTree(tree->child[i], s, indentCount + 1);
+        s += '\n';
+    } else if(tree->nodekind == ExpK) {
+        switch(tree->kind.exp) {
+            case OpK:
+                s += "Op: ";
+                putOp(s, tree->attr.op);
+                break;
+            case ConstK:
+                s += "Const: ";
+                s.append(num, snprintf(num, sizeof(num), "%d", tree->attr.val));
+                s += '\n';
+                break;
+            case IdK:
+                s += "Id: ";
+                putName(s, tree->attr.name);
+                s += '\n';
+                break;
+            case LopK:
+                s += "Lop: ";
+                putOp(s, tree->attr.op);
+                break;
+            default:
+                s += "Unknown ExpNode kind\n";
+                break;
         }
-        tree = tree->sibling;
+    } else {
+        s += "Unknown node kind\n";
     }
-    return s;
+}
+
+/* A PendingNode is a node yet to be printed */
+typedef struct {
+    TreeNode* tree;
+    int indentCount;
+} PendingNode;
+
+/* printNodes prints in preorder from an explicit
+ * stack, so deep trees need heap rather than native
+ * stack: a node's sibling goes under its children,
+ * which go in reverse so the first comes out first
+ */
+static void printNodes(TreeNode* tree, TreeSink* sink, int indentCount)
+{
+    string& s = *sink->buf;
+    vector<PendingNode> pending;
+    if(tree != NULL) {
+        pending.push_back({tree, indentCount});
+    }
+    while(!pending.empty()) {
+        PendingNode n = pending.back();
+        pending.pop_back();
+        s.append(2 * n.indentCount, ' ');
+        printNodeLine(s, n.tree);
+        if(s.size() >= SINKFLUSH) {
+            flushSink(sink);
+        }
+        if(n.tree->sibling != NULL) {
+            pending.push_back({n.tree->sibling, n.indentCount});
+        }
+        for(int i = MAXCHILDREN - 1; i >= 0; i--) {
+            if(n.tree->child[i] != NULL) {
+                pending.push_back({n.tree->child[i], n.indentCount + 1});
+            }
+        }
+    }
+}
+
+/* procedure printTree appends a syntax tree to s
+ * using indentation to indicate subtrees
+ */
+void printTree(TreeNode* tree, string& s, int indentCount)
+{
+    TreeSink sink = { &s, NULL };
+    printNodes(tree, &sink, indentCount);
+}
+
+/* procedure printTree writes a syntax tree to fp
+ * using indentation to indicate subtrees
+ */
+void printTree(TreeNode* tree, FILE* fp)
+{
+    string s;
+    s.reserve(SINKFLUSH + 256);
+    TreeSink sink = { &s, fp };
+    printNodes(tree, &sink, 0);
+    flushSink(&sink);
 }
@@ -11,29 +11,84 @@ using namespace std;
 #ifndef _UTIL_H_
 #define _UTIL_H_
 
-/* Procedure printToken prints a token
- * and its lexeme to the listing file
+/* Procedure initContext prepares ctx for its first
+ * parse, with the listing sent to stdout
+ */
+void initContext(ParseContext* ctx);
+
+/* Procedure freeContext returns the memory
+ * of ctx to the system
+ */
+void freeContext(ParseContext* ctx);
+
+/* Function tokenSymbol returns the spelling of a
+ * special symbol token, or NULL for any other token
+ */
+const char* tokenSymbol(TokenType);
+
+/* Function printToken returns a token and its
+ * lexeme as a line of the listing
  */
 string printToken(TokenType, string);
 
 /* Function newStmtNode creates a new statement
  * node for syntax tree construction
  */
-TreeNode* newStmtNode(StmtKind);
+TreeNode* newStmtNode(ParseContext*, StmtKind);
 
 /* Function newExpNode creates a new expression
  * node for syntax tree construction
  */
-TreeNode* newExpNode(ExpKind);
+TreeNode* newExpNode(ParseContext*, ExpKind);
+
+/* Function internName returns the single shared copy
+ * of the len-character identifier at s for the current
+ * tree, so that equal names have equal pointers
+ */
+char* internName(ParseContext*, const char* s, int len);
+
+/* Function parseCancelled tells whether the parse in
+ * ctx has been cancelled through ctx->latest; once it
+ * has, Error is set and no more syntax errors are listed
+ */
+int parseCancelled(ParseContext*);
+
+/* Procedure releaseTree frees every node and name
+ * allocated since the last release in constant time;
+ * the memory is kept for the next parse
+ */
+void releaseTree(ParseContext*);
+
+/* Function nodeToken returns the NodeToken of t, a
+ * node made by ctx since the last release, or NULL
+ */
+NodeToken* nodeToken(const ParseContext* ctx, const TreeNode* t);
+
+/* Function nodeShift returns the shift of the
+ * NodeToken of t, or 0 if it has none
+ */
+int nodeShift(const ParseContext* ctx, const TreeNode* t);
+
+/* Function nodeLine returns the source line of t,
+ * whose ancestors and earlier siblings move its tokens
+ * by shift, or 0 if it was not made from ctx->tokens
+ */
+int nodeLine(const ParseContext* ctx, const TreeNode* t, int shift);
+
+/* procedure printNodeLine appends the label line of
+ * one node, without indentation or subtrees
+ */
+void printNodeLine(string&, const TreeNode*);
 
-/* Function copyString allocates and makes a new
- * copy of an existing string
+/* procedure printTree appends a syntax tree to the
+ * string using indentation to indicate subtrees; the
+ * int is the indentation of the first level
  */
-char* copyString(char*);
+void printTree(TreeNode*, string&, int);
 
-/* procedure printTree prints a syntax tree to the
- * listing file using indentation to indicate subtrees
+/* procedure printTree writes a syntax tree to the
+ * file in one pass, without building it in memory
  */
-string printTree(TreeNode*, string, int);
+void printTree(TreeNode*, FILE*);
 
 #endif
@@ -0,0 +1,812 @@
+/****************************************************/
+/* File: vm.cpp                                     */
+/* Bytecode compiler and threaded interpreter       */
+/****************************************************/
+
+#include <stdint.h>
+#include <unordered_map>
+#include "globals.h"
+#include "util.h"
+#include "flat.h"
+#include "vm.h"
+
+using namespace std;
+
+/* the interpreter jumps straight from instruction to
+ * instruction through label addresses where the
+ * compiler has them, otherwise it uses a switch
+ */
+#if defined(__GNUC__) && !defined(TINY_SWITCH_VM)
+    #define VM_THREADED
+#endif
+
+/* operand count of each opcode */
+static const unsigned char operands[VMOPS] = {
+    0, 2, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 2, 1, 2, 2, 3, 3, 3, 3, 3, 3, 1, 1
+};
+
+int vmOperands(int op)
+{
+    return operands[op];
+}
+
+static const char* opNames[VMOPS] = {
+    "halt", "move", "add", "sub", "mul", "div", "mod", "pow",
+    "lt", "le", "gt", "ge", "eq", "ne", "inc",
+    "jump", "jz", "jnz", "jlt", "jle", "jgt", "jge", "jeq", "jne",
+    "read", "write"
+};
+
+/* isJump tells whether the last operand of op is a
+ * code index */
+static int isJump(int op)
+{
+    return op >= VmJump && op <= VmJumpNe;
+}
+
+/****************************************/
+/* the arithmetic                       */
+/****************************************/
+
+static inline int wrapAdd(int a, int b)
+{
+    return (int)((unsigned) a + (unsigned) b);
+}
+
+static inline int wrapSub(int a, int b)
+{
+    return (int)((unsigned) a - (unsigned) b);
+}
+
+static inline int wrapMul(int a, int b)
+{
+    return (int)((unsigned) a * (unsigned) b);
+}
+
+/* divide and modulo expect b != 0; INT_MIN / -1 wraps */
+static inline int divide(int a, int b)
+{
+    return (b == -1) ? wrapSub(0, a) : a / b;
+}
+
+static inline int modulo(int a, int b)
+{
+    return (b == -1) ? 0 : a % b;
+}
+
+static int power(int a, int b)
+{
+    if(b < 0) {
+        return (a == 1) ? 1 : (a == -1) ? ((b & 1) ? -1 : 1) : 0;
+    }
+    int r = 1;
+    while(b > 0) {
+        if(b & 1) {
+            r = wrapMul(r, a);
+        }
+        a = wrapMul(a, a);
+        b >>= 1;
+    }
+    return r;
+}
+
+int evalOp(TokenType op, int a, int b, int* result)
+{
+    switch(op) {
+        case PLUS:
+            *result = wrapAdd(a, b);
+            break;
+        case MINUS:
+            *result = wrapSub(a, b);
+            break;
+        case TIMES:
+            *result = wrapMul(a, b);
+            break;
+        case OVER:
+        case MOD:
+            if(b == 0) {
+                return FALSE;
+            }
+            *result = (op == OVER) ? divide(a, b) : modulo(a, b);
+            break;
+        case POWER:
+            *result = power(a, b);
+            break;
+        case LT:
+            *result = a < b;
+            break;
+        case LTE:
+            *result = a <= b;
+            break;
+        case GT:
+            *result = a > b;
+            break;
+        case GTE:
+            *result = a >= b;
+            break;
+        case EQ:
+            *result = a == b;
+            break;
+        case NE:
+            *result = a != b;
+            break;
+        default:
+            *result = 0;
+            break;
+    }
+    return TRUE;
+}
+
+/****************************************/
+/* the compiler                         */
+/****************************************/
+
+/* A Compiler is the state of one compileFlatTree; a
+ * node is given by its index in flat, and a missing
+ * one by -1 */
+typedef struct {
+    Bytecode* bc;
+    const FlatTree* flat;
+    FILE* listing;
+    vector<int> varOf;  /* variable of each name of flat, or -1 */
+    unordered_map<int, int> constOf; /* constant index of each value */
+    int vars;
+    int temps;   /* temporaries in use */
+    int maxTemps;
+    int error;
+} Compiler;
+
+static void compileError(Compiler* c, const char* message)
+{
+    if(!c->error) {
+        fprintf(c->listing, "\n>>> Cannot run the program: %s\n", message);
+    }
+    c->error = TRUE;
+}
+
+/* node returns node t of the tree */
+static const FlatNode* node(const Compiler* c, int t)
+{
+    return &c->flat->nodes[t];
+}
+
+/* child returns child k of node t, or -1 */
+static int child(const Compiler* c, int t, int k)
+{
+    unsigned j = flatChild(c->flat, (unsigned) t, k);
+    return (j == 0) ? -1 : (int) j;
+}
+
+/* sibling returns the next sibling of node t, or -1 */
+static int sibling(const Compiler* c, int t)
+{
+    const FlatNode* n = node(c, t);
+    return (n->flags & FLAT_NEXT) ? t + (int) n->size : -1;
+}
+
+/* varSlot returns the slot of the variable with the
+ * given name index */
+static int varSlot(Compiler* c, int name)
+{
+    if(c->varOf[name] < 0) {
+        c->varOf[name] = c->vars++;
+        c->bc->names.push_back(c->flat->text + c->flat->nameStart[name]);
+    }
+    return c->varOf[name];
+}
+
+/* constIndex returns the index of a constant among
+ * the constants, which follow the variables */
+static int constIndex(Compiler* c, int value)
+{
+    unordered_map<int, int>::iterator i = c->constOf.find(value);
+    if(i != c->constOf.end()) {
+        return i->second;
+    }
+    int k = (int) c->constOf.size();
+    c->constOf[value] = k;
+    return k;
+}
+
+static int constSlot(Compiler* c, int value)
+{
+    return c->vars + constIndex(c, value);
+}
+
+/* collect gives every variable and constant of the
+ * tree its slot before code is generated, in preorder,
+ * which is the order of the nodes */
+static void collect(Compiler* c)
+{
+    for(unsigned i = 0; i < c->flat->count; i++) {
+        const FlatNode* n = &c->flat->nodes[i];
+        if(n->nodekind == StmtK) {
+            switch(n->kind) {
+                case AssignK:
+                case ReadK:
+                    varSlot(c, n->attr);
+                    break;
+                case AndK:
+                case OrK:
+                    constIndex(c, 0);
+                    constIndex(c, 1);
+                    break;
+                default:
+                    break;
+            }
+        } else if(n->kind == IdK) {
+            varSlot(c, n->attr);
+        } else if(n->kind == ConstK) {
+            constIndex(c, n->attr);
+        }
+    }
+}
+
+static int newTemp(Compiler* c)
+{
+    int slot = c->vars + (int) c->constOf.size() + c->temps++;
+    if(c->temps > c->maxTemps) {
+        c->maxTemps = c->temps;
+    }
+    return slot;
+}
+
+static int here(Compiler* c)
+{
+    return (int) c->bc->code.size();
+}
+
+static void emit(Compiler* c, int op)
+{
+    c->bc->code.push_back(op);
+}
+
+static void emit(Compiler* c, int op, int a)
+{
+    c->bc->code.push_back(op);
+    c->bc->code.push_back(a);
+}
+
+static void emit(Compiler* c, int op, int a, int b)
+{
+    emit(c, op, a);
+    c->bc->code.push_back(b);
+}
+
+static void emit(Compiler* c, int op, int a, int b, int d)
+{
+    emit(c, op, a, b);
+    c->bc->code.push_back(d);
+}
+
+/* patch makes the jumps listed go to target */
+static void patch(Compiler* c, const vector<int>& jumps, int target)
+{
+    for(size_t i = 0; i < jumps.size(); i++) {
+        c->bc->code[jumps[i]] = target;
+    }
+}
+
+/* isRelop tells whether op compares its operands */
+static int isRelop(TokenType op)
+{
+    return op == LT || op == LTE || op == GT || op == GTE || op == EQ || op == NE;
+}
+
+/* relJump returns the conditional jump taken when
+ * a op b is when, TRUE or FALSE */
+static int relJump(TokenType op, int when)
+{
+    switch(op) {
+        case LT:
+            return when ? VmJumpLt : VmJumpGe;
+        case LTE:
+            return when ? VmJumpLe : VmJumpGt;
+        case GT:
+            return when ? VmJumpGt : VmJumpLe;
+        case GTE:
+            return when ? VmJumpGe : VmJumpLt;
+        case EQ:
+            return when ? VmJumpEq : VmJumpNe;
+        default:
+            return when ? VmJumpNe : VmJumpEq;
+    }
+}
+
+static int binaryOp(TokenType op)
+{
+    switch(op) {
+        case PLUS:
+            return VmAdd;
+        case MINUS:
+            return VmSub;
+        case TIMES:
+            return VmMul;
+        case OVER:
+            return VmDiv;
+        case MOD:
+            return VmMod;
+        case POWER:
+            return VmPow;
+        case LT:
+            return VmLt;
+        case LTE:
+            return VmLe;
+        case GT:
+            return VmGt;
+        case GTE:
+            return VmGe;
+        case EQ:
+            return VmEq;
+        default:
+            return VmNe;
+    }
+}
+
+static void branch(Compiler* c, int t, int when, vector<int>& jumps);
+
+/* expr generates code for the value of t and returns
+ * its slot, which is want unless want is -1 */
+static int expr(Compiler* c, int t, int want)
+{
+    int slot;
+    if(t < 0) {
+        compileError(c, "the tree is incomplete");
+        return 0;
+    }
+    const FlatNode* n = node(c, t);
+    if(n->nodekind == StmtK) { /* And or Or */
+        vector<int> no;
+        slot = newTemp(c);
+        branch(c, t, FALSE, no);
+        emit(c, VmMove, slot, constSlot(c, 1));
+        emit(c, VmJump, 0);
+        int skip = here(c) - 1;
+        patch(c, no, here(c));
+        emit(c, VmMove, slot, constSlot(c, 0));
+        c->bc->code[skip] = here(c);
+    } else if(n->kind == IdK) {
+        slot = varSlot(c, n->attr);
+    } else if(n->kind == ConstK) {
+        slot = constSlot(c, n->attr);
+    } else if(n->kind == OpK) {
+        int mark = c->temps;
+        int a = expr(c, child(c, t, 0), -1);
+        int b = expr(c, child(c, t, 1), -1);
+        c->temps = mark;
+        slot = (want >= 0) ? want : newTemp(c);
+        emit(c, binaryOp((TokenType) n->attr), slot, a, b);
+        return slot;
+    } else {
+        compileError(c, "& | and # have no integer meaning");
+        return 0;
+    }
+    if(want >= 0 && want != slot) {
+        emit(c, VmMove, want, slot);
+        slot = want;
+    }
+    return slot;
+}
+
+/* branch generates code that goes to the jumps it
+ * adds to the list when the truth of t is when, and
+ * falls through otherwise */
+static void branch(Compiler* c, int t, int when, vector<int>& jumps)
+{
+    int mark = c->temps;
+    const FlatNode* n = (t < 0) ? NULL : node(c, t);
+    if(n != NULL && n->nodekind == StmtK && (n->kind == AndK || n->kind == OrK)) {
+        /* and jumps at once when false, or when true */
+        int early = (n->kind == OrK);
+        if(when == early) {
+            branch(c, child(c, t, 0), when, jumps);
+            branch(c, child(c, t, 1), when, jumps);
+        } else {
+            vector<int> fall;
+            branch(c, child(c, t, 0), early, fall);
+            branch(c, child(c, t, 1), when, jumps);
+            patch(c, fall, here(c));
+        }
+    } else if(n != NULL && n->nodekind == ExpK && n->kind == OpK
+              && isRelop((TokenType) n->attr)) {
+        int a = expr(c, child(c, t, 0), -1);
+        int b = expr(c, child(c, t, 1), -1);
+        emit(c, relJump((TokenType) n->attr, when), a, b, 0);
+        jumps.push_back(here(c) - 1);
+    } else {
+        int a = expr(c, t, -1);
+        emit(c, when ? VmJumpNonZero : VmJumpZero, a, 0);
+        jumps.push_back(here(c) - 1);
+    }
+    c->temps = mark;
+}
+
+static void statements(Compiler* c, int t);
+
+/* forLoop evaluates the limit, then the start value,
+ * and runs the body while the variable has not passed
+ * the limit, stepping by 1 or -1 */
+static void forLoop(Compiler* c, int t)
+{
+    int start = child(c, t, 0);
+    int limit = child(c, t, 1);
+    if(start < 0 || limit < 0) {
+        compileError(c, "the tree is incomplete");
+        return;
+    }
+    int up = (node(c, limit)->kind == ToK);
+    int mark = c->temps;
+    int bound = newTemp(c);
+    expr(c, child(c, limit, 0), bound);
+    int var = varSlot(c, node(c, start)->attr);
+    expr(c, child(c, start, 0), var);
+    emit(c, up ? VmJumpGt : VmJumpLt, var, bound, 0);
+    int exit = here(c) - 1;
+    int top = here(c);
+    statements(c, child(c, t, 2));
+    emit(c, VmInc, var, up ? 1 : -1);
+    emit(c, up ? VmJumpLe : VmJumpGe, var, bound, top);
+    c->bc->code[exit] = here(c);
+    c->temps = mark;
+}
+
+static void statements(Compiler* c, int t)
+{
+    for(; t >= 0 && !c->error; t = sibling(c, t)) {
+        const FlatNode* n = node(c, t);
+        int top = here(c);
+        vector<int> jumps;
+        int mark = c->temps;
+        switch(n->kind) {
+            case AssignK:
+                expr(c, child(c, t, 0), varSlot(c, n->attr));
+                break;
+            case ReadK:
+                emit(c, VmRead, varSlot(c, n->attr));
+                break;
+            case WriteK:
+                emit(c, VmWrite, expr(c, child(c, t, 0), -1));
+                break;
+            case IfK: {
+                int otherwise = child(c, t, 2);
+                branch(c, child(c, t, 0), FALSE, jumps);
+                statements(c, child(c, t, 1));
+                if(otherwise >= 0) {
+                    emit(c, VmJump, 0);
+                    int skip = here(c) - 1;
+                    patch(c, jumps, here(c));
+                    statements(c, otherwise);
+                    c->bc->code[skip] = here(c);
+                } else {
+                    patch(c, jumps, here(c));
+                }
+                break;
+            }
+            case RepeatK:
+                statements(c, child(c, t, 0));
+                branch(c, child(c, t, 1), FALSE, jumps);
+                patch(c, jumps, top);
+                break;
+            case DoWhileK:
+                statements(c, child(c, t, 0));
+                branch(c, child(c, t, 1), TRUE, jumps);
+                patch(c, jumps, top);
+                break;
+            case ForK:
+                forLoop(c, t);
+                break;
+            default:
+                compileError(c, "the tree is incomplete");
+                break;
+        }
+        c->temps = mark;
+    }
+}
+
+int compileFlatTree(Bytecode* bc, const FlatTree* flat, FILE* listing)
+{
+    Compiler c;
+    c.bc = bc;
+    c.flat = flat;
+    c.listing = listing;
+    c.varOf.assign(flat->nameCount, -1);
+    c.vars = 0;
+    c.temps = 0;
+    c.maxTemps = 0;
+    c.error = FALSE;
+    bc->code.clear();
+    bc->frame.clear();
+    bc->names.clear();
+    bc->constants = 0;
+    collect(&c);
+    if(flat->count > 0) {
+        statements(&c, 0);
+    }
+    emit(&c, VmHalt);
+    bc->constants = (int) c.constOf.size();
+    bc->frame.resize(c.vars + bc->constants + c.maxTemps, 0);
+    for(unordered_map<int, int>::iterator i = c.constOf.begin(); i != c.constOf.end(); i++) {
+        bc->frame[c.vars + i->second] = i->first;
+    }
+    if(c.error) {
+        bc->code.assign(1, VmHalt);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+int compileTree(Bytecode* bc, TreeNode* tree, FILE* listing)
+{
+    FlatTree flat;
+    initFlatTree(&flat);
+    int ok = flattenTree(&flat, tree, NULL);
+    if(ok) {
+        ok = compileFlatTree(bc, &flat, listing);
+    } else {
+        fprintf(listing, "\n>>> Cannot run the program: out of memory\n");
+        bc->code.assign(1, VmHalt);
+        bc->frame.clear();
+        bc->names.clear();
+        bc->constants = 0;
+    }
+    freeFlatTree(&flat);
+    return ok;
+}
+
+/****************************************/
+/* the interpreter                      */
+/****************************************/
+
+static int stdioRead(VmIO*, int* value)
+{
+    return scanf("%d", value) == 1;
+}
+
+static void stdioWrite(VmIO*, int value)
+{
+    printf("%d\n", value);
+}
+
+void stdioVmIO(VmIO* io)
+{
+    io->read = stdioRead;
+    io->write = stdioWrite;
+    io->data = NULL;
+}
+
+#ifdef VM_THREADED
+    #define OP(name) L##name:
+    #define NEXT() goto *(const void*) *pc
+#else
+    #define OP(name) case name:
+    #define NEXT() continue
+#endif
+
+/* ARITH is an instruction d a b computing d = expr */
+#define ARITH(name, expr) OP(name) { \
+        int a = R[pc[2]]; \
+        int b = R[pc[3]]; \
+        R[pc[1]] = (expr); \
+        pc += 4; \
+        NEXT(); \
+    }
+
+/* The interpreter runs some pairs of instructions as
+ * one, a superinstruction, chosen as it threads the
+ * code. The pair keeps its words, so a jump to the
+ * second instruction still finds it whole:
+ * - inc d k, then jle or jge d b t, the end of a for
+ * - mul d a b, then mod d d c, as in a * b % c
+ * - add d a b, then jle or jgt d c t, a test of a sum
+ */
+enum { VmIncJumpLe = VMOPS, VmIncJumpGe, VmMulMod, VmAddJumpLe, VmAddJumpGt, VMRUNOPS };
+
+/* JUMPIF is an instruction a b t going to t if cond */
+#define JUMPIF(name, cond) OP(name) { \
+        int a = R[pc[1]]; \
+        int b = R[pc[2]]; \
+        pc = (cond) ? (const intptr_t*) pc[3] : pc + 4; \
+        NEXT(); \
+    }
+
+/* INCJUMPIF is inc d k followed by a jump d b t */
+#define INCJUMPIF(name, cond) OP(name) { \
+        int a = wrapAdd(R[pc[1]], (int) pc[2]); \
+        R[pc[1]] = a; \
+        int b = R[pc[5]]; \
+        pc = (cond) ? (const intptr_t*) pc[6] : pc + 7; \
+        NEXT(); \
+    }
+
+/* ADDJUMPIF is add d a b followed by a jump d c t */
+#define ADDJUMPIF(name, cond) OP(name) { \
+        int a = wrapAdd(R[pc[2]], R[pc[3]]); \
+        R[pc[1]] = a; \
+        int b = R[pc[6]]; \
+        pc = (cond) ? (const intptr_t*) pc[7] : pc + 8; \
+        NEXT(); \
+    }
+
+/* superOp returns the superinstruction that the code
+ * at i begins, or its own opcode; the last instruction
+ * is a halt, so any other is followed by one more */
+static int superOp(const Bytecode* bc, size_t i)
+{
+    const int* w = bc->code.data() + i;
+    if(w[0] == VmInc && (w[3] == VmJumpLe || w[3] == VmJumpGe) && w[4] == w[1]) {
+        return (w[3] == VmJumpLe) ? VmIncJumpLe : VmIncJumpGe;
+    }
+    if(w[0] == VmMul && w[4] == VmMod && w[5] == w[1] && w[6] == w[1]) {
+        return VmMulMod;
+    }
+    if(w[0] == VmAdd && (w[4] == VmJumpLe || w[4] == VmJumpGt) && w[5] == w[1]) {
+        return (w[4] == VmJumpLe) ? VmAddJumpLe : VmAddJumpGt;
+    }
+    return w[0];
+}
+
+int runBytecode(const Bytecode* bc, VmIO* io)
+{
+    /* the code is copied into words holding the address
+       of each opcode's label, or the opcode, and of each
+       jump target */
+    vector<intptr_t> words(bc->code.size());
+#ifdef VM_THREADED
+    static const void* const labels[VMRUNOPS] = {
+        &&LVmHalt, &&LVmMove, &&LVmAdd, &&LVmSub, &&LVmMul, &&LVmDiv, &&LVmMod,
+        &&LVmPow, &&LVmLt, &&LVmLe, &&LVmGt, &&LVmGe, &&LVmEq, &&LVmNe, &&LVmInc,
+        &&LVmJump, &&LVmJumpZero, &&LVmJumpNonZero, &&LVmJumpLt, &&LVmJumpLe,
+        &&LVmJumpGt, &&LVmJumpGe, &&LVmJumpEq, &&LVmJumpNe, &&LVmRead, &&LVmWrite,
+        &&LVmIncJumpLe, &&LVmIncJumpGe, &&LVmMulMod, &&LVmAddJumpLe, &&LVmAddJumpGt
+    };
+#endif
+    for(size_t i = 0; i < bc->code.size(); i += 1 + operands[bc->code[i]]) {
+        int op = bc->code[i];
+        int run = superOp(bc, i);
+#ifdef VM_THREADED
+        words[i] = (intptr_t) labels[run];
+#else
+        words[i] = run;
+#endif
+        for(int k = 1; k <= operands[op]; k++) {
+            words[i + k] = bc->code[i + k];
+        }
+        if(isJump(op)) {
+            words[i + operands[op]] = (intptr_t)(words.data() + bc->code[i + operands[op]]);
+        }
+    }
+    vector<int> frame(bc->frame);
+    frame.push_back(0); /* so the frame is never empty */
+    int* R = frame.data();
+    const intptr_t* pc = words.data();
+#ifdef VM_THREADED
+    NEXT();
+#else
+    for(;;) switch(*pc) {
+#endif
+            OP(VmHalt)
+            return VM_OK;
+            OP(VmMove) {
+                R[pc[1]] = R[pc[2]];
+                pc += 3;
+                NEXT();
+            }
+            ARITH(VmAdd, wrapAdd(a, b))
+            ARITH(VmSub, wrapSub(a, b))
+            ARITH(VmMul, wrapMul(a, b))
+            OP(VmDiv) {
+                int b = R[pc[3]];
+                if(b == 0) {
+                    return VM_DIVZERO;
+                }
+                R[pc[1]] = divide(R[pc[2]], b);
+                pc += 4;
+                NEXT();
+            }
+            OP(VmMod) {
+                int b = R[pc[3]];
+                if(b == 0) {
+                    return VM_DIVZERO;
+                }
+                R[pc[1]] = modulo(R[pc[2]], b);
+                pc += 4;
+                NEXT();
+            }
+            ARITH(VmPow, power(a, b))
+            ARITH(VmLt, a < b)
+            ARITH(VmLe, a <= b)
+            ARITH(VmGt, a > b)
+            ARITH(VmGe, a >= b)
+            ARITH(VmEq, a == b)
+            ARITH(VmNe, a != b)
+            OP(VmInc) {
+                R[pc[1]] = wrapAdd(R[pc[1]], (int) pc[2]);
+                pc += 3;
+                NEXT();
+            }
+            OP(VmJump) {
+                pc = (const intptr_t*) pc[1];
+                NEXT();
+            }
+            OP(VmJumpZero) {
+                pc = (R[pc[1]] == 0) ? (const intptr_t*) pc[2] : pc + 3;
+                NEXT();
+            }
+            OP(VmJumpNonZero) {
+                pc = (R[pc[1]] != 0) ? (const intptr_t*) pc[2] : pc + 3;
+                NEXT();
+            }
+            JUMPIF(VmJumpLt, a < b)
+            JUMPIF(VmJumpLe, a <= b)
+            JUMPIF(VmJumpGt, a > b)
+            JUMPIF(VmJumpGe, a >= b)
+            JUMPIF(VmJumpEq, a == b)
+            JUMPIF(VmJumpNe, a != b)
+            INCJUMPIF(VmIncJumpLe, a <= b)
+            INCJUMPIF(VmIncJumpGe, a >= b)
+            OP(VmMulMod) {
+                int c = R[pc[7]];
+                if(c == 0) {
+                    return VM_DIVZERO;
+                }
+                R[pc[1]] = modulo(wrapMul(R[pc[2]], R[pc[3]]), c);
+                pc += 8;
+                NEXT();
+            }
+            ADDJUMPIF(VmAddJumpLe, a <= b)
+            ADDJUMPIF(VmAddJumpGt, a > b)
+            OP(VmRead) {
+                if(!io->read(io, &R[pc[1]])) {
+                    return VM_NOINPUT;
+                }
+                pc += 2;
+                NEXT();
+            }
+            OP(VmWrite) {
+                io->write(io, R[pc[1]]);
+                pc += 2;
+                NEXT();
+            }
+#ifndef VM_THREADED
+        default:
+            return VM_OK;
+    }
+#endif
+}
+
+/* slotName appends the name of a slot: a variable, a
+ * constant as #value, or a temporary as t<n> */
+static void slotName(const Bytecode* bc, int slot, string& s)
+{
+    char buf[24];
+    int vars = (int) bc->names.size();
+    if(slot < vars) {
+        s += bc->names[slot];
+    } else if(slot < vars + bc->constants) {
+        snprintf(buf, sizeof(buf), "#%d", bc->frame[slot]);
+        s += buf;
+    } else {
+        snprintf(buf, sizeof(buf), "t%d", slot - vars - bc->constants);
+        s += buf;
+    }
+}
+
+void printBytecode(const Bytecode* bc, string& s)
+{
+    char buf[32];
+    for(size_t i = 0; i < bc->code.size(); i += 1 + operands[bc->code[i]]) {
+        int op = bc->code[i];
+        snprintf(buf, sizeof(buf), (operands[op] > 0) ? "%5zu  %-6s" : "%5zu  %s", i, opNames[op]);
+        s += buf;
+        for(int k = 1; k <= operands[op]; k++) {
+            int x = bc->code[i + k];
+            s += ' ';
+            if((isJump(op) && k == operands[op]) || (op == VmInc && k == 2)) {
+                s += to_string(x);
+            } else {
+                slotName(bc, x, s);
+            }
+        }
+        s += '\n';
+    }
+}
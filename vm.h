@@ -0,0 +1,102 @@
+/****************************************************/
+/* File: vm.h                                       */
+/* Bytecode compiler for syntax trees and the       */
+/* threaded interpreter that runs the bytecode      */
+/****************************************************/
+#include "globals.h"
+#include "flat.h"
+#include <string>
+#include <vector>
+
+#ifndef _VM_H_
+#define _VM_H_
+
+/* The machine has one array of int slots: first the
+ * variables, then the constants of the program, then
+ * the temporaries. Every instruction is an opcode
+ * followed by its operands, which are slot numbers or
+ * code indices; the comments give them in order
+ */
+typedef enum {
+    VmHalt,                 /* */
+    VmMove,                 /* d s: d = s */
+    VmAdd, VmSub, VmMul,    /* d a b: d = a op b */
+    VmDiv, VmMod, VmPow,
+    VmLt, VmLe, VmGt,       /* d a b: d = (a op b) as 0 or 1 */
+    VmGe, VmEq, VmNe,
+    VmInc,                  /* d k: d = d + k, k an immediate */
+    VmJump,                 /* t: go to t */
+    VmJumpZero,             /* a t: go to t if a == 0 */
+    VmJumpNonZero,          /* a t: go to t if a != 0 */
+    VmJumpLt, VmJumpLe,     /* a b t: go to t if a op b */
+    VmJumpGt, VmJumpGe,
+    VmJumpEq, VmJumpNe,
+    VmRead,                 /* d: d = next input */
+    VmWrite,                /* a: output a */
+    VMOPS
+} VmOp;
+
+/* A Bytecode is a compiled program */
+typedef struct {
+    std::vector<int> code;  /* opcodes and operands */
+    std::vector<int> frame; /* the slots before the run:
+                               0 for variables, the
+                               constants, 0 for temporaries */
+    std::vector<std::string> names; /* of the variables */
+    int constants; /* slots after the variables */
+} Bytecode;
+
+/* Outcomes of a run */
+#define VM_OK 0
+#define VM_DIVZERO 1  /* division or % by zero */
+#define VM_NOINPUT 2  /* read after the end of the input */
+
+/* A VmIO connects read and write to the world: read
+ * stores the next input number and returns FALSE if
+ * there is none
+ */
+typedef struct vmIO {
+    int (*read)(struct vmIO* io, int* value);
+    void (*write)(struct vmIO* io, int value);
+    void* data; /* for the two functions */
+} VmIO;
+
+/* Procedure stdioVmIO makes io read numbers from
+ * stdin and write them to stdout, one per line
+ */
+void stdioVmIO(VmIO* io);
+
+/* Function evalOp applies the OpK operator op to a
+ * and b with the arithmetic of the machine, which
+ * wraps around on overflow; relational operators give
+ * 0 or 1, and ^ of a negative exponent gives 0 unless
+ * a is 1 or -1. Returns FALSE on division by zero
+ */
+int evalOp(TokenType op, int a, int b, int* result);
+
+/* Function compileFlatTree translates a flat syntax
+ * tree free of syntax errors into bc; returns FALSE,
+ * after a message to listing, if the tree uses an
+ * operator that has no meaning for integers (& | #)
+ */
+int compileFlatTree(Bytecode* bc, const FlatTree* flat, FILE* listing);
+
+/* Function compileTree flattens a syntax tree and
+ * compiles it as compileFlatTree does
+ */
+int compileTree(Bytecode* bc, TreeNode* tree, FILE* listing);
+
+/* Function runBytecode runs bc and returns VM_OK or
+ * the error that stopped it
+ */
+int runBytecode(const Bytecode* bc, VmIO* io);
+
+/* Function vmOperands returns the number of operand
+ * words that follow the opcode op
+ */
+int vmOperands(int op);
+
+/* Procedure printBytecode appends a listing of bc */
+void printBytecode(const Bytecode* bc, std::string& s);
+
+#endif
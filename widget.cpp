@@ -1,13 +1,16 @@
 #include "widget.h"
-#include "cmain.h"
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QTextStream>
+#include <QTextDocument>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QPushButton>
 #include <QLabel>
 
+/* DEBOUNCE_MS = 最后一次按键后等待多久再分析 */
+#define DEBOUNCE_MS 250
+
 Widget::Widget(QWidget* parent)
     : QWidget(parent)
 {
@@ -25,8 +28,14 @@ Widget::Widget(QWidget* parent)
     Layout1->addStretch();
     Layout1->addWidget(btn3);
     Layout1->addStretch();
+    foldBox = new QCheckBox("常量折叠");
+    Layout1->addWidget(foldBox);
+    Layout1->addStretch();
+    symtabBox = new QCheckBox("符号表");
+    Layout1->addWidget(symtabBox);
+    Layout1->addStretch();
 
-    textEdit = new QTextEdit;
+    textEdit = new QPlainTextEdit;
     textBrowser = new QTextBrowser;
     QHBoxLayout* Layout2 = new QHBoxLayout;
     Layout2->addWidget(new QLabel("源程序:"));
@@ -38,10 +47,37 @@ Widget::Widget(QWidget* parent)
     mainLayout->addLayout(Layout1);
     mainLayout->addLayout(Layout2);
     this->setLayout(mainLayout);
+
+    // 分析在后台线程进行，结果通过排队的信号送回界面
+    latest = 0;
+    worker = new ParseWorker(&latest);
+    worker->moveToThread(&parserThread);
+    connect(&parserThread, SIGNAL(finished()), worker, SLOT(deleteLater()));
+    connect(this, SIGNAL(parseRequested(QByteArray, int)),
+            worker, SLOT(parse(QByteArray, int)), Qt::QueuedConnection);
+    connect(worker, SIGNAL(treeReady(QString, int)),
+            this, SLOT(showTree(QString, int)), Qt::QueuedConnection);
+    connect(this, SIGNAL(foldingChanged(bool)),
+            worker, SLOT(setFolding(bool)), Qt::QueuedConnection);
+    connect(foldBox, SIGNAL(toggled(bool)), this, SLOT(toggleFolding(bool)));
+    connect(this, SIGNAL(symtabChanged(bool)),
+            worker, SLOT(setSymtab(bool)), Qt::QueuedConnection);
+    connect(symtabBox, SIGNAL(toggled(bool)), this, SLOT(toggleSymtab(bool)));
+    parserThread.start();
+
+    // 边输入边分析：停止输入 DEBOUNCE_MS 毫秒后再分析
+    debounce = new QTimer(this);
+    debounce->setSingleShot(true);
+    debounce->setInterval(DEBOUNCE_MS);
+    connect(textEdit, SIGNAL(textChanged()), this, SLOT(textChanged()));
+    connect(debounce, SIGNAL(timeout()), this, SLOT(requestParse()));
 }
 
 Widget::~Widget()
 {
+    latest++; // 放弃正在进行的分析
+    parserThread.quit();
+    parserThread.wait();
 }
 
 /* 函数功能：读取文件中的文法规则，并显示到界面上 */
@@ -72,7 +108,7 @@ void Widget::openFile()
         s += line + "\n";
         line = in.readLine();
     }
-    textEdit->setText(s);
+    textEdit->setPlainText(s);
 }
 
 /* 函数功能：将输入的文法规则保存为txt文件 */
@@ -103,21 +139,58 @@ void Widget::saveFile()
 void Widget::genTree()
 {
     // 如果文本框没有内容，弹窗警告
-    if(textEdit->toPlainText() == "") {
+    if(textEdit->document()->isEmpty()) {
         QMessageBox::warning(this, "警告", "没有输入！");
         return;
     }
+    debounce->stop();
+    requestParse();
+}
 
-    // 生成临时文件
-    QString path = "./tmp.tny";
-    QFile* savefile = new QFile(path);
-    savefile->open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
-    savefile->write(textEdit->toPlainText().toUtf8());
-    savefile->close();
+/* 函数功能：源程序改变时让正在进行的分析作废，并重新开始计时 */
+void Widget::textChanged()
+{
+    latest++;
+    debounce->start();
+}
 
-    // 生成语法树
-    textBrowser->setText(QString::fromStdString(fun(path.toLatin1().data())));
+/* 函数功能：把当前源程序交给后台线程分析 */
+void Widget::requestParse()
+{
+    int ticket = ++latest;
+    QByteArray text = textEdit->toPlainText().toUtf8();
+    if(text.isEmpty()) {
+        textBrowser->clear();
+        return;
+    }
+    emit parseRequested(text, ticket);
+}
+
+/* 函数功能：切换常量折叠，并按新的设置重新显示语法树 */
+void Widget::toggleFolding(bool on)
+{
+    // 两个信号按顺序排队，分析时折叠设置已经生效
+    emit foldingChanged(on);
+    if(!textEdit->document()->isEmpty()) {
+        debounce->stop();
+        requestParse();
+    }
+}
 
-    // 删除临时文件
-    QFile::remove(path);
+/* 函数功能：切换符号表的显示，并按新的设置重新显示 */
+void Widget::toggleSymtab(bool on)
+{
+    emit symtabChanged(on);
+    if(!textEdit->document()->isEmpty()) {
+        debounce->stop();
+        requestParse();
+    }
+}
+
+/* 函数功能：显示后台线程送回的语法树，过时的结果不显示 */
+void Widget::showTree(QString tree, int ticket)
+{
+    if(ticket == latest) {
+        textBrowser->setPlainText(tree);
+    }
 }
@@ -2,8 +2,13 @@
 #define WIDGET_H
 
 #include <QWidget>
-#include <QTextEdit>
+#include <QPlainTextEdit>
 #include <QTextBrowser>
+#include <QCheckBox>
+#include <QThread>
+#include <QTimer>
+#include <atomic>
+#include "parseworker.h"
 
 class Widget : public QWidget
 {
@@ -14,12 +19,28 @@ public:
     ~Widget();
 
 private:
-    QTextEdit* textEdit;
+    QPlainTextEdit* textEdit;
     QTextBrowser* textBrowser;
+    QCheckBox* foldBox; // 显示常量折叠后的语法树
+    QCheckBox* symtabBox; // 在语法树前显示符号表
+    QThread parserThread; // 语法分析在这个线程里进行
+    ParseWorker* worker;
+    QTimer* debounce; // 停止输入一段时间后才分析
+    std::atomic<int> latest; // 最新一次修改或请求的编号
+
+signals:
+    void parseRequested(QByteArray text, int ticket);
+    void foldingChanged(bool on);
+    void symtabChanged(bool on);
 
 private slots:
     void openFile();
     void saveFile();
     void genTree();
+    void textChanged();
+    void requestParse();
+    void toggleFolding(bool on);
+    void toggleSymtab(bool on);
+    void showTree(QString tree, int ticket);
 };
 #endif // WIDGET_H